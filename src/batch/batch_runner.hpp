@@ -0,0 +1,232 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+
+#include "sweep.hpp"
+#include "physics/emitter.hpp"
+#include "physics/solver_registry.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+
+/**
+ * @brief Metrics of a finished batch run
+ */
+struct RunSummary
+{
+    uint64_t objects_count     = 0;
+    // Measured on the last frame
+    double   kinetic_energy    = 0.0;
+    float    max_velocity      = 0.0f;
+    // Accumulated over all the frames
+    uint64_t contacts_resolved = 0;
+    float    max_penetration   = 0.0f;
+    uint64_t cell_overflow     = 0;
+    // Time spent computing the run, excluding the time waiting for a worker
+    double   time_ms           = 0.0;
+    // Set when the solver does not support the run parameters, the run is skipped
+    bool     failed            = false;
+
+    void addFrame(const SolverStats& stats)
+    {
+        objects_count      = stats.objects_count;
+        kinetic_energy     = stats.kinetic_energy;
+        max_velocity       = stats.max_velocity;
+        contacts_resolved += stats.contacts_resolved;
+        max_penetration    = std::max(max_penetration, stats.max_penetration);
+        cell_overflow     += stats.cell_overflow;
+    }
+
+    static void writeCSVHeader(std::ostream& stream)
+    {
+        stream << "objects,kinetic_energy,max_velocity,contacts_resolved,max_penetration,cell_overflow,time_ms,failed";
+    }
+
+    void writeCSV(std::ostream& stream) const
+    {
+        stream << objects_count << ","
+               << kinetic_energy << ","
+               << max_velocity << ","
+               << contacts_resolved << ","
+               << max_penetration << ","
+               << cell_overflow << ","
+               << time_ms << ","
+               << failed;
+    }
+};
+
+/**
+ * @brief Runs all the simulations of a sweep on a shared thread pool
+ *
+ * Each solver runs on a single worker through a pool without threads, so the only threads are
+ * the ones of the shared pool. Runs are processed by lanes, one per worker: a lane advances its
+ * solver by one frame per task and queues its next frame, starting the next pending run once
+ * its current one is finished. Lanes never wait for each other and solvers only exist while
+ * their run is in progress.
+ */
+struct BatchRunner
+{
+    struct Lane
+    {
+        // Solvers of this lane run their tasks on the worker running the frame
+        tp::ThreadPool                   pool{tp::ThreadPool::Inline{}};
+        std::unique_ptr<SolverInterface> solver;
+        uint32_t                         run_idx = 0;
+        uint32_t                         frame   = 0;
+        RunParameters                    parameters;
+        // Emission buffers
+        std::vector<Vec2>                positions;
+        std::vector<Vec2>                velocities;
+    };
+
+    const Sweep&                       sweep;
+    tp::ThreadPool&                    thread_pool;
+    std::vector<RunSummary>            summaries;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::atomic<uint32_t>              next_run = 0;
+
+    BatchRunner(const Sweep& sweep_, tp::ThreadPool& tp)
+        : sweep{sweep_}
+        , thread_pool{tp}
+    {}
+
+    /**
+     * @brief Run all the simulations and wait for their completion
+     */
+    void run()
+    {
+        const uint32_t run_count  = sweep.getRunCount();
+        const uint32_t lane_count = std::min(run_count, thread_pool.m_thread_count);
+        summaries.assign(run_count, {});
+        next_run = 0;
+        lanes.clear();
+        for (uint32_t i{0}; i < lane_count; ++i) {
+            lanes.push_back(std::make_unique<Lane>());
+        }
+        for (uint32_t i{0}; i < lane_count; ++i) {
+            queueStep(i);
+        }
+        thread_pool.waitForCompletion();
+    }
+
+    /**
+     * @brief Number of runs skipped because their solver does not support their parameters
+     */
+    [[nodiscard]]
+    uint32_t getFailedCount() const
+    {
+        return static_cast<uint32_t>(std::count_if(summaries.begin(), summaries.end(), [](const RunSummary& summary) {
+            return summary.failed;
+        }));
+    }
+
+    /**
+     * @brief Write the parameters and summary of all the runs, in sweep order
+     *
+     * @param stream output stream
+     */
+    void writeCSV(std::ostream& stream) const
+    {
+        stream << "run,";
+        RunParameters::writeCSVHeader(stream);
+        stream << ",";
+        RunSummary::writeCSVHeader(stream);
+        stream << "\n";
+        const auto run_count = static_cast<uint32_t>(summaries.size());
+        for (uint32_t i{0}; i < run_count; ++i) {
+            stream << i << ",";
+            sweep.getRun(i).writeCSV(stream);
+            stream << ",";
+            summaries[i].writeCSV(stream);
+            stream << "\n";
+        }
+    }
+
+private:
+    void queueStep(uint32_t lane_idx)
+    {
+        // The lane keeps its worker when workers are pinned, along with its solver memory
+        thread_pool.addTask(lane_idx, [this, lane_idx]{
+            step(lane_idx);
+        });
+    }
+
+    /**
+     * @brief Advance the run of a lane by one frame, the lane stops when no run is left
+     */
+    void step(uint32_t lane_idx)
+    {
+        Lane& lane = *lanes[lane_idx];
+        if (!lane.solver && !startRun(lane)) {
+            return;
+        }
+        RunSummary& summary = summaries[lane.run_idx];
+        if (lane.frame < lane.parameters.frames) {
+            const auto start = std::chrono::steady_clock::now();
+            emit(lane);
+            lane.solver->update(lane.parameters.dt);
+            summary.addFrame(lane.solver->getStats());
+            summary.time_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            ++lane.frame;
+        }
+        if (lane.frame == lane.parameters.frames) {
+            lane.solver.reset();
+        }
+        queueStep(lane_idx);
+    }
+
+    /**
+     * @brief Create the solver of the next pending run
+     *
+     * Runs the solver does not support are flagged as failed and skipped.
+     *
+     * @return false if all the runs are started
+     */
+    bool startRun(Lane& lane)
+    {
+        while (true) {
+            const uint32_t run_idx = next_run++;
+            if (run_idx >= summaries.size()) {
+                return false;
+            }
+            lane.run_idx    = run_idx;
+            lane.frame      = 0;
+            lane.parameters = sweep.getRun(run_idx);
+            const RunParameters& parameters = lane.parameters;
+            lane.solver = SolverRegistry::create(parameters.solver, {parameters.world_width, parameters.world_height}, lane.pool);
+            lane.solver->setSubSteps(parameters.sub_steps);
+            lane.solver->setGravity({parameters.gravity_x, parameters.gravity_y});
+            lane.solver->setDamping(parameters.damping);
+            lane.solver->setStatsEnabled(true);
+            if (lane.solver->setBoundaries(parameters.getBoundaries())) {
+                return true;
+            }
+            summaries[run_idx].failed = true;
+            lane.solver.reset();
+        }
+    }
+
+    /**
+     * @brief Emit a line of atoms near the left border, like the interactive mode
+     */
+    static void emit(Lane& lane)
+    {
+        const RunParameters& parameters = lane.parameters;
+        const uint64_t objects_count = lane.solver->getObjectsCount();
+        if (objects_count >= parameters.max_objects) {
+            return;
+        }
+        const auto count = static_cast<uint32_t>(std::min<uint64_t>(parameters.emit_count, parameters.max_objects - objects_count));
+        const emitter::Line line{{2.0f, 10.0f}, {0.0f, 1.1f}, count};
+        lane.positions.resize(count);
+        lane.velocities.assign(count, {parameters.emit_speed, 0.0f});
+        for (uint32_t k{0}; k < count; ++k) {
+            lane.positions[k] = line.getPosition(k);
+        }
+        lane.solver->createObjects(lane.positions.data(), lane.velocities.data(), nullptr, count);
+    }
+};
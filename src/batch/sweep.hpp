@@ -0,0 +1,270 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <cstdint>
+
+#include "physics/solver_registry.hpp"
+
+
+/**
+ * @brief Parameters of a single batch run
+ *
+ * Atoms are emitted each frame along a vertical line near the left border, like the interactive
+ * mode, until max_objects is reached.
+ */
+struct RunParameters
+{
+    std::string solver       = "default";
+    int32_t     world_width  = 300;
+    int32_t     world_height = 300;
+    uint32_t    frames       = 600;
+    float       dt           = 1.0f / 60.0f;
+    uint32_t    sub_steps    = 8;
+    float       gravity_x    = 0.0f;
+    float       gravity_y    = 20.0f;
+    float       damping      = 40.0f;
+    // Atoms per emission line and their velocity, expressed as a displacement per sub step
+    uint32_t    emit_count   = 20;
+    float       emit_speed   = 0.2f;
+    uint32_t    max_objects  = 20000;
+    // Boundary mode of each axis: wall, periodic or open
+    std::string boundary_x   = "wall";
+    std::string boundary_y   = "wall";
+
+    /**
+     * @brief Set a parameter from its name
+     *
+     * @param key name of the parameter, same as the member
+     * @param value text of the value
+     * @return false if the key is unknown or the value invalid
+     */
+    bool set(const std::string& key, const std::string& value)
+    {
+        if (key == "solver") {
+            solver = value;
+            for (const SolverRegistry::Entry& entry : SolverRegistry::getEntries()) {
+                if (value == entry.name) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (key == "world_width") {
+            return parse(value, world_width) && world_width > 2;
+        }
+        if (key == "world_height") {
+            return parse(value, world_height) && world_height > 2;
+        }
+        if (key == "frames") {
+            return parse(value, frames);
+        }
+        if (key == "dt") {
+            return parse(value, dt) && dt > 0.0f;
+        }
+        if (key == "sub_steps") {
+            return parse(value, sub_steps) && sub_steps > 0;
+        }
+        if (key == "gravity_x") {
+            return parse(value, gravity_x);
+        }
+        if (key == "gravity_y") {
+            return parse(value, gravity_y);
+        }
+        if (key == "damping") {
+            return parse(value, damping);
+        }
+        if (key == "emit_count") {
+            return parse(value, emit_count);
+        }
+        if (key == "emit_speed") {
+            return parse(value, emit_speed);
+        }
+        if (key == "max_objects") {
+            return parse(value, max_objects);
+        }
+        BoundaryMode mode;
+        if (key == "boundary_x") {
+            boundary_x = value;
+            return parseBoundaryMode(value, mode);
+        }
+        if (key == "boundary_y") {
+            boundary_y = value;
+            return parseBoundaryMode(value, mode);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Boundary modes of the run, walls for invalid names
+     */
+    [[nodiscard]]
+    BoundaryConditions getBoundaries() const
+    {
+        BoundaryConditions boundaries;
+        parseBoundaryMode(boundary_x, boundaries.x);
+        parseBoundaryMode(boundary_y, boundaries.y);
+        return boundaries;
+    }
+
+    /**
+     * @brief Write the CSV header matching writeCSV
+     *
+     * @param stream output stream
+     */
+    static void writeCSVHeader(std::ostream& stream)
+    {
+        stream << "solver,world_width,world_height,frames,dt,sub_steps,gravity_x,gravity_y,damping,emit_count,emit_speed,max_objects,boundary_x,boundary_y";
+    }
+
+    /**
+     * @brief Write the parameters as CSV fields, without line end
+     *
+     * @param stream output stream
+     */
+    void writeCSV(std::ostream& stream) const
+    {
+        stream << solver << ","
+               << world_width << ","
+               << world_height << ","
+               << frames << ","
+               << dt << ","
+               << sub_steps << ","
+               << gravity_x << ","
+               << gravity_y << ","
+               << damping << ","
+               << emit_count << ","
+               << emit_speed << ","
+               << max_objects << ","
+               << boundary_x << ","
+               << boundary_y;
+    }
+
+private:
+    static bool parseBoundaryMode(const std::string& text, BoundaryMode& mode)
+    {
+        if (text == "wall") {
+            mode = BoundaryMode::Wall;
+        } else if (text == "periodic") {
+            mode = BoundaryMode::Periodic;
+        } else if (text == "open") {
+            mode = BoundaryMode::Open;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    static bool parse(const std::string& text, T& value)
+    {
+        std::istringstream stream(text);
+        T parsed;
+        if (!(stream >> parsed) || !stream.eof()) {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+};
+
+/**
+ * @brief Set of runs read from a sweep file
+ *
+ * Each line holds a parameter name followed by one or more values, lines starting with # are comments.
+ * Runs are all the combinations of the listed values, the last parameter varying first:
+ *
+ *     solver    default uniform
+ *     frames    900
+ *     gravity_y 10 20 40
+ *     damping   20 40
+ *
+ * describes 12 runs, other parameters keep their RunParameters default.
+ */
+struct Sweep
+{
+    struct Axis
+    {
+        std::string              key;
+        std::vector<std::string> values;
+    };
+
+    std::vector<Axis> axes;
+    // Description of the first error found by load
+    std::string       error;
+
+    /**
+     * @brief Read a sweep file
+     *
+     * @param path path of the file
+     * @return false if the file could not be read or is invalid, see error
+     */
+    bool load(const std::string& path)
+    {
+        axes.clear();
+        std::ifstream file(path);
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::string line;
+        uint32_t    line_number = 0;
+        while (std::getline(file, line)) {
+            ++line_number;
+            std::istringstream stream(line);
+            Axis axis;
+            if (!(stream >> axis.key) || axis.key[0] == '#') {
+                continue;
+            }
+            std::string value;
+            RunParameters check;
+            while (stream >> value) {
+                if (!check.set(axis.key, value)) {
+                    error = path + ":" + std::to_string(line_number) + ": invalid value '" + value + "' for '" + axis.key + "'";
+                    return false;
+                }
+                axis.values.push_back(value);
+            }
+            if (axis.values.empty()) {
+                error = path + ":" + std::to_string(line_number) + ": no value for '" + axis.key + "'";
+                return false;
+            }
+            axes.push_back(axis);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Number of runs described by the sweep
+     */
+    [[nodiscard]]
+    uint32_t getRunCount() const
+    {
+        uint32_t count = 1;
+        for (const Axis& axis : axes) {
+            count *= static_cast<uint32_t>(axis.values.size());
+        }
+        return count;
+    }
+
+    /**
+     * @brief Parameters of a run
+     *
+     * @param run_idx index of the run, lower than getRunCount()
+     */
+    [[nodiscard]]
+    RunParameters getRun(uint32_t run_idx) const
+    {
+        RunParameters parameters;
+        for (uint32_t i{static_cast<uint32_t>(axes.size())}; i--;) {
+            const Axis&    axis  = axes[i];
+            const auto     count = static_cast<uint32_t>(axis.values.size());
+            parameters.set(axis.key, axis.values[run_idx % count]);
+            run_idx /= count;
+        }
+        return parameters;
+    }
+};
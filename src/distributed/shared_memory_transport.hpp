@@ -0,0 +1,256 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "transport.hpp"
+
+
+namespace dist
+{
+
+/**
+ * @brief Transport between processes of the same machine through a POSIX shared memory segment
+ *
+ * The segment holds one mailbox per ordered pair of processes. A mailbox stores a single
+ * message, written by its sender and copied out by its receiver, both spin until the mailbox
+ * is in the state they need. Only available on POSIX systems.
+ */
+struct SharedMemoryTransport : public Transport
+{
+    static constexpr uint32_t magic = 0x564d5348;
+
+    struct alignas(64) Mailbox
+    {
+        // Messages written and received, the mailbox is full when they differ
+        alignas(64) std::atomic<uint64_t> written  = 0;
+        alignas(64) std::atomic<uint64_t> received = 0;
+        uint64_t                          size     = 0;
+    };
+
+    // Mailboxes follow the header
+    struct alignas(64) Header
+    {
+        // Set once the segment is initialized
+        std::atomic<uint32_t> magic          = 0;
+        uint32_t              size           = 0;
+        uint64_t              capacity       = 0;
+        uint64_t              mailbox_stride = 0;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Atomics are shared between processes");
+
+    std::string m_name;
+    uint32_t    m_rank     = 0;
+    uint32_t    m_size     = 0;
+    uint64_t    m_capacity = 0;
+    uint8_t*    m_memory   = nullptr;
+    uint64_t    m_bytes    = 0;
+    // The creator removes the segment name on destruction
+    bool        m_owner    = false;
+
+    /**
+     * @brief Create the segment, before the other processes attach to it
+     *
+     * A segment left with the same name by a previous run is replaced.
+     *
+     * @param name name of the segment, starting with a slash
+     * @param rank rank of the calling process
+     * @param size number of processes
+     * @param capacity largest message size in bytes
+     * @return the transport, or null if the segment could not be created
+     */
+    static std::unique_ptr<SharedMemoryTransport> create(const std::string& name, uint32_t rank, uint32_t size, uint64_t capacity)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        shm_unlink(name.c_str());
+        const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            return nullptr;
+        }
+        const uint64_t stride = getMailboxStride(capacity);
+        const uint64_t bytes  = sizeof(Header) + stride * size * size;
+        if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            return nullptr;
+        }
+        auto transport = map(fd, name, rank, bytes);
+        if (!transport) {
+            shm_unlink(name.c_str());
+            return nullptr;
+        }
+        transport->m_owner = true;
+        Header& header = *new (transport->m_memory) Header{};
+        header.size           = size;
+        header.capacity       = capacity;
+        header.mailbox_stride = stride;
+        transport->readHeader();
+        for (uint32_t sender{0}; sender < size; ++sender) {
+            for (uint32_t receiver{0}; receiver < size; ++receiver) {
+                new (&transport->getMailbox(sender, receiver)) Mailbox{};
+            }
+        }
+        header.magic.store(magic, std::memory_order_release);
+        return transport;
+#else
+        (void)name;
+        (void)rank;
+        (void)size;
+        (void)capacity;
+        return nullptr;
+#endif
+    }
+
+    /**
+     * @brief Attach to a segment created by another process
+     *
+     * @param name name of the segment
+     * @param rank rank of the calling process
+     * @return the transport, or null if the segment does not exist or is not initialized yet
+     */
+    static std::unique_ptr<SharedMemoryTransport> attach(const std::string& name, uint32_t rank)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            return nullptr;
+        }
+        const off_t bytes = lseek(fd, 0, SEEK_END);
+        if (bytes < static_cast<off_t>(sizeof(Header))) {
+            close(fd);
+            return nullptr;
+        }
+        auto transport = map(fd, name, rank, static_cast<uint64_t>(bytes));
+        if (!transport || transport->getHeader().magic.load(std::memory_order_acquire) != magic) {
+            return nullptr;
+        }
+        transport->readHeader();
+        return transport;
+#else
+        (void)name;
+        (void)rank;
+        return nullptr;
+#endif
+    }
+
+    ~SharedMemoryTransport() override
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (m_memory) {
+            munmap(m_memory, m_bytes);
+        }
+        if (m_owner) {
+            shm_unlink(m_name.c_str());
+        }
+#endif
+    }
+
+    [[nodiscard]]
+    uint32_t getRank() const override
+    {
+        return m_rank;
+    }
+
+    [[nodiscard]]
+    uint32_t getSize() const override
+    {
+        return m_size;
+    }
+
+    [[nodiscard]]
+    uint64_t getCapacity() const override
+    {
+        return m_capacity;
+    }
+
+    bool send(uint32_t peer, const void* data, uint64_t size) override
+    {
+        if (size > m_capacity) {
+            return false;
+        }
+        Mailbox& mailbox = getMailbox(m_rank, peer);
+        const uint64_t sequence = mailbox.written.load(std::memory_order_relaxed);
+        while (mailbox.received.load(std::memory_order_acquire) != sequence) {
+            std::this_thread::yield();
+        }
+        mailbox.size = size;
+        std::memcpy(getMailboxData(mailbox), data, size);
+        mailbox.written.store(sequence + 1, std::memory_order_release);
+        return true;
+    }
+
+    void receive(uint32_t peer, std::vector<uint8_t>& message) override
+    {
+        Mailbox& mailbox = getMailbox(peer, m_rank);
+        const uint64_t sequence = mailbox.received.load(std::memory_order_relaxed);
+        while (mailbox.written.load(std::memory_order_acquire) == sequence) {
+            std::this_thread::yield();
+        }
+        const uint8_t* data = getMailboxData(mailbox);
+        message.assign(data, data + mailbox.size);
+        mailbox.received.store(sequence + 1, std::memory_order_release);
+    }
+
+private:
+    SharedMemoryTransport() = default;
+
+    static uint64_t getMailboxStride(uint64_t capacity)
+    {
+        // Keep mailboxes aligned on cache lines
+        return (sizeof(Mailbox) + capacity + 63) / 64 * 64;
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    static std::unique_ptr<SharedMemoryTransport> map(int fd, const std::string& name, uint32_t rank, uint64_t bytes)
+    {
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        // The mapping stays valid once the descriptor is closed
+        close(fd);
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+        std::unique_ptr<SharedMemoryTransport> transport{new SharedMemoryTransport()};
+        transport->m_name   = name;
+        transport->m_rank   = rank;
+        transport->m_memory = static_cast<uint8_t*>(memory);
+        transport->m_bytes  = bytes;
+        return transport;
+    }
+#endif
+
+    void readHeader()
+    {
+        m_size     = getHeader().size;
+        m_capacity = getHeader().capacity;
+    }
+
+    Header& getHeader()
+    {
+        return *reinterpret_cast<Header*>(m_memory);
+    }
+
+    Mailbox& getMailbox(uint32_t sender, uint32_t receiver)
+    {
+        const uint64_t index = sender * m_size + receiver;
+        return *reinterpret_cast<Mailbox*>(m_memory + sizeof(Header) + index * getHeader().mailbox_stride);
+    }
+
+    static uint8_t* getMailboxData(Mailbox& mailbox)
+    {
+        return reinterpret_cast<uint8_t*>(&mailbox) + sizeof(Mailbox);
+    }
+};
+
+}
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "transport.hpp"
+#include "physics/physics.hpp"
+
+
+namespace dist
+{
+
+/**
+ * @brief Part of a world simulated by one process, a slab of columns of the global world
+ *
+ * Each process owns the atoms whose center lies in its columns and simulates them with a local
+ * solver covering its slab and a halo on the sides shared with a neighbor. Before each sub step,
+ * atoms that left the slab migrate to the neighbor and copies of the atoms close to each shared
+ * border are sent as ghosts. Ghosts take part in the sub step like the other atoms, so atoms on
+ * both sides of a border see each other, and are dropped after it.
+ *
+ * Between updates the local solver only holds owned atoms, in local coordinates (see getOffset),
+ * atoms can be added or removed through the solver methods. Atoms IDs are local to each process and
+ * atoms must not be larger than the default radius to interact across borders.
+ */
+template<typename TConfig = DefaultSolverConfig>
+struct BasicSlabDomain
+{
+    static_assert(std::is_trivially_copyable_v<PhysicObject>, "Atoms are sent as raw bytes");
+
+    // Band of atoms copied to a neighbor, atoms only reach the neighbor cells of their own
+    static constexpr int32_t ghost_width = 2;
+    // Columns added on each shared side, keeps the ghosts away from the local world borders
+    static constexpr int32_t halo_width  = ghost_width + 2;
+
+    enum Side : uint32_t
+    {
+        Left  = 0,
+        Right = 1
+    };
+
+    /**
+     * @brief Header of the message sent to a neighbor, followed by the migrating atoms then the ghosts
+     */
+    struct MessageHeader
+    {
+        uint32_t migrant_count = 0;
+        uint32_t ghost_count   = 0;
+        // Set when the atoms did not fit in the transport, the message then holds no atom
+        uint32_t overflow      = 0;
+        // Set when each atom is followed by its radius, the sender has variable radius
+        uint32_t radius        = 0;
+    };
+
+    Transport&                 transport;
+    IVec2                      world_size;
+    // Owned columns of the global world, end excluded
+    int32_t                    slab_start;
+    int32_t                    slab_end;
+    // Global x coordinate of the local world left border
+    int32_t                    offset;
+    BasicPhysicSolver<TConfig> solver;
+    // Sub steps per update, the local solver runs them one by one
+    uint32_t                   sub_steps = TConfig::sub_steps;
+    // Atoms leaving the slab and ghosts for each side, per dispatch batch
+    std::vector<std::vector<uint32_t>> migrants[2];
+    std::vector<std::vector<uint32_t>> ghosts[2];
+    std::vector<uint32_t>      removed;
+    std::vector<uint8_t>       message;
+    std::vector<uint8_t>       received[2];
+    // Set when an exchange of the current update overflowed the transport, on either side
+    bool                       exchange_failed = false;
+
+    /**
+     * @brief Create the slab of the calling process
+     *
+     * @param size size of the global world
+     * @param transport_ transport connecting the processes, the rank selects the slab
+     * @param tp thread pool of the local solver
+     */
+    BasicSlabDomain(IVec2 size, Transport& transport_, tp::ThreadPool& tp)
+        : transport{transport_}
+        , world_size{size}
+        , slab_start{getSlabStart(size.x, transport_.getRank(), transport_.getSize())}
+        , slab_end{getSlabStart(size.x, transport_.getRank() + 1, transport_.getSize())}
+        , offset{slab_start - (hasNeighbor(Left) ? halo_width : 0)}
+        , solver{{slab_end + (hasNeighbor(Right) ? halo_width : 0) - offset, size.y}, tp}
+    {
+        solver.sub_steps = 1;
+    }
+
+    /**
+     * @brief First global column of a process slab
+     *
+     * @param world_width width of the global world
+     * @param rank rank of the process, the world width for rank == count
+     * @param count number of processes
+     */
+    static int32_t getSlabStart(int32_t world_width, uint32_t rank, uint32_t count)
+    {
+        return static_cast<int32_t>(static_cast<int64_t>(world_width) * rank / count);
+    }
+
+    /**
+     * @brief Transport capacity needed to exchange with a neighbor
+     *
+     * Ghosts come from ghost_width columns and migrants from the border column. Cells hold
+     * cell_capacity atoms, twice as many are allowed for atoms dropped from full cells.
+     *
+     * @param size size of the global world
+     */
+    static uint64_t getMessageCapacity(IVec2 size)
+    {
+        const uint64_t max_atoms = static_cast<uint64_t>(ghost_width + 1) * size.y * CollisionCell::cell_capacity * 2;
+        return sizeof(MessageHeader) + max_atoms * getAtomSize(true);
+    }
+
+    /**
+     * @brief Size of an atom in a message
+     *
+     * @param radius true if the atom is followed by its radius
+     */
+    static uint64_t getAtomSize(bool radius)
+    {
+        return sizeof(PhysicObject) + (radius ? sizeof(float) : 0);
+    }
+
+    [[nodiscard]]
+    bool hasNeighbor(Side side) const
+    {
+        return side == Left ? transport.getRank() > 0 : transport.getRank() + 1 < transport.getSize();
+    }
+
+    /**
+     * @brief Global x coordinate of the local world left border
+     */
+    [[nodiscard]]
+    float getOffset() const
+    {
+        return to<float>(offset);
+    }
+
+    /**
+     * @brief Add atoms given in global coordinates, only the ones inside the slab are kept
+     *
+     * Every process can be given the same atoms.
+     *
+     * @param positions positions of the atoms
+     * @param velocities initial velocities expressed as a displacement per sub step, can be null
+     * @param colors palette indices of the atoms colors, can be null
+     * @param count number of atoms
+     * @return the number of atoms added to this slab
+     */
+    uint32_t createObjects(const Vec2* positions, const Vec2* velocities, const uint8_t* colors, uint32_t count)
+    {
+        uint32_t added = 0;
+        for (uint32_t i{0}; i < count; ++i) {
+            if (!isInSlab(positions[i].x)) {
+                continue;
+            }
+            const uint64_t id   = solver.objects.emplace_back(positions[i] - Vec2{getOffset(), 0.0f});
+            PhysicObject&  obj  = solver.objects[id];
+            if (velocities) {
+                obj.last_position -= velocities[i];
+            }
+            if (colors) {
+                obj.color = colors[i];
+            }
+            ++added;
+        }
+        return added;
+    }
+
+    /**
+     * @brief Update the slab, all the processes must call it with the same time step
+     *
+     * An exchange exceeding the transport capacity does not lose atoms, the migrants are kept
+     * until the next exchange and the ghosts are not sent, but the result is wrong near the
+     * border. The simulation has to be stopped by all the processes, see reduceSum.
+     *
+     * @param dt time step
+     * @return false if an exchange with a neighbor overflowed the transport
+     */
+    bool update(float dt)
+    {
+        exchange_failed = false;
+        const float sub_dt = dt / static_cast<float>(sub_steps);
+        for (uint32_t i{0}; i < sub_steps; ++i) {
+            PROFILE_SCOPE("domain_substep");
+            const uint32_t owned_count = exchange();
+            solver.update(sub_dt);
+            // Ghosts were added last and their slots are not reordered by the update
+            for (uint64_t k{solver.objects.size()}; k-- > owned_count;) {
+                solver.eraseObjectViaData(to<uint32_t>(k));
+            }
+        }
+        return !exchange_failed;
+    }
+
+    /**
+     * @brief Sum a value over all the processes, the result is returned to all of them
+     *
+     * @param value local value
+     */
+    double reduceSum(double value)
+    {
+        const uint32_t rank = transport.getRank();
+        const uint32_t size = transport.getSize();
+        std::vector<uint8_t> buffer;
+        if (rank > 0) {
+            transport.send(0, &value, sizeof(value));
+            transport.receive(0, buffer);
+            std::memcpy(&value, buffer.data(), sizeof(value));
+            return value;
+        }
+        for (uint32_t peer{1}; peer < size; ++peer) {
+            double peer_value;
+            transport.receive(peer, buffer);
+            std::memcpy(&peer_value, buffer.data(), sizeof(peer_value));
+            value += peer_value;
+        }
+        for (uint32_t peer{1}; peer < size; ++peer) {
+            transport.send(peer, &value, sizeof(value));
+        }
+        return value;
+    }
+
+private:
+    [[nodiscard]]
+    bool isInSlab(float x) const
+    {
+        return x >= to<float>(slab_start) && x < to<float>(slab_end);
+    }
+
+    /**
+     * @brief Send migrating atoms and ghosts to the neighbors and add the ones received
+     *
+     * @return the number of owned atoms, ghosts are stored after them
+     */
+    uint32_t exchange()
+    {
+        PROFILE_SCOPE("halo_exchange");
+        collectBorderAtoms();
+        // Send before removing the migrants, their indices are still valid
+        bool sent[2] = {false, false};
+        for (const Side side : {Left, Right}) {
+            if (hasNeighbor(side)) {
+                sent[side] = sendBorderAtoms(side);
+                exchange_failed |= !sent[side];
+            }
+        }
+        removeMigrants(sent);
+        for (const Side side : {Left, Right}) {
+            if (hasNeighbor(side)) {
+                transport.receive(getNeighbor(side), received[side]);
+                MessageHeader header;
+                std::memcpy(&header, received[side].data(), sizeof(header));
+                exchange_failed |= header.overflow != 0;
+            }
+        }
+        // Migrants first, they are owned
+        for (const Side side : {Left, Right}) {
+            if (hasNeighbor(side)) {
+                addReceivedAtoms(received[side], 0);
+            }
+        }
+        const auto owned_count = to<uint32_t>(solver.objects.size());
+        for (const Side side : {Left, Right}) {
+            if (hasNeighbor(side)) {
+                addReceivedAtoms(received[side], 1);
+            }
+        }
+        return owned_count;
+    }
+
+    [[nodiscard]]
+    uint32_t getNeighbor(Side side) const
+    {
+        return side == Left ? transport.getRank() - 1 : transport.getRank() + 1;
+    }
+
+    /**
+     * @brief Find the atoms leaving the slab and the ones close to its shared borders
+     */
+    void collectBorderAtoms()
+    {
+        const uint32_t batch_count = solver.thread_pool.getBatchCount();
+        for (const Side side : {Left, Right}) {
+            migrants[side].resize(batch_count);
+            ghosts[side].resize(batch_count);
+        }
+        const float start = to<float>(slab_start - offset);
+        const float end   = to<float>(slab_end - offset);
+        const float width = to<float>(ghost_width);
+        const bool  left  = hasNeighbor(Left);
+        const bool  right = hasNeighbor(Right);
+        solver.thread_pool.dispatchIndexed(to<uint32_t>(solver.objects.size()), [&](uint32_t batch_idx, uint32_t first, uint32_t last) {
+            for (const Side side : {Left, Right}) {
+                migrants[side][batch_idx].clear();
+                ghosts[side][batch_idx].clear();
+            }
+            for (uint32_t i{first}; i < last; ++i) {
+                const float x = solver.objects.data[i].position.x;
+                if (left && x < start) {
+                    migrants[Left][batch_idx].push_back(i);
+                } else if (right && x >= end) {
+                    migrants[Right][batch_idx].push_back(i);
+                } else {
+                    if (left && x < start + width) {
+                        ghosts[Left][batch_idx].push_back(i);
+                    }
+                    if (right && x >= end - width) {
+                        ghosts[Right][batch_idx].push_back(i);
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief Send the migrants and ghosts of a side, a message too large for the transport is
+     * replaced by a header flagging the overflow so the neighbor does not wait for it
+     *
+     * @return true if the atoms were sent
+     */
+    bool sendBorderAtoms(Side side)
+    {
+        MessageHeader header;
+        for (const std::vector<uint32_t>& batch : migrants[side]) {
+            header.migrant_count += to<uint32_t>(batch.size());
+        }
+        for (const std::vector<uint32_t>& batch : ghosts[side]) {
+            header.ghost_count += to<uint32_t>(batch.size());
+        }
+        header.radius = solver.isVariableRadius() ? 1 : 0;
+        const uint64_t message_size = sizeof(MessageHeader) + static_cast<uint64_t>(header.migrant_count + header.ghost_count) * getAtomSize(header.radius);
+        if (message_size > transport.getCapacity()) {
+            const MessageHeader overflow_header{0, 0, 1, 0};
+            transport.send(getNeighbor(side), &overflow_header, sizeof(overflow_header));
+            return false;
+        }
+        message.resize(message_size);
+        std::memcpy(message.data(), &header, sizeof(header));
+        uint8_t* cursor = message.data() + sizeof(MessageHeader);
+        for (const auto* list : {&migrants[side], &ghosts[side]}) {
+            for (const std::vector<uint32_t>& batch : *list) {
+                for (const uint32_t atom_idx : batch) {
+                    // Global coordinates
+                    PhysicObject obj = solver.objects.data[atom_idx];
+                    obj.position.x      += getOffset();
+                    obj.last_position.x += getOffset();
+                    std::memcpy(cursor, &obj, sizeof(obj));
+                    cursor += sizeof(obj);
+                    if (header.radius) {
+                        const float radius = solver.getObjectShape(atom_idx).radius;
+                        std::memcpy(cursor, &radius, sizeof(radius));
+                        cursor += sizeof(radius);
+                    }
+                }
+            }
+        }
+        return transport.send(getNeighbor(side), message.data(), message.size());
+    }
+
+    /**
+     * @brief Remove the atoms sent to a neighbor
+     *
+     * @param sent sides whose message was sent
+     */
+    void removeMigrants(const bool (&sent)[2])
+    {
+        removed.clear();
+        for (const Side side : {Left, Right}) {
+            if (!sent[side]) {
+                continue;
+            }
+            for (const std::vector<uint32_t>& batch : migrants[side]) {
+                removed.insert(removed.end(), batch.begin(), batch.end());
+            }
+        }
+        // From the end, atoms swapped in are never migrants
+        std::sort(removed.begin(), removed.end(), std::greater<>());
+        for (const uint32_t atom_idx : removed) {
+            solver.eraseObjectViaData(atom_idx);
+        }
+    }
+
+    /**
+     * @brief Add the migrants or the ghosts of a message
+     *
+     * @param buffer received message
+     * @param part 0 for the migrants, 1 for the ghosts
+     */
+    void addReceivedAtoms(const std::vector<uint8_t>& buffer, uint32_t part)
+    {
+        MessageHeader header;
+        std::memcpy(&header, buffer.data(), sizeof(header));
+        const uint32_t count     = part ? header.ghost_count : header.migrant_count;
+        const uint64_t atom_size = getAtomSize(header.radius);
+        const uint8_t* atoms     = buffer.data() + sizeof(MessageHeader) + (part ? header.migrant_count : 0) * atom_size;
+        const float    shift     = getOffset();
+        const uint64_t first     = solver.createObjects(count, [atoms, atom_size, shift](uint32_t k, PhysicObject& obj) {
+            std::memcpy(&obj, atoms + k * atom_size, sizeof(PhysicObject));
+            obj.position.x      -= shift;
+            obj.last_position.x -= shift;
+        });
+        if constexpr (!std::is_same_v<typename TConfig::Radius, UniformRadius>) {
+            if (header.radius) {
+                for (uint32_t k{0}; k < count; ++k) {
+                    float radius;
+                    std::memcpy(&radius, atoms + k * atom_size + sizeof(PhysicObject), sizeof(radius));
+                    solver.setObjectRadius(to<uint32_t>(first + k), radius);
+                }
+            }
+        }
+    }
+};
+
+using SlabDomain = BasicSlabDomain<DefaultSolverConfig>;
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+
+namespace dist
+{
+
+/**
+ * @brief Point to point messages between the processes of a distributed simulation
+ *
+ * Messages between two processes are received in the order they were sent. Implementations may
+ * buffer a single message per direction, send then waits until the previous one was received.
+ */
+struct Transport
+{
+    virtual ~Transport() = default;
+
+    /**
+     * @brief Index of the calling process
+     */
+    [[nodiscard]]
+    virtual uint32_t getRank() const = 0;
+
+    /**
+     * @brief Number of processes
+     */
+    [[nodiscard]]
+    virtual uint32_t getSize() const = 0;
+
+    /**
+     * @brief Largest message accepted by send, in bytes
+     */
+    [[nodiscard]]
+    virtual uint64_t getCapacity() const = 0;
+
+    /**
+     * @brief Send a message, returns once the message is buffered
+     *
+     * @param peer rank of the receiver
+     * @param data message content
+     * @param size message size in bytes
+     * @return false if the message exceeds the capacity
+     */
+    virtual bool send(uint32_t peer, const void* data, uint64_t size) = 0;
+
+    /**
+     * @brief Wait for the next message of a peer
+     *
+     * @param peer rank of the sender
+     * @param message receives the message content
+     */
+    virtual void receive(uint32_t peer, std::vector<uint8_t>& message) = 0;
+};
+
+}
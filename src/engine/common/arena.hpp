@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+namespace civ
+{
+
+/**
+ * @brief Monotonic memory arena
+ *
+ * Memory is carved from large blocks and only released when the arena is destroyed,
+ * individual deallocations are no-ops. Meant to back containers that allocate once,
+ * like the pages of a PagedArray or arrays reserved to their final capacity: a growing
+ * std::vector leaves each previous buffer behind, counted by getReleasedBytes.
+ */
+struct Arena
+{
+    /**
+     * @brief Construct a new Arena object
+     *
+     * @param block_size_ size in bytes of the blocks requested to the system
+     */
+    explicit
+    Arena(uint64_t block_size_ = 1 << 20)
+        : block_size{block_size_}
+    {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+        for (const Block& block : blocks) {
+            ::operator delete(block.memory, std::align_val_t{block_alignment});
+        }
+    }
+
+    /**
+     * @brief Allocate memory from the arena
+     *
+     * @param bytes size of the allocation
+     * @param alignment required alignment, at most block_alignment
+     * @return pointer to the allocated memory
+     */
+    void* allocate(uint64_t bytes, uint64_t alignment)
+    {
+        const uint64_t offset = (current_offset + alignment - 1) & ~(alignment - 1);
+        if (blocks.empty() || offset + bytes > blocks.back().size) {
+            addBlock(bytes);
+            return allocate(bytes, alignment);
+        }
+        current_offset = offset + bytes;
+        allocated_bytes += bytes;
+        return blocks.back().memory + offset;
+    }
+
+    /**
+     * @brief Record memory given back by a container, it is not reused
+     *
+     * @param bytes size of the released allocation
+     */
+    void release(uint64_t bytes)
+    {
+        released_bytes += bytes;
+    }
+
+    /**
+     * @brief Memory released by containers since the arena creation, lost until the arena is destroyed
+     */
+    [[nodiscard]]
+    uint64_t getReleasedBytes() const
+    {
+        return released_bytes;
+    }
+
+    /**
+     * @brief Total memory requested to the system
+     */
+    [[nodiscard]]
+    uint64_t getReservedBytes() const
+    {
+        uint64_t result = 0;
+        for (const Block& block : blocks) {
+            result += block.size;
+        }
+        return result;
+    }
+
+    // Largest alignment allocate supports
+    constexpr static uint64_t block_alignment = 64;
+
+private:
+    struct Block
+    {
+        uint8_t* memory;
+        uint64_t size;
+    };
+
+    uint64_t           block_size;
+    uint64_t           current_offset  = 0;
+    uint64_t           allocated_bytes = 0;
+    uint64_t           released_bytes  = 0;
+    std::vector<Block> blocks;
+
+    void addBlock(uint64_t min_size)
+    {
+        const uint64_t size = std::max(block_size, min_size);
+        auto* memory = static_cast<uint8_t*>(::operator new(size, std::align_val_t{block_alignment}));
+        blocks.push_back({memory, size});
+        current_offset = 0;
+    }
+};
+
+/**
+ * @brief Standard compliant allocator drawing its memory from an Arena
+ *
+ * With ContiguousStorage, reserve the final capacity before adding objects: each growth
+ * of the arrays leaks the previous buffers until the arena is destroyed. PagedStorage
+ * only leaks its small page table when growing.
+ *
+ * @tparam T type of the allocated objects
+ */
+template<typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+
+    explicit
+    ArenaAllocator(Arena& arena_)
+        : arena{&arena_}
+    {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : arena{other.arena}
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t n)
+    {
+        // Memory is released with the arena
+        arena->release(n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const
+    {
+        return arena != other.arena;
+    }
+
+    Arena* arena;
+};
+
+}
@@ -1,18 +1,272 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <cstdint>
 
 
+/**
+ * @brief Column major cells layout, cell (x, y) is at index x * height + y
+ *
+ * A column group, the unit used to split the grid in contiguous slices, is one column.
+ */
+struct ColumnMajorLayout
+{
+	int32_t width, height;
+
+	ColumnMajorLayout()
+		: width(0)
+		, height(0)
+	{}
+
+	ColumnMajorLayout(int32_t width_, int32_t height_)
+		: width(width_)
+		, height(height_)
+	{}
+
+	[[nodiscard]]
+	uint32_t getCellCount() const
+	{
+		return width * height;
+	}
+
+	[[nodiscard]]
+	uint32_t getIndex(uint32_t x, uint32_t y) const
+	{
+		return x * height + y;
+	}
+
+	[[nodiscard]]
+	uint32_t getColumnGroupCount() const
+	{
+		return width;
+	}
+
+	[[nodiscard]]
+	uint32_t getColumnGroup(uint32_t x) const
+	{
+		return x;
+	}
+
+	/**
+	 * @brief Index of the first cell of a column group, groups are contiguous in memory
+	 *
+	 * @param group index of the group, can be equal to the group count
+	 */
+	[[nodiscard]]
+	uint32_t getColumnGroupStart(uint32_t group) const
+	{
+		return group * height;
+	}
+
+	/**
+	 * @brief Indices of the 3x3 neighborhood of a cell, the cell itself included
+	 *
+	 * @param index index of the cell
+	 */
+	[[nodiscard]]
+	std::array<uint32_t, 9> getNeighbors(uint32_t index, uint32_t, uint32_t) const
+	{
+		const uint32_t h = height;
+		return {index - 1    , index    , index + 1,
+		        index + h - 1, index + h, index + h + 1,
+		        index - h - 1, index - h, index - h + 1};
+	}
+
+	/**
+	 * @brief Iterate over the cells of a range of column groups in memory order
+	 *
+	 * @param first_group first column group
+	 * @param last_group last column group (excluded)
+	 * @param callback called with (index, x, y)
+	 */
+	template<typename TCallback>
+	void forEachCell(uint32_t first_group, uint32_t last_group, TCallback&& callback) const
+	{
+		uint32_t index = getColumnGroupStart(first_group);
+		for (uint32_t x{first_group}; x < last_group; ++x) {
+			for (uint32_t y{0}; y < static_cast<uint32_t>(height); ++y) {
+				callback(index++, x, y);
+			}
+		}
+	}
+};
+
+/**
+ * @brief Z-order (Morton) codes, x bits are stored in the even bits
+ */
+struct Morton
+{
+	static constexpr uint32_t encode(uint32_t x, uint32_t y)
+	{
+		return spreadBits(x) | (spreadBits(y) << 1);
+	}
+
+	static constexpr uint32_t spreadBits(uint32_t v)
+	{
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+	static constexpr uint32_t compactBits(uint32_t v)
+	{
+		v &= 0x55555555;
+		v = (v | (v >> 1)) & 0x33333333;
+		v = (v | (v >> 2)) & 0x0F0F0F0F;
+		v = (v | (v >> 4)) & 0x00FF00FF;
+		return v;
+	}
+};
+
+/**
+ * @brief Local coordinates of the cells of a Morton ordered tile, in memory order
+ *
+ * @tparam TileArea number of cells in a tile
+ */
+template<uint32_t TileArea>
+struct MortonTable
+{
+	uint8_t coordinates[TileArea][2] = {};
+
+	constexpr MortonTable()
+	{
+		for (uint32_t m{0}; m < TileArea; ++m) {
+			coordinates[m][0] = static_cast<uint8_t>(Morton::compactBits(m));
+			coordinates[m][1] = static_cast<uint8_t>(Morton::compactBits(m >> 1));
+		}
+	}
+};
+
+/**
+ * @brief Tiled cells layout, the grid is split in square tiles stored in column major order
+ * and cells inside a tile follow a Z-order (Morton) curve
+ *
+ * The 3x3 neighborhood of most cells stays inside the same tile, keeping it resident in L1
+ * when the grid is traversed tile by tile. A column group is one column of tiles.
+ *
+ * @tparam TileBits log2 of the tile side
+ */
+template<uint32_t TileBits = 3>
+struct TiledLayout
+{
+	static constexpr uint32_t tile_size = 1 << TileBits;
+	static constexpr uint32_t tile_mask = tile_size - 1;
+	static constexpr uint32_t tile_area = tile_size * tile_size;
+
+	int32_t  width, height;
+	uint32_t tiles_y;
+	uint32_t tiles_x;
+
+	TiledLayout()
+		: width(0)
+		, height(0)
+		, tiles_y(0)
+		, tiles_x(0)
+	{}
+
+	TiledLayout(int32_t width_, int32_t height_)
+		: width(width_)
+		, height(height_)
+		, tiles_y((height_ + tile_mask) >> TileBits)
+		, tiles_x((width_ + tile_mask) >> TileBits)
+	{}
+
+	[[nodiscard]]
+	uint32_t getCellCount() const
+	{
+		return tiles_x * tiles_y * tile_area;
+	}
+
+	[[nodiscard]]
+	uint32_t getIndex(uint32_t x, uint32_t y) const
+	{
+		const uint32_t tile = (x >> TileBits) * tiles_y + (y >> TileBits);
+		return (tile << (2 * TileBits)) | Morton::encode(x & tile_mask, y & tile_mask);
+	}
+
+	[[nodiscard]]
+	uint32_t getColumnGroupCount() const
+	{
+		return tiles_x;
+	}
+
+	[[nodiscard]]
+	uint32_t getColumnGroup(uint32_t x) const
+	{
+		return x >> TileBits;
+	}
+
+	[[nodiscard]]
+	uint32_t getColumnGroupStart(uint32_t group) const
+	{
+		return group * tiles_y * tile_area;
+	}
+
+	[[nodiscard]]
+	std::array<uint32_t, 9> getNeighbors(uint32_t index, uint32_t x, uint32_t y) const
+	{
+		const uint32_t lx = x & tile_mask;
+		const uint32_t ly = y & tile_mask;
+		if (lx - 1 < tile_mask - 1 && ly - 1 < tile_mask - 1) {
+			// Neighborhood inside the tile, step directly along the Morton code
+			constexpr uint32_t x_bits = 0x55555555 & (tile_area - 1);
+			constexpr uint32_t y_bits = 0xAAAAAAAA & (tile_area - 1);
+			const uint32_t base = index & ~(tile_area - 1);
+			const uint32_t m    = index &  (tile_area - 1);
+			const uint32_t mx   = m & x_bits;
+			const uint32_t my   = m & y_bits;
+			const uint32_t x_m  = (mx - 1) & x_bits;
+			const uint32_t x_p  = ((m | y_bits) + 1) & x_bits;
+			const uint32_t y_m  = (my - 1) & y_bits;
+			const uint32_t y_p  = ((m | x_bits) + 1) & y_bits;
+			return {base | mx  | y_m, index      , base | mx  | y_p,
+			        base | x_p | y_m, base | x_p | my, base | x_p | y_p,
+			        base | x_m | y_m, base | x_m | my, base | x_m | y_p};
+		}
+		return {getIndex(x    , y - 1), getIndex(x    , y), getIndex(x    , y + 1),
+		        getIndex(x + 1, y - 1), getIndex(x + 1, y), getIndex(x + 1, y + 1),
+		        getIndex(x - 1, y - 1), getIndex(x - 1, y), getIndex(x - 1, y + 1)};
+	}
+
+	/**
+	 * @brief Iterate over the cells of a range of tile columns, tile by tile
+	 *
+	 * @param first_group first tile column
+	 * @param last_group last tile column (excluded)
+	 * @param callback called with (index, x, y)
+	 */
+	template<typename TCallback>
+	void forEachCell(uint32_t first_group, uint32_t last_group, TCallback&& callback) const
+	{
+		uint32_t index = getColumnGroupStart(first_group);
+		for (uint32_t tx{first_group}; tx < last_group; ++tx) {
+			for (uint32_t ty{0}; ty < tiles_y; ++ty) {
+				const uint32_t x0 = tx << TileBits;
+				const uint32_t y0 = ty << TileBits;
+				for (uint32_t m{0}; m < tile_area; ++m) {
+					const uint8_t* local = morton_table.coordinates[m];
+					callback(index++, x0 | local[0], y0 | local[1]);
+				}
+			}
+		}
+	}
+
+	static constexpr MortonTable<tile_area> morton_table{};
+};
+
 /**
  * @brief Grid of any type
- * 
+ *
  * @tparam T type of the grid
+ * @tparam TLayout cells memory layout
  */
-template<typename T>
+template<typename T, typename TLayout = ColumnMajorLayout>
 struct Grid
 {
 
 	int32_t width, height;
+	TLayout layout;
 	std::vector<T> data;
 
 	Grid()
@@ -23,7 +277,18 @@ struct Grid
 	Grid(int32_t width_, int32_t height_)
 		: width(width_)
 		, height(height_)
+		, layout(width_, height_)
+	{
+		data.resize(layout.getCellCount());
+	}
+
+	T& get(uint32_t x, uint32_t y)
+	{
+		return data[layout.getIndex(x, y)];
+	}
+
+	const T& get(uint32_t x, uint32_t y) const
 	{
-		data.resize(width * height);
+		return data[layout.getIndex(x, y)];
 	}
 };
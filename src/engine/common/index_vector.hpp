@@ -2,6 +2,11 @@
 
 #include <vector>
 #include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <memory>
+
+#include "paged_array.hpp"
 
 namespace civ
 {
@@ -11,6 +16,38 @@ using ID = uint64_t;
 template<typename T>
 struct PRef;
 
+/**
+ * @brief Storage policy keeping each array contiguous in memory
+ *
+ * @tparam TAllocator allocator template used for the arrays
+ */
+template<template<typename> class TAllocator = std::allocator>
+struct ContiguousStorage
+{
+    template<typename U>
+    using Allocator = TAllocator<U>;
+    template<typename U>
+    using Array     = std::vector<U, TAllocator<U>>;
+};
+
+/**
+ * @brief Storage policy using paged arrays, objects are never relocated when growing
+ *
+ * @tparam PageBits log2 of the number of objects per page
+ * @tparam TAllocator allocator template used for the pages
+ */
+template<uint32_t PageBits = 12, template<typename> class TAllocator = std::allocator>
+struct PagedStorage
+{
+    template<typename U>
+    using Allocator = TAllocator<U>;
+    template<typename U>
+    using Array     = PagedArray<U, PageBits, TAllocator<U>>;
+};
+
+template<typename T, typename TStorage = ContiguousStorage<>>
+struct Ref;
+
 /**
  * @brief Slot of an index vector
  * 
@@ -50,30 +87,55 @@ struct SlotMetadata
 /**
  * @brief Vector of objects with a unique ID
  * 
+ * Objects stored after data_size are kept constructed in a default state,
+ * their lifetime is entirely managed by the underlying arrays.
+ * 
  * @tparam T 
+ * @tparam TStorage storage policy of the data, ids and metadata arrays
  */
-template<typename T>
+template<typename T, typename TStorage = ContiguousStorage<>>
 struct Vector : public GenericProvider
 {
+    template<typename U>
+    using Array          = typename TStorage::template Array<U>;
+    using iterator       = typename Array<T>::iterator;
+    using const_iterator = typename Array<T>::const_iterator;
+
     Vector()
         : data_size(0)
         , op_count(0)
     {}
 
-    ~Vector() override
-    {
-        // Since we already explicitly destroyed objects >= data_size index
-        // the compiler will complain when double freeing these objects.
-        // The quick fix for now is to fill these places with default initialized objects
-        const uint64_t capacity = data.size();
-        for (uint64_t i{data_size}; i<capacity; ++i) {
-            new(&data[i]) T();
-        }
-    }
+    /**
+     * @brief Construct a new Vector using an allocator for its three arrays
+     * 
+     * @param allocator allocator instance, rebound for each array
+     */
+    template<typename TAllocator>
+    explicit
+    Vector(const TAllocator& allocator)
+        : data(typename TStorage::template Allocator<T>(allocator))
+        , ids(typename TStorage::template Allocator<uint64_t>(allocator))
+        , metadata(typename TStorage::template Allocator<SlotMetadata>(allocator))
+        , data_size(0)
+        , op_count(0)
+    {}
 
     // Data ADD / REMOVE
     template<typename... Args>
     ID                 emplace_back(Args&&... args);
+    // Adds count default constructed objects at once, returns the data index of the first one
+    uint64_t           allocate(uint64_t count);
+    // Pre-allocates slots so that capacity objects can be added without reallocation
+    void               reserve(uint64_t capacity);
+    // Erase functions return false if the ID does not refer to a live object
+    bool               erase(ID id);
+    // Also checks the validity ID, so an ID reused by another object is not erased
+    bool               erase(ID id, ID validity);
+    void               eraseViaData(uint64_t data_id);
+    // Fast erase of all objects matching a predicate
+    template<typename TPredicate>
+    uint64_t           remove_if(TPredicate&& predicate);
     // Data access by ID
     T&                 operator[](ID id);
     const T&           operator[](ID id) const;
@@ -81,20 +143,30 @@ struct Vector : public GenericProvider
     [[nodiscard]]
     bool               isValid(ID id, ID validity) const override;
     // Iterators
-    typename std::vector<T>::iterator       begin();
-    typename std::vector<T>::iterator       end();
-    typename std::vector<T>::const_iterator begin() const;
-    typename std::vector<T>::const_iterator end() const;
+    iterator       begin();
+    iterator       end();
+    const_iterator begin() const;
+    const_iterator end() const;
     // Number of objects in the provider
     [[nodiscard]]
     uint64_t size() const;
+    // Returns the ID of the object stored at a data emplacement
+    [[nodiscard]]
+    ID       getID(uint64_t data_id) const;
+    // Validity ID of an object, used to detect slot reuse
+    [[nodiscard]]
+    ID       getValidityID(ID id) const;
+    // Create references to an object
+    Ref<T, TStorage> createRef(ID id);
+    template<typename U>
+    PRef<U>  createPRef(ID id);
 
 public:
-    std::vector<T>            data;
-    std::vector<uint64_t>     ids;
-    std::vector<SlotMetadata> metadata;
-    uint64_t                  data_size;
-    uint64_t                  op_count;
+    Array<T>            data;
+    Array<uint64_t>     ids;
+    Array<SlotMetadata> metadata;
+    uint64_t            data_size;
+    uint64_t            op_count;
 
     [[nodiscard]]
     bool          isFull() const;
@@ -111,65 +183,186 @@ public:
     template<class U> friend struct PRef;
 };
 
-template<typename T>
+template<typename T, typename TStorage>
 template<typename ...Args>
-inline uint64_t Vector<T>::emplace_back(Args&& ...args)
+inline uint64_t Vector<T, TStorage>::emplace_back(Args&& ...args)
 {
     const Slot slot = getSlot();
-    new(&data[slot.data_id]) T(std::forward<Args>(args)...);
+    data[slot.data_id] = T(std::forward<Args>(args)...);
     return slot.id;
 }
 
-template<typename T>
-inline T& Vector<T>::operator[](ID id)
+template<typename T, typename TStorage>
+inline uint64_t Vector<T, TStorage>::allocate(uint64_t count)
+{
+    const uint64_t first_data_id = data_size;
+    const uint64_t new_size      = data_size + count;
+    // First reuse free slots, their objects have been reset on erase
+    const uint64_t reuse_end = std::min(new_size, static_cast<uint64_t>(data.size()));
+    for (uint64_t i{first_data_id}; i < reuse_end; ++i) {
+        metadata[i].op_id = op_count++;
+    }
+    // Then grow all arrays only once
+    if (new_size > data.size()) {
+        const uint64_t previous_capacity = data.size();
+        data.resize(new_size);
+        ids.resize(new_size);
+        metadata.resize(new_size);
+        for (uint64_t i{previous_capacity}; i < new_size; ++i) {
+            ids[i]      = i;
+            metadata[i] = {i, op_count++};
+        }
+    }
+    data_size = new_size;
+    return first_data_id;
+}
+
+template<typename T, typename TStorage>
+inline bool Vector<T, TStorage>::erase(ID id)
+{
+    // Erased objects slots sit after the live range
+    if (id >= ids.size() || getDataID(id) >= data_size) {
+        return false;
+    }
+    eraseViaData(getDataID(id));
+    return true;
+}
+
+template<typename T, typename TStorage>
+inline bool Vector<T, TStorage>::erase(ID id, ID validity)
+{
+    if (id >= ids.size() || !isValid(id, validity)) {
+        return false;
+    }
+    return erase(id);
+}
+
+template<typename T, typename TStorage>
+inline void Vector<T, TStorage>::eraseViaData(uint64_t data_id)
+{
+    // Move the last object in the freed emplacement so data stays packed
+    const uint64_t last_data_id = data_size - 1;
+    if (data_id != last_data_id) {
+        data[data_id] = std::move(data[last_data_id]);
+        std::swap(metadata[data_id], metadata[last_data_id]);
+        ids[metadata[data_id].rid]      = data_id;
+        ids[metadata[last_data_id].rid] = last_data_id;
+    }
+    // The freed slot now sits right after the live range, its ID becomes
+    // the next one to be reused and its op_id is bumped to invalidate references
+    data[last_data_id] = T();
+    metadata[last_data_id].op_id = op_count++;
+    --data_size;
+}
+
+template<typename T, typename TStorage>
+inline void Vector<T, TStorage>::reserve(uint64_t capacity)
+{
+    data.reserve(capacity);
+    ids.reserve(capacity);
+    metadata.reserve(capacity);
+}
+
+template<typename T, typename TStorage>
+template<typename TPredicate>
+inline uint64_t Vector<T, TStorage>::remove_if(TPredicate&& predicate)
+{
+    const uint64_t initial_size = data_size;
+    // Iterating backward ensures that the object swapped in has already been tested
+    for (uint64_t i{data_size}; i--;) {
+        if (predicate(data[i])) {
+            eraseViaData(i);
+        }
+    }
+    return initial_size - data_size;
+}
+
+template<typename T, typename TStorage>
+inline T& Vector<T, TStorage>::operator[](ID id)
 {
     return const_cast<T&>(getAt(id));
 }
 
-template<typename T>
-inline const T& Vector<T>::operator[](ID id) const
+template<typename T, typename TStorage>
+inline const T& Vector<T, TStorage>::operator[](ID id) const
 {
     return getAt(id);
 }
 
-template<typename T>
-inline uint64_t Vector<T>::size() const
+template<typename T, typename TStorage>
+inline uint64_t Vector<T, TStorage>::size() const
 {
     return data_size;
 }
 
-template<typename T>
-inline typename std::vector<T>::iterator Vector<T>::begin()
+template<typename T, typename TStorage>
+inline ID Vector<T, TStorage>::getID(uint64_t data_id) const
+{
+    return metadata[data_id].rid;
+}
+
+template<typename T, typename TStorage>
+inline ID Vector<T, TStorage>::getValidityID(ID id) const
+{
+    return metadata[getDataID(id)].op_id;
+}
+
+template<typename T, typename TStorage>
+inline Ref<T, TStorage> Vector<T, TStorage>::createRef(ID id)
+{
+    Ref<T, TStorage> ref;
+    ref.id          = id;
+    ref.array       = this;
+    ref.validity_id = getValidityID(id);
+    return ref;
+}
+
+template<typename T, typename TStorage>
+template<typename U>
+inline PRef<U> Vector<T, TStorage>::createPRef(ID id)
+{
+    PRef<U> ref;
+    ref.id                = id;
+    ref.provider_callback = [](ID id_, GenericProvider* provider) -> U* {
+        return static_cast<U*>(static_cast<T*>(provider->get(id_)));
+    };
+    ref.provider          = this;
+    ref.validity_id       = getValidityID(id);
+    return ref;
+}
+
+template<typename T, typename TStorage>
+inline typename Vector<T, TStorage>::iterator Vector<T, TStorage>::begin()
 {
     return data.begin();
 }
 
-template<typename T>
-inline typename std::vector<T>::iterator Vector<T>::end()
+template<typename T, typename TStorage>
+inline typename Vector<T, TStorage>::iterator Vector<T, TStorage>::end()
 {
     return data.begin() + data_size;
 }
 
-template<typename T>
-inline typename std::vector<T>::const_iterator Vector<T>::begin() const
+template<typename T, typename TStorage>
+inline typename Vector<T, TStorage>::const_iterator Vector<T, TStorage>::begin() const
 {
     return data.begin();
 }
 
-template<typename T>
-inline typename std::vector<T>::const_iterator Vector<T>::end() const
+template<typename T, typename TStorage>
+inline typename Vector<T, TStorage>::const_iterator Vector<T, TStorage>::end() const
 {
     return data.begin() + data_size;
 }
 
-template<typename T>
-inline bool Vector<T>::isFull() const
+template<typename T, typename TStorage>
+inline bool Vector<T, TStorage>::isFull() const
 {
     return data_size == data.size();
 }
 
-template<typename T>
-inline Slot Vector<T>::createNewSlot()
+template<typename T, typename TStorage>
+inline Slot Vector<T, TStorage>::createNewSlot()
 {
     data.emplace_back();
     ids.push_back(data_size);
@@ -177,47 +370,47 @@ inline Slot Vector<T>::createNewSlot()
     return { data_size, data_size };
 }
 
-template<typename T>
-inline Slot Vector<T>::getFreeSlot()
+template<typename T, typename TStorage>
+inline Slot Vector<T, TStorage>::getFreeSlot()
 {
     const uint64_t reuse_id = metadata[data_size].rid;
     metadata[data_size].op_id = op_count++;
     return { reuse_id, data_size };
 }
 
-template<typename T>
-inline Slot Vector<T>::getSlot()
+template<typename T, typename TStorage>
+inline Slot Vector<T, TStorage>::getSlot()
 {
     const Slot slot = isFull() ? createNewSlot() : getFreeSlot();
     ++data_size;
     return slot;
 }
 
-template<typename T>
-inline uint64_t Vector<T>::getDataID(ID id) const
+template<typename T, typename TStorage>
+inline uint64_t Vector<T, TStorage>::getDataID(ID id) const
 {
     return ids[id];
 }
 
-template<typename T>
-inline const T& Vector<T>::getAt(ID id) const
+template<typename T, typename TStorage>
+inline const T& Vector<T, TStorage>::getAt(ID id) const
 {
     return data[getDataID(id)];
 }
 
-template<typename T>
-inline bool Vector<T>::isValid(ID id, ID validity) const
+template<typename T, typename TStorage>
+inline bool Vector<T, TStorage>::isValid(ID id, ID validity) const
 {
     return validity == metadata[getDataID(id)].op_id;
 }
 
-template<typename T>
-void *Vector<T>::get(civ::ID id)
+template<typename T, typename TStorage>
+void *Vector<T, TStorage>::get(civ::ID id)
 {
     return static_cast<void*>(&data[ids[id]]);
 }
 
-template<typename T>
+template<typename T, typename TStorage>
 struct Ref
 {
     Ref()
@@ -253,9 +446,9 @@ struct Ref
     }
 
 public:
-    ID         id;
-    Vector<T>* array;
-    ID         validity_id;
+    ID                   id;
+    Vector<T, TStorage>* array;
+    ID                   validity_id;
 };
 
 
@@ -299,7 +492,7 @@ private:
     uint64_t            validity_id;
 
     template<class U> friend struct PRef;
-    template<class U> friend struct Vector;
+    template<class U, class S> friend struct Vector;
 };
 
 }
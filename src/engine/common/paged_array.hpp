@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include <utility>
+
+namespace civ
+{
+
+/**
+ * @brief Array storing its elements in fixed size pages
+ *
+ * Growing the array only allocates new pages, existing elements are never relocated
+ * so their addresses stay stable and there is no copy stall when the capacity is exceeded.
+ *
+ * @tparam T type of the elements
+ * @tparam PageBits log2 of the number of elements per page
+ * @tparam TAllocator allocator used for the pages
+ */
+template<typename T, uint32_t PageBits = 12, typename TAllocator = std::allocator<T>>
+struct PagedArray
+{
+    constexpr static uint64_t page_size = uint64_t{1} << PageBits;
+    constexpr static uint64_t page_mask = page_size - 1;
+
+    using value_type     = T;
+    using allocator_type = TAllocator;
+
+    template<typename TValue, typename TArray>
+    struct Iterator
+    {
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = TValue*;
+        using reference         = TValue&;
+
+        TArray*  array = nullptr;
+        uint64_t index = 0;
+
+        reference operator*() const { return (*array)[index]; }
+        pointer   operator->() const { return &(*array)[index]; }
+        reference operator[](difference_type n) const { return (*array)[index + n]; }
+
+        Iterator& operator++() { ++index; return *this; }
+        Iterator& operator--() { --index; return *this; }
+        Iterator  operator++(int) { Iterator it = *this; ++index; return it; }
+        Iterator  operator--(int) { Iterator it = *this; --index; return it; }
+        Iterator& operator+=(difference_type n) { index += n; return *this; }
+        Iterator& operator-=(difference_type n) { index -= n; return *this; }
+        Iterator  operator+(difference_type n) const { return {array, index + n}; }
+        Iterator  operator-(difference_type n) const { return {array, index - n}; }
+        difference_type operator-(const Iterator& other) const
+        {
+            return static_cast<difference_type>(index) - static_cast<difference_type>(other.index);
+        }
+
+        bool operator==(const Iterator& other) const { return index == other.index; }
+        bool operator!=(const Iterator& other) const { return index != other.index; }
+        bool operator<(const Iterator& other) const { return index < other.index; }
+        bool operator>(const Iterator& other) const { return index > other.index; }
+        bool operator<=(const Iterator& other) const { return index <= other.index; }
+        bool operator>=(const Iterator& other) const { return index >= other.index; }
+
+        friend Iterator operator+(difference_type n, const Iterator& it) { return it + n; }
+    };
+
+    using iterator       = Iterator<T, PagedArray>;
+    using const_iterator = Iterator<const T, const PagedArray>;
+
+    PagedArray() = default;
+
+    explicit
+    PagedArray(const TAllocator& allocator_)
+        : allocator{allocator_}
+        , pages{PageTableAllocator(allocator_)}
+    {}
+
+    PagedArray(const PagedArray&) = delete;
+    PagedArray& operator=(const PagedArray&) = delete;
+
+    PagedArray(PagedArray&& other) noexcept
+        : allocator{std::move(other.allocator)}
+        , pages{std::move(other.pages)}
+        , element_count{other.element_count}
+    {
+        other.pages.clear();
+        other.element_count = 0;
+    }
+
+    ~PagedArray()
+    {
+        clear();
+        for (T* page : pages) {
+            AllocatorTraits::deallocate(allocator, page, page_size);
+        }
+    }
+
+    T& operator[](uint64_t i)
+    {
+        return pages[i >> PageBits][i & page_mask];
+    }
+
+    const T& operator[](uint64_t i) const
+    {
+        return pages[i >> PageBits][i & page_mask];
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        reserve(element_count + 1);
+        T* slot = &(*this)[element_count];
+        AllocatorTraits::construct(allocator, slot, std::forward<Args>(args)...);
+        ++element_count;
+        return *slot;
+    }
+
+    void push_back(const T& value)
+    {
+        emplace_back(value);
+    }
+
+    /**
+     * @brief Allocate pages so that at least capacity elements can be stored
+     */
+    void reserve(uint64_t capacity)
+    {
+        while (pages.size() * page_size < capacity) {
+            pages.push_back(AllocatorTraits::allocate(allocator, page_size));
+        }
+    }
+
+    /**
+     * @brief Construct or destroy elements to reach the requested size
+     */
+    void resize(uint64_t new_size)
+    {
+        reserve(new_size);
+        while (element_count < new_size) {
+            AllocatorTraits::construct(allocator, &(*this)[element_count]);
+            ++element_count;
+        }
+        while (element_count > new_size) {
+            --element_count;
+            AllocatorTraits::destroy(allocator, &(*this)[element_count]);
+        }
+    }
+
+    void clear()
+    {
+        resize(0);
+    }
+
+    [[nodiscard]]
+    uint64_t size() const
+    {
+        return element_count;
+    }
+
+    [[nodiscard]]
+    uint64_t capacity() const
+    {
+        return pages.size() * page_size;
+    }
+
+    iterator       begin()       { return {this, 0}; }
+    iterator       end()         { return {this, element_count}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end()   const { return {this, element_count}; }
+
+private:
+    using AllocatorTraits    = std::allocator_traits<TAllocator>;
+    using PageTableAllocator = typename AllocatorTraits::template rebind_alloc<T*>;
+
+    TAllocator                         allocator;
+    std::vector<T*, PageTableAllocator> pages;
+    uint64_t                           element_count = 0;
+};
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace civ
+{
+
+/**
+ * @brief Bounded lock free queue between one producer thread and one consumer thread
+ *
+ * Slots form a ring indexed by two ever increasing counters, each one written by a single
+ * side. Each side keeps a copy of the other counter and only reloads it when the ring looks
+ * full or empty, so the shared cache lines are rarely touched.
+ *
+ * @tparam T element type, default constructible and move assignable
+ * @tparam TCapacity number of slots, a power of two
+ */
+template<typename T, uint32_t TCapacity>
+struct SPSCQueue
+{
+    static_assert(TCapacity && (TCapacity & (TCapacity - 1)) == 0, "Capacity is a power of two");
+
+    static constexpr uint32_t capacity = TCapacity;
+
+    SPSCQueue() = default;
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    /**
+     * @brief Add an element, only called by the producer
+     *
+     * @param value element to add
+     * @return false if the queue is full and the element dropped
+     */
+    bool push(T value)
+    {
+        const uint32_t tail = write_index.load(std::memory_order_relaxed);
+        if (tail - cached_read_index == capacity) {
+            cached_read_index = read_index.load(std::memory_order_acquire);
+            if (tail - cached_read_index == capacity) {
+                return false;
+            }
+        }
+        slots[tail & (capacity - 1)] = std::move(value);
+        write_index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest element, only called by the consumer
+     *
+     * @param value receives the element
+     * @return false if the queue is empty
+     */
+    bool pop(T& value)
+    {
+        const uint32_t head = read_index.load(std::memory_order_relaxed);
+        if (head == cached_write_index) {
+            cached_write_index = write_index.load(std::memory_order_acquire);
+            if (head == cached_write_index) {
+                return false;
+            }
+        }
+        value = std::move(slots[head & (capacity - 1)]);
+        read_index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Number of elements, exact only when called from one of the two sides while the other is idle
+     */
+    [[nodiscard]]
+    uint32_t size() const
+    {
+        return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+    }
+
+private:
+    // Producer side
+    alignas(64) std::atomic<uint32_t> write_index = 0;
+    uint32_t                          cached_read_index = 0;
+    // Consumer side
+    alignas(64) std::atomic<uint32_t> read_index = 0;
+    uint32_t                          cached_write_index = 0;
+
+    alignas(64) std::array<T, TCapacity> slots;
+};
+
+}
@@ -49,6 +49,21 @@ public:
         m_window.draw(drawable, render_states);
     }
 
+    void drawDirect(const sf::Drawable& drawable, sf::RenderStates render_states = {})
+    {
+        m_window.draw(drawable, render_states);
+    }
+
+    sf::Vector2f getMouseWorldPosition() const
+    {
+        return m_viewport_handler.state.mouse_world_position;
+    }
+
+    sf::Vector2f getRenderSize() const
+    {
+        return toVector2f(m_window.getSize());
+    }
+
     void clear(sf::Color color = sf::Color::Black)
     {
         m_window.clear(color);
@@ -1,24 +1,180 @@
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "engine/window_context_handler.hpp"
-#include "engine/common/color_utils.hpp"
 
 #include "physics/physics.hpp"
 #include "thread_pool/thread_pool.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/profiler_overlay.hpp"
+#include "batch/batch_runner.hpp"
+#include "distributed/slab_domain.hpp"
+#include "distributed/shared_memory_transport.hpp"
 
 
-int main()
+/**
+ * @brief Run a parameter sweep without window, see sweep.hpp for the file format
+ *
+ * Usage: --batch <sweep file> [summary csv]
+ */
+int runBatch(int argc, char** argv)
 {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " --batch <sweep file> [summary csv]" << std::endl;
+        return 1;
+    }
+    Sweep sweep;
+    if (!sweep.load(argv[2])) {
+        std::cout << sweep.error << std::endl;
+        return 1;
+    }
+    const std::string output_path = argc > 3 ? argv[3] : "batch.csv";
+    std::ofstream output(output_path);
+    if (!output) {
+        std::cout << "Cannot write " << output_path << std::endl;
+        return 1;
+    }
+
+    // A single pool for all the runs, each solver runs on one worker at a time
+    tp::ThreadPool thread_pool(tp::CpuTopology::detect().getPhysicalCoreCount(), true);
+    BatchRunner runner{sweep, thread_pool};
+    const auto start = std::chrono::steady_clock::now();
+    runner.run();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    runner.writeCSV(output);
+    std::cout << sweep.getRunCount() << " runs in " << seconds << " s, summary written to " << output_path << std::endl;
+    if (const uint32_t failed_count = runner.getFailedCount()) {
+        std::cout << failed_count << " runs not supported by their solver, flagged as failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Run a world split in slabs across processes of this machine, without window
+ *
+ * Usage: --domain <process count> [frames]
+ */
+int runDomain(int argc, char** argv)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " --domain <process count> [frames]" << std::endl;
+        return 1;
+    }
+    const auto     process_count     = static_cast<uint32_t>(std::max(std::stoi(argv[2]), 1));
+    const uint32_t frames            = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 600;
+    const IVec2    world_size{1200, 300};
+    constexpr uint32_t max_objects_count = 200000;
+
+    const std::string name = "/verlet_domain_" + std::to_string(getpid());
+    auto transport = dist::SharedMemoryTransport::create(name, 0, process_count, dist::SlabDomain::getMessageCapacity(world_size));
+    if (!transport) {
+        std::cout << "Cannot create shared memory segment " << name << std::endl;
+        return 1;
+    }
+    // Processes are forked before any thread is started
+    uint32_t rank = 0;
+    std::vector<pid_t> children;
+    for (uint32_t i{1}; i < process_count; ++i) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            rank = i;
+            children.clear();
+            break;
+        }
+        children.push_back(pid);
+    }
+    if (rank > 0) {
+        // Attach like a process launched separately would
+        transport->m_owner = false;
+        transport = dist::SharedMemoryTransport::attach(name, rank);
+        if (!transport) {
+            std::cout << "Process " << rank << " cannot attach to shared memory segment " << name << std::endl;
+            return 1;
+        }
+    }
+
+    tp::ThreadPool thread_pool(std::max(tp::CpuTopology::detect().getPhysicalCoreCount() / process_count, 1u));
+    dist::SlabDomain domain{world_size, *transport, thread_pool};
+    // A row of atoms across the whole world, each process keeps the part above its slab
+    const emitter::Line particle_emitter{{10.0f, 10.0f}, {1.1f, 0.0f}, to<uint32_t>((world_size.x - 20) / 1.1f)};
+    std::vector<Vec2> positions(particle_emitter.getCount());
+    std::vector<Vec2> velocities(particle_emitter.getCount());
+    for (uint32_t k{0}; k < particle_emitter.getCount(); ++k) {
+        positions[k]  = particle_emitter.getPosition(k);
+        // Thrown downward and slightly sideways so atoms mix across the slabs borders
+        velocities[k] = {k % 2 ? 0.1f : -0.1f, 0.3f};
+    }
+
+    const float dt     = 1.0f / 60.0f;
+    const auto  start  = std::chrono::steady_clock::now();
+    bool        failed = false;
+    for (uint32_t frame{0}; frame < frames; ++frame) {
+        const double objects_count = domain.reduceSum(to<double>(domain.solver.objects.size()));
+        if (objects_count + particle_emitter.getCount() <= max_objects_count) {
+            domain.createObjects(positions.data(), velocities.data(), nullptr, particle_emitter.getCount());
+        }
+        // All the processes stop together if any of them could not exchange its border atoms
+        const bool updated = domain.update(dt);
+        if (domain.reduceSum(updated ? 0.0 : 1.0) > 0.0) {
+            if (rank == 0) {
+                std::cout << "Frame " << frame + 1 << ": border atoms exceed the transport capacity" << std::endl;
+            }
+            failed = true;
+            break;
+        }
+        if (rank == 0 && (frame + 1) % 60 == 0) {
+            std::cout << "Frame " << frame + 1 << ": " << objects_count << " atoms" << std::endl;
+        }
+    }
+    const double objects_count = domain.reduceSum(to<double>(domain.solver.objects.size()));
+    const double seconds       = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Process " << rank << " owns " << domain.solver.objects.size() << " atoms" << std::endl;
+    for (const pid_t child : children) {
+        waitpid(child, nullptr, 0);
+    }
+    if (rank == 0 && !failed) {
+        std::cout << frames << " frames of " << objects_count << " atoms over " << process_count << " processes in " << seconds << " s" << std::endl;
+    }
+    return failed ? 1 : 0;
+#else
+    (void)argc;
+    std::cout << argv[0] << ": --domain needs POSIX shared memory" << std::endl;
+    return 1;
+#endif
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return runBatch(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--domain") {
+        return runDomain(argc, argv);
+    }
+
     const uint32_t window_width  = 1920;
     const uint32_t window_height = 1080;
     WindowContextHandler app("Verlet-MultiThread", sf::Vector2u(window_width, window_height), sf::Style::Default);
     RenderContext& render_context = app.getRenderContext();
     // Initialize solver and renderer
 
-    tp::ThreadPool thread_pool(10);
+    // One worker per physical core, pinned so each keeps its slice of the world in its cache and memory node
+    tp::ThreadPool thread_pool(tp::CpuTopology::detect().getPhysicalCoreCount(), true);
     const IVec2 world_size{300, 300};
+    constexpr uint32_t max_objects_count = 80000;
     PhysicSolver solver{world_size, thread_pool};
+    solver.objects.reserve(max_objects_count);
     Renderer renderer(solver, thread_pool);
 
     const float margin = 20.0f;
@@ -26,6 +182,7 @@ int main()
     render_context.setZoom(zoom);
     render_context.setFocus({world_size.x * 0.5f, world_size.y * 0.5f});
 
+    const emitter::Line particle_emitter{{2.0f, 10.0f}, {0.0f, 1.1f}, 20};
     bool emit = true;
     app.getEventManager().addKeyPressedCallback(sf::Keyboard::Space, [&](sfev::CstEv) {
         emit = !emit;
@@ -38,21 +195,168 @@ int main()
         app.setFramerateLimit(target_fps);
     });
 
+    ProfilerOverlay profiler_overlay;
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::P, [&](sfev::CstEv) {
+        profiler_overlay.toggle();
+    });
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::T, [&](sfev::CstEv) {
+        if (prof::Profiler::get().exportChromeTrace("trace.json")) {
+            std::cout << "Profiling trace written to trace.json" << std::endl;
+        }
+    });
+
+    // Draw the atoms or the fluid surface they form
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::M, [&](sfev::CstEv) {
+        renderer.toggleMode();
+    });
+    // Color the atoms by their palette color, velocity, pressure or density
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::K, [&](sfev::CstEv) {
+        renderer.cycleColorMode();
+    });
+
+    // Input callbacks and the emission only push commands, the solver applies them before its next sub step.
+    // Their state is tracked here and the objects limit is applied by the solver, the input side never reads
+    // the solver. The queue is drained by solver.update on this thread, waiting for room would never end:
+    // a command is dropped when the queue is full and the tracked state is only changed once accepted
+    const auto send = [&](const SolverCommand& command) {
+        return solver.commands.push(command);
+    };
+
+    // Pause or resume the simulation
+    bool paused = false;
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::H, [&](sfev::CstEv) {
+        if (send(SolverCommand::make(SolverCommand::Type::TogglePause))) {
+            paused = !paused;
+        }
+    });
+
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::N, [&](sfev::CstEv) {
+        send(SolverCommand::make(SolverCommand::Type::ToggleNeighborList));
+    });
+
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::F, [&](sfev::CstEv) {
+        send(SolverCommand::make(SolverCommand::Type::ToggleFluid));
+    });
+
+    // Cycle the left and right sides between walls, periodic and open
+    BoundaryConditions boundaries;
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::W, [&](sfev::CstEv) {
+        BoundaryConditions next = boundaries;
+        next.x = static_cast<BoundaryMode>((static_cast<uint8_t>(boundaries.x) + 1) % 3);
+        if (send(SolverCommand::makeBoundaries(next))) {
+            boundaries = next;
+        }
+    });
+
+    // Add or remove a funnel, a partly added funnel counts as added so it can be cleared
+    bool funnel_added = false;
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::O, [&](sfev::CstEv) {
+        if (!funnel_added) {
+            const float center = world_size.x * 0.5f;
+            funnel_added |= send(SolverCommand::makeObstacleSegment({center - 80.0f, 120.0f}, {center - 8.0f, 180.0f}, 3.0f));
+            funnel_added |= send(SolverCommand::makeObstacleSegment({center + 80.0f, 120.0f}, {center + 8.0f, 180.0f}, 3.0f));
+            funnel_added |= send(SolverCommand::makeObstacleCircle({center, 230.0f}, 12.0f));
+        } else {
+            funnel_added = !send(SolverCommand::make(SolverCommand::Type::ClearObstacles));
+        }
+    });
+
+    // Drop a few debris, larger and heavier than the particles
+    constexpr uint8_t debris_color = ColorMap::rainbow_size;
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::D, [&](sfev::CstEv) {
+        for (uint32_t i{0}; i < 5; ++i) {
+            const float radius = 1.0f + to<float>(i);
+            send(SolverCommand::makeSpawn({world_size.x * 0.5f + to<float>(i) * 12.0f, 20.0f}, radius, debris_color));
+        }
+    });
+
+    // Add a rotating mixer and floating bodies, or remove all bodies
+    bool bodies_added = false;
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::B, [&](sfev::CstEv) {
+        if (!bodies_added) {
+            const float center = world_size.x * 0.5f;
+            RigidBody mixer = RigidBody::makePolygon({center, 40.0f}, {{-40.0f, -2.0f}, {40.0f, -2.0f}, {40.0f, 2.0f}, {-40.0f, 2.0f}}, 0.0f);
+            mixer.angular_velocity = 1.5f;
+            bodies_added |= solver.commands.pushBody(std::move(mixer));
+            for (uint32_t i{0}; i < 8; ++i) {
+                const Vec2 position{center - 140.0f + to<float>(i) * 40.0f, 10.0f};
+                if (i % 2) {
+                    bodies_added |= solver.commands.pushBody(RigidBody::makeCircle(position, 4.0f, 0.5f));
+                } else {
+                    bodies_added |= solver.commands.pushBody(RigidBody::makePolygon(position, {{-4.0f, -4.0f}, {4.0f, -4.0f}, {4.0f, 4.0f}, {-4.0f, 4.0f}}, 0.5f));
+                }
+            }
+        } else {
+            bodies_added = !send(SolverCommand::make(SolverCommand::Type::ClearBodies));
+        }
+    });
+
+    // Right button attracts atoms toward the mouse, middle button repels them
+    float mouse_strength = 0.0f;
+    app.getEventManager().addMousePressedCallback(sf::Mouse::Right, [&](sfev::CstEv) {
+        mouse_strength = 800.0f;
+    });
+    app.getEventManager().addMousePressedCallback(sf::Mouse::Middle, [&](sfev::CstEv) {
+        mouse_strength = -800.0f;
+    });
+    app.getEventManager().addMouseReleasedCallback(sf::Mouse::Right, [&](sfev::CstEv) {
+        mouse_strength = 0.0f;
+    });
+    app.getEventManager().addMouseReleasedCallback(sf::Mouse::Middle, [&](sfev::CstEv) {
+        mouse_strength = 0.0f;
+    });
+    // Explosion and permanent vortex at the mouse position
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::X, [&](sfev::CstEv) {
+        send(SolverCommand::makeForceField(ForceField::makeExplosion(render_context.getMouseWorldPosition(), 30.0f, 4000.0f)));
+    });
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::V, [&](sfev::CstEv) {
+        send(SolverCommand::makeForceField(ForceField::makeVortex(render_context.getMouseWorldPosition(), 40.0f, 300.0f)));
+    });
+
+    app.getEventManager().addKeyPressedCallback(sf::Keyboard::C, [&](sfev::CstEv) {
+        send(SolverCommand::make(SolverCommand::Type::ToggleStats));
+    });
+    std::ofstream stats_file;
+
     // Main loop
     const float dt = 1.0f / static_cast<float>(fps_cap);
+    const Vec2  emit_velocity{0.2f, 0.0f};
+    uint64_t    emitted_count = 0;
+    bool        objects_full  = false;
     while (app.run()) {
-        if (solver.objects.size() < 80000 && emit) {
-            for (uint32_t i{20}; i--;) {
-                const auto id = solver.createObject({2.0f, 10.0f + 1.1f * i});
-                solver.objects[id].last_position.x -= 0.2f;
-                solver.objects[id].color = ColorUtils::getRainbow(id * 0.0001f);
+        prof::Profiler::get().newFrame();
+        // Input side, the whole line is created by the solver at once, nothing piles up while paused
+        if (emit && !paused) {
+            const uint8_t color = ColorMap::getRainbowIndex(to<float>(emitted_count) * 0.0001f);
+            if (send(SolverCommand::makeEmit(particle_emitter, emit_velocity, color, max_objects_count))) {
+                emitted_count += particle_emitter.getCount();
             }
         }
 
+        if (mouse_strength != 0.0f) {
+            // Lasts one frame, added again while the button is held
+            send(SolverCommand::makeForceField(ForceField::makeAttractor(render_context.getMouseWorldPosition(), 25.0f, mouse_strength, dt)));
+        }
+
+        // Solver side, only this part reads the solver state besides the renderer
         solver.update(dt);
+        // Objects were created by the main thread
+        const bool full = solver.objects.size() >= max_objects_count;
+        if (full && !objects_full) {
+            solver.distributeMemory();
+        }
+        objects_full = full;
+        if (solver.stats_enabled) {
+            if (!stats_file.is_open()) {
+                stats_file.open("stats.csv");
+                SolverStats::writeCSVHeader(stats_file);
+            }
+            solver.stats.writeCSV(stats_file);
+        }
 
         render_context.clear();
         renderer.render(render_context);
+        profiler_overlay.render(render_context);
         render_context.display();
     }
 
@@ -22,10 +22,13 @@ struct CollisionCell {
 	 * @brief Add an atom to the cell
 	 * 
 	 * @param id id of the atom
+	 * @return false if the cell was full and the atom dropped
 	 */
-	void addAtom(uint32_t id) {
+	bool addAtom(uint32_t id) {
+        const bool stored = objects_count < max_cell_idx;
         objects[objects_count] = id;
-        objects_count += objects_count < max_cell_idx;
+        objects_count += stored;
+        return stored;
 	}
 
 	/**
@@ -52,8 +55,16 @@ struct CollisionCell {
     }
 };
 
-struct CollisionGrid : public Grid<CollisionCell> {
-	CollisionGrid() : Grid<CollisionCell>() {}
+/**
+ * @brief Grid of collision cells
+ * 
+ * @tparam TLayout cells memory layout
+ */
+template<typename TLayout = ColumnMajorLayout>
+struct BasicCollisionGrid : public Grid<CollisionCell, TLayout> {
+	using Layout = TLayout;
+
+	BasicCollisionGrid() : Grid<CollisionCell, TLayout>() {}
 
 	/**
 	 * @brief Construct a new Collision Grid object
@@ -61,7 +72,7 @@ struct CollisionGrid : public Grid<CollisionCell> {
 	 * @param width width of the grid
 	 * @param height height of the grid
 	 */
-	CollisionGrid(int32_t width, int32_t height) : Grid<CollisionCell>(width, height) {}
+	BasicCollisionGrid(int32_t width, int32_t height) : Grid<CollisionCell, TLayout>(width, height) {}
 
 	/**
 	 * @brief Add an atom to the grid
@@ -72,21 +83,18 @@ struct CollisionGrid : public Grid<CollisionCell> {
 	 * @return true if the atom was added
 	 */
 	bool addAtom(uint32_t x, uint32_t y, uint32_t atom) {
-		const uint32_t id = x * height + y;
-		data[id].addAtom(atom);
-		return true;
+		return this->get(x, y).addAtom(atom);
 	}
 
 	/**
-	 * @brief Remove an atom from the grid
+	 * @brief Remove all atoms from the grid
 	 * 
-	 * @param x x coordinate of the atom
-	 * @param y y coordinate of the atom
-	 * @param atom id of the atom
 	 */
 	void clear() {
-		for (auto& c : data) {
+		for (auto& c : this->data) {
             c.objects_count = 0;
         }
 	}
 };
+
+using CollisionGrid = BasicCollisionGrid<ColumnMajorLayout>;
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+
+/**
+ * @brief IEEE 754 half precision conversions, portable bit manipulations without F16C
+ */
+struct Half
+{
+    /**
+     * @brief Round a float to the nearest half, ties to even
+     */
+    static uint16_t encode(float value)
+    {
+        return encode(value, rounding_nearest);
+    }
+
+    /**
+     * @brief Round a float to a neighbor half with a probability given by its distance to it
+     *
+     * Unbiased on average, so repeated small updates of a value are not lost to rounding.
+     *
+     * @param value value to convert
+     * @param dither uniform random value in [0, 0x1fff], ignored for subnormals
+     */
+    static uint16_t encodeStochastic(float value, uint32_t dither)
+    {
+        return encode(value, dither & 0x1fffu);
+    }
+
+private:
+    // Marks round to nearest even, stochastic dithers are 13 bits values
+    static constexpr uint32_t rounding_nearest = 0xffffffffu;
+
+    static uint16_t encode(float value, uint32_t dither)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = bits & 0x80000000u;
+        bits ^= sign;
+        uint32_t half;
+        if (bits >= (127u + 16u) << 23) {
+            // Overflow to infinity, NaN stays NaN
+            half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+        } else if (bits < 113u << 23) {
+            // Subnormal or zero, the float addition performs the rounding
+            const uint32_t magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+            float value_abs, magic;
+            std::memcpy(&value_abs, &bits, sizeof(bits));
+            std::memcpy(&magic, &magic_bits, sizeof(magic_bits));
+            const float sum = value_abs + magic;
+            std::memcpy(&half, &sum, sizeof(sum));
+            half -= magic_bits;
+        } else {
+            const uint32_t mantissa_odd = (bits >> 13) & 1u;
+            // Rebias the exponent, the low bits round the mantissa
+            bits += ((15u - 127u) << 23) + (dither == rounding_nearest ? 0xfffu + mantissa_odd : dither);
+            half = bits >> 13;
+        }
+        return static_cast<uint16_t>(half | (sign >> 16));
+    }
+
+public:
+    static float decode(uint16_t half)
+    {
+        const uint32_t exponent_mask = 0x7c00u << 13;
+        uint32_t bits = (half & 0x7fffu) << 13;
+        const uint32_t exponent = bits & exponent_mask;
+        bits += (127u - 15u) << 23;
+        if (exponent == exponent_mask) {
+            // Infinity or NaN
+            bits += (128u - 16u) << 23;
+        } else if (exponent == 0) {
+            // Subnormal, renormalized by a float subtraction
+            const uint32_t magic_bits = 113u << 23;
+            bits += 1u << 23;
+            float value, magic;
+            std::memcpy(&value, &bits, sizeof(bits));
+            std::memcpy(&magic, &magic_bits, sizeof(magic_bits));
+            value -= magic;
+            std::memcpy(&bits, &value, sizeof(value));
+        }
+        bits |= static_cast<uint32_t>(half & 0x8000u) << 16;
+        float value;
+        std::memcpy(&value, &bits, sizeof(bits));
+        return value;
+    }
+};
+
+/**
+ * @brief Quantized atom stored by CompactPhysicSolver, 10 bytes instead of the 36 of PhysicObject
+ *
+ * The cell holding the atom is implied by its storage slot, the position is a fixed point
+ * offset from the cell origin, which keeps the same precision whatever the world size.
+ * Velocities are displacements per sub step, the color is the palette index of PhysicObject.
+ */
+struct CompactObject
+{
+    // Fixed point positions step, offsets cover [-2, 2) cells so contacts can push atoms out of their cell
+    static constexpr float position_scale = 16384.0f;
+
+    int16_t  position_x = 0;
+    int16_t  position_y = 0;
+    uint16_t velocity_x = 0;
+    uint16_t velocity_y = 0;
+    uint8_t  color      = 0;
+    uint8_t  padding    = 0;
+
+    /**
+     * @brief Position relative to the origin of a cell
+     */
+    [[nodiscard]]
+    Vec2 getPosition() const
+    {
+        return {to<float>(position_x) / position_scale, to<float>(position_y) / position_scale};
+    }
+
+    [[nodiscard]]
+    Vec2 getVelocity() const
+    {
+        return {Half::decode(velocity_x), Half::decode(velocity_y)};
+    }
+
+    void setVelocity(Vec2 velocity)
+    {
+        velocity_x = Half::encode(velocity.x);
+        velocity_y = Half::encode(velocity.y);
+    }
+
+    /**
+     * @brief Store a position relative to the cell origin, rounded to the nearest fixed point step
+     */
+    void setPosition(Vec2 position)
+    {
+        position_x = quantize(position.x, 0.5f);
+        position_y = quantize(position.y, 0.5f);
+    }
+
+    /**
+     * @brief Store a velocity and a position with stochastic rounding
+     *
+     * Per sub step changes from gravity and damping are below the fixed point step and the half
+     * precision step of common velocities, a round to nearest would lose them at each update.
+     *
+     * @param position position relative to the cell origin
+     * @param velocity velocity to store
+     * @param seed step dependent seed, combined with the current position to get the dither
+     */
+    void setState(Vec2 position, Vec2 velocity, uint32_t seed)
+    {
+        const uint32_t position_dither = getDither(seed);
+        position_x = quantize(position.x, to<float>(position_dither & 0xffffu) / 65536.0f);
+        position_y = quantize(position.y, to<float>(position_dither >> 16) / 65536.0f);
+        const uint32_t velocity_dither = getDither(~seed);
+        velocity_x = Half::encodeStochastic(velocity.x, velocity_dither);
+        velocity_y = Half::encodeStochastic(velocity.y, velocity_dither >> 13);
+    }
+
+    /**
+     * @brief Hash of the position and a seed, deterministic for a given simulation
+     */
+    [[nodiscard]]
+    uint32_t getDither(uint32_t seed) const
+    {
+        uint32_t h = (static_cast<uint32_t>(static_cast<uint16_t>(position_x)) | (static_cast<uint32_t>(static_cast<uint16_t>(position_y)) << 16)) ^ (seed * 0x9e3779b9u);
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    /**
+     * @brief Convert an offset to fixed point
+     *
+     * @param offset offset from the cell origin
+     * @param dither added before truncation, 0.5 rounds to nearest
+     */
+    static int16_t quantize(float offset, float dither)
+    {
+        const float scaled = std::floor(offset * position_scale + dither);
+        const float min    = to<float>(std::numeric_limits<int16_t>::min());
+        const float max    = to<float>(std::numeric_limits<int16_t>::max());
+        return static_cast<int16_t>(std::min(std::max(scaled, min), max));
+    }
+};
+
+static_assert(sizeof(CompactObject) == 10, "CompactObject is stored without padding");
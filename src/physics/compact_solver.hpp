@@ -0,0 +1,684 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "compact_object.hpp"
+#include "physic_object.hpp"
+#include "radius_model.hpp"
+#include "solver_config.hpp"
+#include "solver_stats.hpp"
+#include "engine/common/utils.hpp"
+#include "thread_pool/thread_pool.hpp"
+#include "profiler/profiler.hpp"
+
+/**
+ * @brief Solver storing quantized atoms sorted by cell, for memory bound large worlds
+ *
+ * Atoms are stored as CompactObject, grouped by cell in column major order: the atoms of cell c
+ * are objects[cell_offsets[c]] to objects[cell_offsets[c + 1]]. This storage is the collision
+ * grid, cells have no capacity. Contacts are solved in the frame of the processed cell on a
+ * window of three decoded columns, and the integration decodes atoms in registers and sorts them
+ * by their new cell while writing them back, the same way GridBins does.
+ *
+ * Contacts and integration follow BasicPhysicSolver with UniformRadius and walls: atoms all have
+ * the default radius, there are no bodies, fluid, obstacles, force fields or boundary modes.
+ * The storage order changes on each sub step, atoms have no stable index.
+ *
+ * @tparam TConfig compile time configuration, the radius model is ignored
+ */
+template<typename TConfig = DefaultSolverConfig>
+struct CompactPhysicSolver
+{
+    /**
+     * @brief Atom waiting to be stored in its cell
+     */
+    struct Entry
+    {
+        uint32_t      cell;
+        CompactObject object;
+    };
+
+    /**
+     * @brief Atom sorted by destination cell
+     */
+    struct Slot
+    {
+        uint32_t cell;
+        uint32_t atom_idx;
+    };
+
+    using ColumnWindow = std::array<std::vector<Vec2>, 3>;
+
+    IVec2                      grid_size;
+    Vec2                       world_size;
+    Vec2                       gravity = {0.0f, 20.0f};
+    typename TConfig::Damping  damping;
+    // Simulation solving pass count
+    uint32_t                   sub_steps;
+    // Sub steps performed so far, seeds the velocities rounding
+    uint32_t                   step_count = 0;
+    tp::ThreadPool&            thread_pool;
+    std::vector<CompactObject> objects;
+    std::vector<uint32_t>      cell_offsets;
+    // Atoms created since the last update, stored on the next one
+    std::vector<Entry>         created;
+
+    // Sorting buffers, one bucket per (source stripe, destination stripe) and a last batch for created atoms
+    std::vector<std::vector<Slot>>  buckets;
+    std::vector<uint32_t>           stripe_starts;
+    std::vector<CompactObject>      sorted_objects;
+    // Per task positions of three consecutive columns, relative to their cell, indexed by column modulo 3
+    std::vector<ColumnWindow>       column_windows;
+
+    bool                          stats_enabled = false;
+    SolverStats                   stats;
+    std::vector<StatsAccumulator> stats_accumulators;
+    std::vector<double>           stats_energy;
+    std::vector<float>            stats_velocity;
+
+    /**
+     * @brief Create a solver
+     *
+     * @param size size of the world
+     * @param tp thread pool to use
+     */
+    CompactPhysicSolver(IVec2 size, tp::ThreadPool& tp)
+        : grid_size{size}
+        , world_size{to<float>(size.x), to<float>(size.y)}
+        , sub_steps{TConfig::sub_steps}
+        , thread_pool{tp}
+        , cell_offsets(to<uint64_t>(size.x) * size.y + 1, 0)
+    {}
+
+    [[nodiscard]]
+    uint64_t getObjectsCount() const
+    {
+        return objects.size() + created.size();
+    }
+
+    /**
+     * @brief Add objects in bulk from arrays of attributes
+     *
+     * Positions are clamped to the world cells and must be within a few cells of it.
+     *
+     * @param positions positions of the objects
+     * @param velocities initial velocities expressed as a displacement per sub step, can be null
+     * @param colors palette indices of the objects colors, can be null
+     * @param count number of objects to create
+     * @return the number of created objects
+     */
+    uint64_t createObjects(const Vec2* positions, const Vec2* velocities, const uint8_t* colors, uint32_t count)
+    {
+        created.reserve(created.size() + count);
+        for (uint32_t k{0}; k < count; ++k) {
+            const IVec2 cell = getCell(positions[k]);
+            Entry entry{getCellIndex(cell), {}};
+            entry.object.setPosition(positions[k] - toVec2(cell));
+            entry.object.setVelocity(velocities ? velocities[k] : Vec2{});
+            entry.object.color = colors ? colors[k] : 0;
+            created.push_back(entry);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Remove all objects located inside a rectangular region
+     *
+     * @param region_min top left corner of the region
+     * @param region_max bottom right corner of the region
+     * @return the number of removed objects
+     */
+    uint64_t removeInRegion(Vec2 region_min, Vec2 region_max)
+    {
+        const auto is_inside = [region_min, region_max](Vec2 position) {
+            return position.x >= region_min.x && position.x <= region_max.x &&
+                   position.y >= region_min.y && position.y <= region_max.y;
+        };
+        const uint64_t objects_count = getObjectsCount();
+        // Compact the storage in place, cells keep their order
+        uint32_t kept = 0;
+        for (int32_t x{0}; x < grid_size.x; ++x) {
+            for (int32_t y{0}; y < grid_size.y; ++y) {
+                const uint32_t cell  = getCellIndex({x, y});
+                const uint32_t first = cell_offsets[cell];
+                const uint32_t last  = cell_offsets[cell + 1];
+                cell_offsets[cell] = kept;
+                for (uint32_t i{first}; i < last; ++i) {
+                    if (!is_inside(Vec2{to<float>(x), to<float>(y)} + objects[i].getPosition())) {
+                        objects[kept++] = objects[i];
+                    }
+                }
+            }
+        }
+        cell_offsets.back() = kept;
+        objects.resize(kept);
+        created.erase(std::remove_if(created.begin(), created.end(), [&](const Entry& entry) {
+            return is_inside(toVec2(getCellCoords(entry.cell)) + entry.object.getPosition());
+        }), created.end());
+        return objects_count - getObjectsCount();
+    }
+
+    /**
+     * @brief Decode all the objects, the storage order changes on each update
+     *
+     * @param decoded receives the objects, created ones last
+     */
+    void decode(std::vector<PhysicObject>& decoded) const
+    {
+        decoded.resize(getObjectsCount());
+        thread_pool.dispatch(to<uint32_t>(grid_size.x), [&](uint32_t start, uint32_t end) {
+            for (uint32_t x{start}; x < end; ++x) {
+                for (int32_t y{0}; y < grid_size.y; ++y) {
+                    const IVec2    cell{to<int32_t>(x), y};
+                    const uint32_t cell_idx = getCellIndex(cell);
+                    for (uint32_t i{cell_offsets[cell_idx]}; i < cell_offsets[cell_idx + 1]; ++i) {
+                        decoded[i] = decodeObject(objects[i], cell);
+                    }
+                }
+            }
+        });
+        for (uint32_t k{0}; k < created.size(); ++k) {
+            decoded[objects.size() + k] = decodeObject(created[k].object, getCellCoords(created[k].cell));
+        }
+    }
+
+    /**
+     * @brief Update the solver
+     *
+     * @param dt time step
+     */
+    void update(float dt)
+    {
+        PROFILE_SCOPE("update");
+        if (stats_enabled) {
+            stats.reset(sub_steps);
+        }
+        if (!created.empty()) {
+            sortObjects(false, 0.0f);
+        }
+        const float sub_dt = dt / static_cast<float>(sub_steps);
+        for (uint32_t i{0}; i < sub_steps; ++i) {
+            PROFILE_SCOPE("substep");
+            resetStatsAccumulators();
+            {
+                PROFILE_SCOPE("collisions");
+                solveCollisionsPass(0);
+                solveCollisionsPass(1);
+            }
+            if (stats_enabled) {
+                reduceSubStepStats(i);
+            }
+            sortObjects(true, sub_dt);
+            ++step_count;
+        }
+        if (stats_enabled) {
+            computeFrameStats(sub_dt);
+        }
+    }
+
+private:
+    [[nodiscard]]
+    uint32_t getCellIndex(IVec2 cell) const
+    {
+        return to<uint32_t>(cell.x * grid_size.y + cell.y);
+    }
+
+    [[nodiscard]]
+    IVec2 getCellCoords(uint32_t cell_idx) const
+    {
+        return {to<int32_t>(cell_idx) / grid_size.y, to<int32_t>(cell_idx) % grid_size.y};
+    }
+
+    /**
+     * @brief Cell containing a position, clamped to the grid
+     */
+    [[nodiscard]]
+    IVec2 getCell(Vec2 position) const
+    {
+        return {std::min(std::max(to<int32_t>(std::floor(position.x)), 0), grid_size.x - 1),
+                std::min(std::max(to<int32_t>(std::floor(position.y)), 0), grid_size.y - 1)};
+    }
+
+    static Vec2 toVec2(IVec2 v)
+    {
+        return {to<float>(v.x), to<float>(v.y)};
+    }
+
+    PhysicObject decodeObject(const CompactObject& compact, IVec2 cell) const
+    {
+        PhysicObject obj{toVec2(cell) + compact.getPosition()};
+        obj.last_position -= compact.getVelocity();
+        obj.color          = compact.color;
+        return obj;
+    }
+
+    /**
+     * @brief Stripe of columns filled by a sorting task
+     */
+    [[nodiscard]]
+    uint32_t getStripe(int32_t x) const
+    {
+        return to<uint32_t>(x) * thread_pool.m_thread_count / to<uint32_t>(grid_size.x);
+    }
+
+    /**
+     * @brief First column of a stripe, smallest column such that getStripe(column) == stripe_idx
+     */
+    [[nodiscard]]
+    int32_t getStripeStart(uint32_t stripe_idx) const
+    {
+        const uint32_t stripe_count = thread_pool.m_thread_count;
+        return to<int32_t>((stripe_idx * to<uint32_t>(grid_size.x) + stripe_count - 1) / stripe_count);
+    }
+
+    /**
+     * @brief Move the atoms to the slots of their cell, integrating them on the way
+     *
+     * Atoms are read by source stripe, bucketed by destination stripe, then each destination
+     * stripe counts and scatters its atoms in source order.
+     *
+     * @param integrate if false, atoms only are sorted, used to store the created atoms
+     * @param dt time step
+     */
+    void sortObjects(bool integrate, float dt)
+    {
+        PROFILE_SCOPE(integrate ? "integration" : "sort");
+        const uint32_t stripe_count = thread_pool.m_thread_count;
+        buckets.resize((stripe_count + 1) * stripe_count);
+        for (std::vector<Slot>& bucket : buckets) {
+            bucket.clear();
+        }
+        // Created atoms are appended, they are not integrated
+        const auto stored_count = to<uint32_t>(objects.size());
+        objects.reserve(stored_count + created.size());
+        for (const Entry& entry : created) {
+            buckets[stripe_count * stripe_count + getStripe(getCellCoords(entry.cell).x)].push_back({entry.cell, to<uint32_t>(objects.size())});
+            objects.push_back(entry.object);
+        }
+        created.clear();
+        for (uint32_t i{0}; i < stripe_count; ++i) {
+            thread_pool.addTask(i, [this, i, integrate, dt]{
+                bucketStripe(i, integrate, dt);
+            });
+        }
+        thread_pool.waitForCompletion();
+        stripe_starts.assign(stripe_count + 1, 0);
+        for (uint32_t i{0}; i < stripe_count; ++i) {
+            thread_pool.addTask(i, [this, i]{
+                stripe_starts[i + 1] = countStripe(i);
+            });
+        }
+        thread_pool.waitForCompletion();
+        for (uint32_t i{0}; i < stripe_count; ++i) {
+            stripe_starts[i + 1] += stripe_starts[i];
+        }
+        sorted_objects.resize(stripe_starts[stripe_count]);
+        for (uint32_t i{0}; i < stripe_count; ++i) {
+            thread_pool.addTask(i, [this, i]{
+                scatterStripe(i);
+            });
+        }
+        thread_pool.waitForCompletion();
+        cell_offsets.back() = stripe_starts[stripe_count];
+        objects.swap(sorted_objects);
+    }
+
+    void bucketStripe(uint32_t stripe_idx, bool integrate, float dt)
+    {
+        std::vector<Slot>* batch = &buckets[stripe_idx * thread_pool.m_thread_count];
+        const uint32_t first_cell = getCellIndex({getStripeStart(stripe_idx), 0});
+        const uint32_t last_cell  = getCellIndex({getStripeStart(stripe_idx + 1), 0});
+        // Atoms are read in storage order, the cell follows them
+        uint32_t cell_idx = first_cell;
+        for (uint32_t i{cell_offsets[first_cell]}; i < cell_offsets[last_cell]; ++i) {
+            while (cell_offsets[cell_idx + 1] <= i) {
+                ++cell_idx;
+            }
+            if (integrate) {
+                const IVec2 new_cell = integrateObject(objects[i], getCellCoords(cell_idx), dt);
+                batch[getStripe(new_cell.x)].push_back({getCellIndex(new_cell), i});
+            } else {
+                batch[stripe_idx].push_back({cell_idx, i});
+            }
+        }
+    }
+
+    /**
+     * @brief Apply Verlet integration and the world borders to an atom, in the frame of its cell
+     *
+     * @param obj the atom, its position is rewritten relative to its new cell
+     * @param cell current cell of the atom
+     * @param dt time step
+     * @return the new cell of the atom
+     */
+    IVec2 integrateObject(CompactObject& obj, IVec2 cell, float dt) const
+    {
+        const Vec2 position = obj.getPosition();
+        const Vec2 velocity = obj.getVelocity();
+        Vec2 last_position  = position;
+        Vec2 new_position   = position + velocity + (gravity + damping.getAcceleration(velocity)) * (dt * dt);
+        const float margin  = UniformRadius::template getBorderMargin<TConfig>(AtomShape{});
+        const Vec2  origin  = toVec2(cell);
+        TConfig::Boundary::applyAxis(new_position.x, last_position.x, margin - origin.x, world_size.x - margin - origin.x);
+        TConfig::Boundary::applyAxis(new_position.y, last_position.y, margin - origin.y, world_size.y - margin - origin.y);
+        const IVec2 new_cell = getCell(origin + new_position);
+        obj.setState(new_position - (toVec2(new_cell) - origin), new_position - last_position, step_count);
+        return new_cell;
+    }
+
+    /**
+     * @brief Count the atoms of each cell of a stripe, cell offsets are made relative to the stripe
+     *
+     * @return the number of atoms of the stripe
+     */
+    uint32_t countStripe(uint32_t stripe_idx)
+    {
+        const uint32_t stripe_count = thread_pool.m_thread_count;
+        const uint32_t first_cell   = getCellIndex({getStripeStart(stripe_idx), 0});
+        const uint32_t last_cell    = getCellIndex({getStripeStart(stripe_idx + 1), 0});
+        std::fill(cell_offsets.begin() + first_cell, cell_offsets.begin() + last_cell, 0);
+        for (uint32_t b{0}; b <= stripe_count; ++b) {
+            for (const Slot& slot : buckets[b * stripe_count + stripe_idx]) {
+                ++cell_offsets[slot.cell];
+            }
+        }
+        uint32_t count = 0;
+        for (uint32_t c{first_cell}; c < last_cell; ++c) {
+            const uint32_t cell_count = cell_offsets[c];
+            cell_offsets[c] = count;
+            count += cell_count;
+        }
+        return count;
+    }
+
+    void scatterStripe(uint32_t stripe_idx)
+    {
+        const uint32_t stripe_count = thread_pool.m_thread_count;
+        const uint32_t first_cell   = getCellIndex({getStripeStart(stripe_idx), 0});
+        const uint32_t last_cell    = getCellIndex({getStripeStart(stripe_idx + 1), 0});
+        if (first_cell == last_cell) {
+            return;
+        }
+        const uint32_t start = stripe_starts[stripe_idx];
+        for (uint32_t c{first_cell}; c < last_cell; ++c) {
+            cell_offsets[c] += start;
+        }
+        // Offsets are used as insertion cursors then shifted back
+        for (uint32_t b{0}; b <= stripe_count; ++b) {
+            for (const Slot& slot : buckets[b * stripe_count + stripe_idx]) {
+                sorted_objects[cell_offsets[slot.cell]++] = objects[slot.atom_idx];
+            }
+        }
+        for (uint32_t c{last_cell - 1}; c > first_cell; --c) {
+            cell_offsets[c] = cell_offsets[c - 1];
+        }
+        cell_offsets[first_cell] = start;
+    }
+
+    /**
+     * @brief Get the columns of a collision slice, same split as BasicPhysicSolver
+     *
+     * @param slice_idx index of the slice, the last one holds the rest of the grid
+     * @param start receives the first column
+     * @param end receives the last column (excluded)
+     */
+    void getCollisionSlice(uint32_t slice_idx, int32_t& start, int32_t& end) const
+    {
+        const uint32_t slice_count = thread_pool.m_thread_count * 2;
+        const uint32_t slice_size  = to<uint32_t>(grid_size.x) / slice_count;
+        if (slice_idx < slice_count) {
+            start = to<int32_t>(slice_idx * slice_size);
+            end   = to<int32_t>((slice_idx + 1) * slice_size);
+        } else {
+            start = to<int32_t>(slice_count * slice_size);
+            end   = grid_size.x;
+        }
+    }
+
+    /**
+     * @brief Process one every two slices, consecutive slices are never processed concurrently
+     *
+     * @param pass 0 for even slices, 1 for odd slices
+     */
+    void solveCollisionsPass(uint32_t pass)
+    {
+        const uint32_t thread_count = thread_pool.m_thread_count;
+        column_windows.resize(thread_pool.getBatchCount());
+        for (uint32_t i{0}; i < thread_count; ++i) {
+            thread_pool.addTask(i, [this, i, pass]{
+                solveCollisionThreaded(2 * i + pass, i);
+            });
+        }
+        // The rest slice is not adjacent to the last even slice, the calling thread processes it
+        int32_t rest_start, rest_end;
+        getCollisionSlice(2 * thread_count, rest_start, rest_end);
+        if (pass == 0 && rest_start < rest_end) {
+            solveCollisionThreaded(2 * thread_count, thread_count);
+        }
+        thread_pool.waitForCompletion();
+    }
+
+    void solveCollisionThreaded(uint32_t slice_idx, uint32_t task_idx)
+    {
+        if (stats_enabled) {
+            solveCollisionSlice(slice_idx, column_windows[task_idx], stats_accumulators[task_idx]);
+        } else {
+            NoStats no_stats;
+            solveCollisionSlice(slice_idx, column_windows[task_idx], no_stats);
+        }
+    }
+
+    /**
+     * @brief Checks collisions for all the atoms of a slice
+     *
+     * Columns are decoded one ahead of the processed one, relative to their cell, and the moved
+     * atoms of a column are stored back once its last neighbor column is processed. Only three
+     * columns are decoded at a time, the slice itself is read and written once.
+     *
+     * @param slice_idx index of the slice
+     * @param window decoding buffers of the calling thread
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TStats>
+    void solveCollisionSlice(uint32_t slice_idx, ColumnWindow& window, TStats& contact_stats)
+    {
+        int32_t start, end;
+        getCollisionSlice(slice_idx, start, end);
+        const int32_t x_first = std::max(start - 1, 0);
+        const int32_t x_last  = std::min(end + 1, grid_size.x);
+        // Index of the first atom of each decoded column
+        uint32_t column_first[3];
+        for (int32_t x{x_first}; x <= x_last; ++x) {
+            if (x < x_last) {
+                column_first[x % 3] = decodeColumn(x, window[x % 3]);
+            }
+            // Column x - 1 and its neighbors are decoded
+            if (x - 1 >= start && x - 1 < end) {
+                for (int32_t y{0}; y < grid_size.y; ++y) {
+                    processCell({x - 1, y}, window, column_first, contact_stats);
+                }
+            }
+            // Column x - 2 is not a neighbor of the columns left to process
+            if (x - 2 >= x_first) {
+                storeColumn(x - 2, window[(x - 2) % 3]);
+            }
+        }
+        storeColumn(x_last - 1, window[(x_last - 1) % 3]);
+    }
+
+    /**
+     * @brief Decodes the atoms of a column, relative to their cell
+     *
+     * @return index of the first atom of the column
+     */
+    uint32_t decodeColumn(int32_t x, std::vector<Vec2>& positions) const
+    {
+        const uint32_t first = cell_offsets[getCellIndex({x, 0})];
+        const uint32_t last  = cell_offsets[getCellIndex({x + 1, 0})];
+        positions.resize(last - first);
+        for (uint32_t i{first}; i < last; ++i) {
+            positions[i - first] = objects[i].getPosition();
+        }
+        return first;
+    }
+
+    void storeColumn(int32_t x, const std::vector<Vec2>& positions)
+    {
+        const uint32_t first = cell_offsets[getCellIndex({x, 0})];
+        const uint32_t last  = cell_offsets[getCellIndex({x + 1, 0})];
+        for (uint32_t i{first}; i < last; ++i) {
+            CompactObject& obj      = objects[i];
+            const Vec2     previous = obj.getPosition();
+            const Vec2     move     = positions[i - first] - previous;
+            // Contacts move the position but not the last position, the velocity follows the move
+            if (move.x != 0.0f || move.y != 0.0f) {
+                obj.setState(previous + move, obj.getVelocity() + move, step_count);
+            }
+        }
+    }
+
+    /**
+     * @brief Checks if the atoms of a cell are colliding with the atoms of its 3x3 neighborhood
+     *
+     * Neighbor cells are visited in the order of ColumnMajorLayout::getNeighbors.
+     *
+     * @param cell coordinates of the cell
+     * @param window decoded positions of the cell column and of its neighbor columns
+     * @param column_first index of the first atom of each decoded column
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TStats>
+    void processCell(IVec2 cell, ColumnWindow& window, const uint32_t* column_first, TStats& contact_stats)
+    {
+        const uint32_t cell_idx = getCellIndex(cell);
+        const uint32_t cell_end = cell_offsets[cell_idx + 1];
+        if (cell_offsets[cell_idx] == cell_end) {
+            return;
+        }
+        // Decoded atoms of the neighbor cells and their origin relative to the cell
+        Vec2*    neighbor_positions[9];
+        uint32_t neighbor_size[9];
+        Vec2     neighbor_origin[9];
+        uint32_t neighbor_count = 0;
+        const int32_t y_min = std::max(cell.y - 1, 0);
+        const int32_t y_max = std::min(cell.y + 1, grid_size.y - 1);
+        for (const int32_t dx : {0, 1, -1}) {
+            const int32_t x = cell.x + dx;
+            if (x < 0 || x >= grid_size.x) {
+                continue;
+            }
+            Vec2* const    column = window[x % 3].data();
+            const uint32_t first  = column_first[x % 3];
+            for (int32_t y{y_min}; y <= y_max; ++y) {
+                const uint32_t neighbor_idx = getCellIndex({x, y});
+                neighbor_positions[neighbor_count] = column + (cell_offsets[neighbor_idx] - first);
+                neighbor_size[neighbor_count]      = cell_offsets[neighbor_idx + 1] - cell_offsets[neighbor_idx];
+                neighbor_origin[neighbor_count]    = {to<float>(dx), to<float>(y - cell.y)};
+                ++neighbor_count;
+            }
+        }
+        Vec2* const    cell_positions = window[cell.x % 3].data() + (cell_offsets[cell_idx] - column_first[cell.x % 3]);
+        const uint32_t cell_size      = cell_end - cell_offsets[cell_idx];
+        for (uint32_t i{0}; i < cell_size; ++i) {
+            for (uint32_t n{0}; n < neighbor_count; ++n) {
+                Vec2* const positions = neighbor_positions[n];
+                for (uint32_t k{0}; k < neighbor_size[n]; ++k) {
+                    solveContact(cell_positions[i], positions[k], neighbor_origin[n], contact_stats);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Same response as UniformRadius::solveContact, on positions relative to their cell
+     *
+     * @param position_1 position of the first atom
+     * @param position_2 position of the second atom
+     * @param origin_2 origin of the second atom cell, relative to the first atom cell
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TStats>
+    static void solveContact(Vec2& position_1, Vec2& position_2, Vec2 origin_2, TStats& contact_stats)
+    {
+        using Float = typename TConfig::Float;
+        // Exact, offsets have few significant bits
+        const Vec2  position_2_local = position_2 + origin_2;
+        const Float dx    = static_cast<Float>(position_1.x) - static_cast<Float>(position_2_local.x);
+        const Float dy    = static_cast<Float>(position_1.y) - static_cast<Float>(position_2_local.y);
+        const Float dist2 = dx * dx + dy * dy;
+        contact_stats.addTested();
+        if (dist2 < Float{1} && dist2 > Float{TConfig::contact_eps}) {
+            const Float dist = std::sqrt(dist2);
+            contact_stats.addResolved(static_cast<float>(Float{1} - dist));
+            const Float delta = Float{TConfig::response_coef} * Float{0.5} * (Float{1} - dist);
+            const Vec2 col_vec{static_cast<float>(dx / dist * delta), static_cast<float>(dy / dist * delta)};
+            position_1 += col_vec;
+            position_2 -= col_vec;
+        }
+    }
+
+    void resetStatsAccumulators()
+    {
+        if (!stats_enabled) {
+            return;
+        }
+        stats_accumulators.resize(thread_pool.getBatchCount());
+        for (StatsAccumulator& accumulator : stats_accumulators) {
+            accumulator.reset();
+        }
+    }
+
+    void reduceSubStepStats(uint32_t sub_step_idx)
+    {
+        StatsAccumulator total;
+        for (const StatsAccumulator& accumulator : stats_accumulators) {
+            total.merge(accumulator);
+        }
+        SubStepStats& sub_step     = stats.sub_steps[sub_step_idx];
+        sub_step.contacts_tested   = total.contacts_tested;
+        sub_step.contacts_resolved = total.contacts_resolved;
+        sub_step.max_penetration   = total.max_penetration;
+        stats.addSubStep(sub_step);
+    }
+
+    /**
+     * @brief Compute end of frame statistics: energy, velocity and cells occupancy
+     *
+     * @param sub_dt sub step duration, used to compute velocities
+     */
+    void computeFrameStats(float sub_dt)
+    {
+        PROFILE_SCOPE("stats");
+        const uint32_t batch_count = thread_pool.getBatchCount();
+        ++stats.frame;
+        stats.objects_count = objects.size();
+        stats_energy.assign(batch_count, 0.0);
+        stats_velocity.assign(batch_count, 0.0f);
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end) {
+            double energy       = 0.0;
+            float  max_velocity = 0.0f;
+            for (uint32_t i{start}; i < end; ++i) {
+                const Vec2  v  = objects[i].getVelocity() / sub_dt;
+                const float v2 = v.x * v.x + v.y * v.y;
+                energy      += 0.5 * v2;
+                max_velocity = std::max(max_velocity, v2);
+            }
+            stats_energy[batch_idx]   = energy;
+            stats_velocity[batch_idx] = std::sqrt(max_velocity);
+        });
+        for (uint32_t i{0}; i < batch_count; ++i) {
+            stats.kinetic_energy += stats_energy[i];
+            stats.max_velocity    = std::max(stats.max_velocity, stats_velocity[i]);
+        }
+        // Cells have no capacity, crowded cells are counted in the last bucket
+        for (uint32_t c{0}; c + 1 < cell_offsets.size(); ++c) {
+            const uint32_t count = cell_offsets[c + 1] - cell_offsets[c];
+            ++stats.cell_occupancy[std::min<uint32_t>(count, CollisionCell::max_cell_idx)];
+        }
+    }
+};
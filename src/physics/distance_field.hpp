@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <SFML/Graphics/Image.hpp>
+
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Signed distance to the static obstacles, sampled on the collision grid nodes
+ *
+ * Node (x, y) is at world position (x, y), distances are negative inside obstacles.
+ * Shapes are rasterized once when added, lookups are a bilinear interpolation of 4 nodes
+ * whatever the obstacles complexity.
+ */
+struct DistanceField
+{
+    int32_t            width   = 0;
+    int32_t            height  = 0;
+    std::vector<float> distances;
+    bool               empty   = true;
+    // Incremented on each change, lets users of the field detect updates
+    uint64_t           version = 0;
+
+    DistanceField() = default;
+
+    /**
+     * @brief Construct an empty field
+     *
+     * @param size size of the world
+     */
+    explicit
+    DistanceField(IVec2 size)
+        : width(size.x + 1)
+        , height(size.y + 1)
+    {
+        clear();
+    }
+
+    /**
+     * @brief Remove all obstacles
+     *
+     */
+    void clear()
+    {
+        distances.assign(width * height, to<float>(width + height));
+        empty = true;
+        ++version;
+    }
+
+    /**
+     * @brief Add a disc
+     *
+     * @param center center of the disc
+     * @param radius radius of the disc
+     */
+    void addCircle(Vec2 center, float radius)
+    {
+        addShape([=](Vec2 p) {
+            const Vec2 v = p - center;
+            return std::sqrt(v.x * v.x + v.y * v.y) - radius;
+        });
+    }
+
+    /**
+     * @brief Add a segment with rounded ends, used for walls and funnels
+     *
+     * @param start first end of the segment
+     * @param end second end of the segment
+     * @param thickness thickness of the wall
+     */
+    void addSegment(Vec2 start, Vec2 end, float thickness)
+    {
+        const float half_thickness = 0.5f * thickness;
+        addShape([=](Vec2 p) {
+            return std::sqrt(getSegmentDistance2(p, start, end)) - half_thickness;
+        });
+    }
+
+    /**
+     * @brief Add a simple polygon, convex or not
+     *
+     * @param points vertices of the polygon, in any winding order
+     */
+    void addPolygon(const std::vector<Vec2>& points)
+    {
+        const auto count = to<uint32_t>(points.size());
+        if (count < 3) {
+            return;
+        }
+        addShape([&](Vec2 p) {
+            float min_dist2 = getSegmentDistance2(p, points[count - 1], points[0]);
+            bool  inside    = false;
+            for (uint32_t i{0}, j{count - 1}; i < count; j = i++) {
+                const Vec2 a = points[j];
+                const Vec2 b = points[i];
+                min_dist2 = std::min(min_dist2, getSegmentDistance2(p, a, b));
+                // Even-odd rule
+                if ((a.y > p.y) != (b.y > p.y) && p.x < a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y)) {
+                    inside = !inside;
+                }
+            }
+            const float dist = std::sqrt(min_dist2);
+            return inside ? -dist : dist;
+        });
+    }
+
+    /**
+     * @brief Add obstacles from a mask sampled at each node
+     *
+     * Distances are computed with an exact Euclidean distance transform and are accurate to half a cell.
+     *
+     * @param is_solid callable taking the node coordinates and returning true inside obstacles
+     */
+    template<typename TMask>
+    void addMask(TMask&& is_solid)
+    {
+        std::vector<uint8_t> solid(width * height);
+        for (int32_t x{0}; x < width; ++x) {
+            for (int32_t y{0}; y < height; ++y) {
+                solid[getIndex(x, y)] = is_solid(x, y) ? 1 : 0;
+            }
+        }
+        std::vector<float> to_solid(width * height);
+        std::vector<float> to_empty(width * height);
+        computeDistanceTransform(solid, 1, to_solid);
+        computeDistanceTransform(solid, 0, to_empty);
+        for (uint32_t i{0}; i < distances.size(); ++i) {
+            const float dist = solid[i] ? 0.5f - std::sqrt(to_empty[i]) : std::sqrt(to_solid[i]) - 0.5f;
+            distances[i] = std::min(distances[i], dist);
+        }
+        empty = false;
+        ++version;
+    }
+
+    /**
+     * @brief Add obstacles from an image stretched over the world, opaque pixels are solid
+     *
+     * @param image the image, for instance loaded from res/
+     * @param alpha_threshold minimum alpha of solid pixels
+     */
+    void addImage(const sf::Image& image, uint8_t alpha_threshold = 128)
+    {
+        const sf::Vector2u image_size = image.getSize();
+        if (!image_size.x || !image_size.y) {
+            return;
+        }
+        const float scale_x = to<float>(image_size.x) / to<float>(width);
+        const float scale_y = to<float>(image_size.y) / to<float>(height);
+        addMask([&](int32_t x, int32_t y) {
+            const auto px = std::min(to<uint32_t>(to<float>(x) * scale_x), image_size.x - 1);
+            const auto py = std::min(to<uint32_t>(to<float>(y) * scale_y), image_size.y - 1);
+            return image.getPixel(px, py).a >= alpha_threshold;
+        });
+    }
+
+    /**
+     * @brief Bilinear interpolation of the distance and of its gradient
+     *
+     * @param position world position, clamped to the field
+     * @param gradient receives the non normalized gradient, pointing away from obstacles
+     * @return the signed distance
+     */
+    float sample(Vec2 position, Vec2& gradient) const
+    {
+        const float x  = std::min(std::max(position.x, 0.0f), to<float>(width  - 2));
+        const float y  = std::min(std::max(position.y, 0.0f), to<float>(height - 2));
+        const auto  ix = to<int32_t>(x);
+        const auto  iy = to<int32_t>(y);
+        const float fx = x - to<float>(ix);
+        const float fy = y - to<float>(iy);
+        const uint32_t i = getIndex(ix, iy);
+        const float d00 = distances[i];
+        const float d01 = distances[i + 1];
+        const float d10 = distances[i + height];
+        const float d11 = distances[i + height + 1];
+        gradient.x = (d10 - d00) * (1.0f - fy) + (d11 - d01) * fy;
+        gradient.y = (d01 - d00) * (1.0f - fx) + (d11 - d10) * fx;
+        const float d0 = d00 + (d10 - d00) * fx;
+        const float d1 = d01 + (d11 - d01) * fx;
+        return d0 + (d1 - d0) * fy;
+    }
+
+    /**
+     * @brief Push an atom out of the obstacles
+     *
+     * @param position position of the atom center
+     * @param radius radius of the atom
+     */
+    void solveCollision(Vec2& position, float radius) const
+    {
+        Vec2 gradient;
+        const float dist = sample(position, gradient);
+        if (dist < radius) {
+            const float length2 = gradient.x * gradient.x + gradient.y * gradient.y;
+            if (length2 > 0.0f) {
+                position += gradient * ((radius - dist) / std::sqrt(length2));
+            }
+        }
+    }
+
+    /**
+     * @brief Index of a node, nodes are stored in column major order like the collision grid
+     */
+    [[nodiscard]]
+    uint32_t getIndex(int32_t x, int32_t y) const
+    {
+        return x * height + y;
+    }
+
+private:
+    template<typename TShape>
+    void addShape(TShape&& shape)
+    {
+        for (int32_t x{0}; x < width; ++x) {
+            for (int32_t y{0}; y < height; ++y) {
+                float& dist = distances[getIndex(x, y)];
+                dist = std::min(dist, shape(Vec2{to<float>(x), to<float>(y)}));
+            }
+        }
+        empty = false;
+        ++version;
+    }
+
+    static float getSegmentDistance2(Vec2 p, Vec2 a, Vec2 b)
+    {
+        const Vec2  ab      = b - a;
+        const Vec2  ap      = p - a;
+        const float length2 = ab.x * ab.x + ab.y * ab.y;
+        const float t       = length2 > 0.0f ? std::min(std::max((ap.x * ab.x + ap.y * ab.y) / length2, 0.0f), 1.0f) : 0.0f;
+        const Vec2  v       = ap - ab * t;
+        return v.x * v.x + v.y * v.y;
+    }
+
+    /**
+     * @brief Squared distance from each node to the closest node with a given mask value
+     *
+     * Separable exact transform (Felzenszwalb and Huttenlocher), columns then rows.
+     */
+    void computeDistanceTransform(const std::vector<uint8_t>& mask, uint8_t target, std::vector<float>& result) const
+    {
+        const float far = to<float>(width * width + height * height);
+        for (uint32_t i{0}; i < mask.size(); ++i) {
+            result[i] = mask[i] == target ? 0.0f : far;
+        }
+        const int32_t max_size = std::max(width, height);
+        std::vector<float>   f(max_size);
+        std::vector<float>   d(max_size);
+        std::vector<int32_t> v(max_size);
+        std::vector<float>   z(max_size + 1);
+        for (int32_t x{0}; x < width; ++x) {
+            for (int32_t y{0}; y < height; ++y) {
+                f[y] = result[getIndex(x, y)];
+            }
+            transform1D(f, height, d, v, z);
+            for (int32_t y{0}; y < height; ++y) {
+                result[getIndex(x, y)] = d[y];
+            }
+        }
+        for (int32_t y{0}; y < height; ++y) {
+            for (int32_t x{0}; x < width; ++x) {
+                f[x] = result[getIndex(x, y)];
+            }
+            transform1D(f, width, d, v, z);
+            for (int32_t x{0}; x < width; ++x) {
+                result[getIndex(x, y)] = d[x];
+            }
+        }
+    }
+
+    static void transform1D(const std::vector<float>& f, int32_t n, std::vector<float>& d, std::vector<int32_t>& v, std::vector<float>& z)
+    {
+        constexpr float inf = 1e20f;
+        int32_t k = 0;
+        v[0] = 0;
+        z[0] = -inf;
+        z[1] =  inf;
+        for (int32_t q{1}; q < n; ++q) {
+            float s = ((f[q] + to<float>(q * q)) - (f[v[k]] + to<float>(v[k] * v[k]))) / to<float>(2 * q - 2 * v[k]);
+            while (s <= z[k]) {
+                --k;
+                s = ((f[q] + to<float>(q * q)) - (f[v[k]] + to<float>(v[k] * v[k]))) / to<float>(2 * q - 2 * v[k]);
+            }
+            ++k;
+            v[k]     = q;
+            z[k]     = s;
+            z[k + 1] = inf;
+        }
+        k = 0;
+        for (int32_t q{0}; q < n; ++q) {
+            while (z[k + 1] < to<float>(q)) {
+                ++k;
+            }
+            const float dq = to<float>(q - v[k]);
+            d[q] = dq * dq + f[v[k]];
+        }
+    }
+};
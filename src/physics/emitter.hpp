@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Emitter shapes used to spawn objects in bulk
+ *
+ * Each shape computes the position of its k-th object in closed form,
+ * allowing objects to be initialized in parallel.
+ */
+namespace emitter
+{
+
+/**
+ * @brief Objects aligned on a segment
+ *
+ */
+struct Line
+{
+    Vec2     start;
+    Vec2     step;
+    uint32_t count;
+
+    /**
+     * @brief Construct a new Line emitter
+     *
+     * @param start_ position of the first object
+     * @param step_ offset between two consecutive objects
+     * @param count_ number of objects
+     */
+    Line(Vec2 start_, Vec2 step_, uint32_t count_)
+        : start{start_}
+        , step{step_}
+        , count{count_}
+    {}
+
+    [[nodiscard]]
+    uint32_t getCount() const
+    {
+        return count;
+    }
+
+    [[nodiscard]]
+    Vec2 getPosition(uint32_t k) const
+    {
+        return start + step * to<float>(k);
+    }
+};
+
+/**
+ * @brief Objects filling a disc, distributed along a Vogel spiral
+ *
+ */
+struct Disc
+{
+    constexpr static float golden_angle = 2.39996323f;
+
+    Vec2     center;
+    float    radius;
+    uint32_t count;
+
+    /**
+     * @brief Construct a new Disc emitter
+     *
+     * @param center_ center of the disc
+     * @param radius_ radius of the disc
+     * @param spacing average distance between two objects
+     */
+    Disc(Vec2 center_, float radius_, float spacing)
+        : center{center_}
+        , radius{radius_}
+        , count{to<uint32_t>(3.141592653f * radius_ * radius_ / (spacing * spacing))}
+    {}
+
+    [[nodiscard]]
+    uint32_t getCount() const
+    {
+        return count;
+    }
+
+    [[nodiscard]]
+    Vec2 getPosition(uint32_t k) const
+    {
+        const float r     = radius * std::sqrt((to<float>(k) + 0.5f) / to<float>(count));
+        const float angle = to<float>(k) * golden_angle;
+        return center + Vec2{r * std::cos(angle), r * std::sin(angle)};
+    }
+};
+
+/**
+ * @brief Objects filling a rectangle on a regular lattice
+ *
+ */
+struct Rectangle
+{
+    Vec2     position;
+    float    spacing;
+    uint32_t columns;
+    uint32_t rows;
+
+    /**
+     * @brief Construct a new Rectangle emitter
+     *
+     * @param position_ top left corner of the rectangle
+     * @param size size of the rectangle
+     * @param spacing_ distance between two objects
+     */
+    Rectangle(Vec2 position_, Vec2 size, float spacing_)
+        : position{position_}
+        , spacing{spacing_}
+        , columns{to<uint32_t>(size.x / spacing_) + 1}
+        , rows{to<uint32_t>(size.y / spacing_) + 1}
+    {}
+
+    [[nodiscard]]
+    uint32_t getCount() const
+    {
+        return columns * rows;
+    }
+
+    [[nodiscard]]
+    Vec2 getPosition(uint32_t k) const
+    {
+        return position + Vec2{to<float>(k / rows), to<float>(k % rows)} * spacing;
+    }
+};
+
+}
@@ -0,0 +1,565 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "collision_grid.hpp"
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Parameters of the position based fluid mode
+ *
+ * Neighbors are searched in the collision grid cells overlapping the kernel support, since cells
+ * hold at most 3 atoms the rest spacing should stay close to the cell size.
+ * Changing them requires a call to Fluid::initialize.
+ */
+struct FluidSettings
+{
+    float    kernel_radius = 2.0f;
+    // Particles spacing at rest, defines the rest density
+    float    rest_spacing  = 1.0f;
+    uint32_t iterations    = 1;
+    // Constraint force mixing, softens the density constraint
+    float    relaxation    = 0.5f;
+    // XSPH viscosity coefficient
+    float    viscosity     = 0.05f;
+    // Artificial pressure, prevents particles clustering
+    float    tensile_coef  = 0.05f;
+    float    tensile_dist  = 0.2f;
+};
+
+/**
+ * @brief A radial kernel sampled on the squared distance, lookups need neither sqrt nor pow
+ */
+struct KernelTable
+{
+    static constexpr uint32_t size = 256;
+
+    std::array<float, size + 2> values = {};
+    float                       scale  = 0.0f;
+
+    /**
+     * @brief Sample a kernel
+     *
+     * @param radius kernel support radius, the kernel is 0 beyond it
+     * @param kernel callable taking the distance
+     */
+    template<typename TKernel>
+    void build(float radius, TKernel&& kernel)
+    {
+        const float radius2 = radius * radius;
+        scale = to<float>(size) / radius2;
+        for (uint32_t i{0}; i <= size; ++i) {
+            values[i] = kernel(std::sqrt(to<float>(i) / scale));
+        }
+        values[size]     = 0.0f;
+        values[size + 1] = 0.0f;
+    }
+
+    /**
+     * @brief Position of a squared distance in tables of the same support
+     */
+    struct Sample
+    {
+        uint32_t index;
+        float    fraction;
+    };
+
+    [[nodiscard]]
+    Sample locate(float dist2) const
+    {
+        // The last two samples are 0, distances beyond the support read them
+        const float t = std::min(dist2 * scale, to<float>(size));
+        const auto  i = to<uint32_t>(t);
+        return {i, t - to<float>(i)};
+    }
+
+    /**
+     * @brief Linearly interpolated kernel value, branch free
+     *
+     * @param sample position returned by locate, on this table or one of the same support
+     */
+    [[nodiscard]]
+    float get(Sample sample) const
+    {
+        const float v = values[sample.index];
+        return v + (values[sample.index + 1] - v) * sample.fraction;
+    }
+
+    /**
+     * @brief Linearly interpolated kernel value, branch free
+     *
+     * @param dist2 squared distance
+     */
+    [[nodiscard]]
+    float get(float dist2) const
+    {
+        return get(locate(dist2));
+    }
+};
+
+/**
+ * @brief Position based fluids (density constraint, artificial pressure and XSPH viscosity)
+ *
+ * Atoms of the collision grid are copied in cells order, column by column, so the atoms of a
+ * column of cells are contiguous. Each pair of atoms closer than the kernel radius is gathered
+ * once per sub step, from the atom with the lowest rank, and all passes iterate these pairs.
+ * Kernel terms are evaluated once per pair and iteration by computeLambda.
+ * Passes write both atoms of their pairs, up to cells_reach columns after their slice, so slices
+ * span at least that many columns and even and odd slices are processed in turn.
+ * Work data is kept in structure of arrays indexed by rank, atoms have a unit mass.
+ */
+struct Fluid
+{
+    /**
+     * @brief Pairs of the atoms of a range of columns, pair k links rank first_atom + i to
+     * neighbors[k] with offsets[i] <= k < offsets[i + 1], neighbors have a higher rank
+     */
+    /**
+     * @brief Terms of the density constraint of an atom, kept together since pairs add them to both atoms
+     */
+    struct DensitySums
+    {
+        float density;
+        float grad_x;
+        float grad_y;
+        float grad_norm2;
+    };
+
+    struct Slice
+    {
+        uint32_t              first_atom = 0;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> neighbors;
+        // Atom position minus neighbor position, at the positions of the current iteration
+        std::vector<float>    relative_x;
+        std::vector<float>    relative_y;
+        // Density kernel, set by computeLambda
+        std::vector<float>    weight;
+        // Gradient kernel divided by the distance, set by computeLambda
+        std::vector<float>    gradient;
+    };
+
+    FluidSettings settings;
+    KernelTable   density_kernel;
+    // Derivative of the gradient kernel divided by the distance, multiply by the offset to get the gradient
+    KernelTable   gradient_kernel;
+    std::vector<Slice> slices;
+    float         rest_density     = 1.0f;
+    float         inv_rest_density = 1.0f;
+    // Inverse of the density kernel at the artificial pressure reference distance
+    float         tensile_scale    = 0.0f;
+    // Number of cells around an atom cell covering the kernel support
+    int32_t       cells_reach      = 1;
+    bool          initialized      = false;
+
+    // Size of the collision grid the atoms were loaded from
+    int32_t               width  = 0;
+    int32_t               height = 0;
+    // Rank of the first atom of each column and of each cell (x, y) at x * height + y, plus the atoms count
+    std::vector<uint32_t> column_start;
+    std::vector<uint32_t> cell_start;
+    // Atom id of each rank
+    std::vector<uint32_t> atoms;
+
+    std::vector<float> position_x;
+    std::vector<float> position_y;
+    std::vector<float> last_position_x;
+    std::vector<float> last_position_y;
+    std::vector<float> lambda;
+    std::vector<float> delta_x;
+    std::vector<float> delta_y;
+    // Sums of the density constraint terms of each rank, reset once lambda is computed
+    std::vector<DensitySums> sums;
+
+    /**
+     * @brief Build the kernel tables and the rest density from the settings
+     *
+     */
+    void initialize()
+    {
+        constexpr float pi = 3.14159265f;
+        const float h  = settings.kernel_radius;
+        const float h2 = h * h;
+        // 2D poly6 and spiky kernels
+        const float poly6_coef = 4.0f / (pi * std::pow(h, 8.0f));
+        const float spiky_coef = -30.0f / (pi * std::pow(h, 5.0f));
+        density_kernel.build(h, [=](float r) {
+            const float d = h2 - r * r;
+            return poly6_coef * d * d * d;
+        });
+        gradient_kernel.build(h, [=](float r) {
+            const float d = h - r;
+            return spiky_coef * d * d / std::max(r, 0.01f * h);
+        });
+        tensile_scale = 1.0f / density_kernel.get(settings.tensile_dist * settings.tensile_dist * h2);
+        // Rest density of a square lattice
+        const float spacing = settings.rest_spacing;
+        const auto  reach   = to<int32_t>(h / spacing);
+        rest_density = 0.0f;
+        for (int32_t x{-reach}; x <= reach; ++x) {
+            for (int32_t y{-reach}; y <= reach; ++y) {
+                rest_density += density_kernel.get(to<float>(x * x + y * y) * spacing * spacing);
+            }
+        }
+        inv_rest_density = 1.0f / rest_density;
+        cells_reach      = to<int32_t>(std::ceil(h));
+        initialized      = true;
+    }
+
+    /**
+     * @brief Size the work arrays
+     *
+     * @param objects_count upper bound of the number of atoms in the grid
+     * @param grid_width width of the collision grid
+     * @param grid_height height of the collision grid
+     */
+    void resize(uint32_t objects_count, int32_t grid_width, int32_t grid_height)
+    {
+        width  = grid_width;
+        height = grid_height;
+        column_start.resize(to<uint32_t>(width) + 1);
+        cell_start.resize(to<uint32_t>(width * height) + 1);
+        atoms.resize(objects_count);
+        position_x.resize(objects_count);
+        position_y.resize(objects_count);
+        last_position_x.resize(objects_count);
+        last_position_y.resize(objects_count);
+        lambda.resize(objects_count);
+        delta_x.resize(objects_count);
+        delta_y.resize(objects_count);
+        sums.resize(objects_count);
+    }
+
+    /**
+     * @brief First step of the load, count the atoms of a range of columns
+     *
+     */
+    template<typename TGrid>
+    void countAtoms(const TGrid& grid, uint32_t first_column, uint32_t last_column)
+    {
+        for (uint32_t x{first_column}; x < last_column; ++x) {
+            uint32_t count = 0;
+            for (int32_t y{0}; y < height; ++y) {
+                count += grid.get(x, y).objects_count;
+            }
+            column_start[x + 1] = count;
+        }
+    }
+
+    /**
+     * @brief Second step of the load, turn the columns counts into ranks
+     *
+     * @return the number of atoms
+     */
+    uint32_t computeColumnStarts()
+    {
+        column_start[0] = 0;
+        for (int32_t x{0}; x < width; ++x) {
+            column_start[x + 1] += column_start[x];
+        }
+        const uint32_t atoms_count = column_start[width];
+        cell_start[width * height] = atoms_count;
+        return atoms_count;
+    }
+
+    /**
+     * @brief Last step of the load, copy the atoms of a range of columns into the work arrays
+     *
+     * @param grid collision grid, up to date
+     * @param objects objects container indexable by atom id
+     * @param first_column first column
+     * @param last_column last column (excluded)
+     */
+    template<typename TGrid, typename TObjects>
+    void load(const TGrid& grid, const TObjects& objects, uint32_t first_column, uint32_t last_column)
+    {
+        const float self_density = density_kernel.get(0.0f);
+        for (uint32_t x{first_column}; x < last_column; ++x) {
+            uint32_t rank = column_start[x];
+            for (int32_t y{0}; y < height; ++y) {
+                cell_start[x * height + y] = rank;
+                const CollisionCell& c = grid.get(x, y);
+                for (uint32_t i{0}; i < c.objects_count; ++i) {
+                    const uint32_t atom_idx = c.objects[i];
+                    atoms[rank]           = atom_idx;
+                    position_x[rank]      = objects[atom_idx].position.x;
+                    position_y[rank]      = objects[atom_idx].position.y;
+                    last_position_x[rank] = objects[atom_idx].last_position.x;
+                    last_position_y[rank] = objects[atom_idx].last_position.y;
+                    delta_x[rank]         = 0.0f;
+                    delta_y[rank]         = 0.0f;
+                    sums[rank]            = {self_density, 0.0f, 0.0f, 0.0f};
+                    ++rank;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Number of slices of a grid, slices span at least cells_reach columns
+     *
+     * @param max_count maximum number of slices
+     */
+    [[nodiscard]]
+    uint32_t getSliceCount(uint32_t max_count) const
+    {
+        return std::max(std::min(max_count, to<uint32_t>(width / cells_reach)), 1u);
+    }
+
+    /**
+     * @brief Gather the pairs of atoms closer than the kernel radius of the atoms of a range of columns,
+     * with their relative positions
+     *
+     * The candidates of an atom are the atoms after it in the rows of its column covering the kernel support,
+     * then the ones of the same rows in the next columns, each a contiguous range of ranks.
+     *
+     * @param slice slice to build
+     * @param first_column first column
+     * @param last_column last column (excluded)
+     */
+    void buildSlice(Slice& slice, int32_t first_column, int32_t last_column) const
+    {
+        const float   max_dist2 = settings.kernel_radius * settings.kernel_radius;
+        const int32_t reach     = cells_reach;
+        slice.first_atom = column_start[first_column];
+        slice.offsets.clear();
+        slice.offsets.push_back(0);
+        uint32_t slice_count = 0;
+        for (int32_t x{first_column}; x < last_column; ++x) {
+            const int32_t x_max = std::min(x + reach, width - 1);
+            for (int32_t y{0}; y < height; ++y) {
+                const uint32_t first = cell_start[x * height + y];
+                const uint32_t last  = cell_start[x * height + y + 1];
+                if (first == last) {
+                    continue;
+                }
+                const int32_t y_min = std::max(y - reach, 0);
+                // Start of the row after the support, it is the start of the next column for the last row
+                const int32_t y_end = std::min(y + reach, height - 1) + 1;
+                uint32_t candidates_count = cell_start[x * height + y_end] - first;
+                for (int32_t nx{x + 1}; nx <= x_max; ++nx) {
+                    candidates_count += cell_start[nx * height + y_end] - cell_start[nx * height + y_min];
+                }
+                // Grown geometrically and trimmed once at the end, resizing per atom zero filled the candidates each time
+                if (slice.neighbors.size() < slice_count + (last - first) * candidates_count) {
+                    const uint32_t size = 2 * (slice_count + (last - first) * candidates_count);
+                    slice.neighbors.resize(size);
+                    slice.relative_x.resize(size);
+                    slice.relative_y.resize(size);
+                }
+                uint32_t* const out   = slice.neighbors.data();
+                float*    const out_x = slice.relative_x.data();
+                float*    const out_y = slice.relative_y.data();
+                for (uint32_t rank{first}; rank < last; ++rank) {
+                    const float px = position_x[rank];
+                    const float py = position_y[rank];
+                    // Candidates are written unconditionally and kept or overwritten, most of them are rejected.
+                    // The count is kept local, the output could alias it otherwise
+                    uint32_t count = slice_count;
+                    const auto test_range = [&](uint32_t begin, uint32_t end) {
+                        for (uint32_t k{begin}; k < end; ++k) {
+                            const float dx = px - position_x[k];
+                            const float dy = py - position_y[k];
+                            out[count]   = k;
+                            out_x[count] = dx;
+                            out_y[count] = dy;
+                            count += dx * dx + dy * dy < max_dist2;
+                        }
+                    };
+                    test_range(rank + 1, cell_start[x * height + y_end]);
+                    for (int32_t nx{x + 1}; nx <= x_max; ++nx) {
+                        test_range(cell_start[nx * height + y_min], cell_start[nx * height + y_end]);
+                    }
+                    slice_count = count;
+                    slice.offsets.push_back(count);
+                }
+            }
+        }
+        slice.neighbors.resize(slice_count);
+        slice.relative_x.resize(slice_count);
+        slice.relative_y.resize(slice_count);
+        slice.weight.resize(slice_count);
+        slice.gradient.resize(slice_count);
+    }
+
+    /**
+     * @brief Update the relative positions of the pairs of a slice after the positions changed
+     *
+     */
+    void updatePairs(Slice& slice) const
+    {
+        const auto atoms_count = to<uint32_t>(slice.offsets.size() - 1);
+        for (uint32_t i{0}; i < atoms_count; ++i) {
+            const uint32_t rank = slice.first_atom + i;
+            const float px = position_x[rank];
+            const float py = position_y[rank];
+            for (uint32_t k{slice.offsets[i]}; k < slice.offsets[i + 1]; ++k) {
+                const uint32_t other = slice.neighbors[k];
+                slice.relative_x[k] = px - position_x[other];
+                slice.relative_y[k] = py - position_y[other];
+            }
+        }
+    }
+
+    /**
+     * @brief Compute the kernel terms of the pairs of a slice and add them to the density constraint sums
+     *
+     */
+    void accumulateDensity(Slice& slice)
+    {
+        const auto  atoms_count = to<uint32_t>(slice.offsets.size() - 1);
+        const float* const rel_x    = slice.relative_x.data();
+        const float* const rel_y    = slice.relative_y.data();
+        float*       const weight   = slice.weight.data();
+        float*       const gradient = slice.gradient.data();
+        for (uint32_t i{0}; i < atoms_count; ++i) {
+            float density_i    = 0.0f;
+            float grad_x_i     = 0.0f;
+            float grad_y_i     = 0.0f;
+            float grad_norm2_i = 0.0f;
+            for (uint32_t k{slice.offsets[i]}; k < slice.offsets[i + 1]; ++k) {
+                const float dx    = rel_x[k];
+                const float dy    = rel_y[k];
+                const float dist2 = dx * dx + dy * dy;
+                // Both tables share the support, the sample position is computed once
+                const KernelTable::Sample sample = density_kernel.locate(dist2);
+                const float w  = density_kernel.get(sample);
+                const float g  = gradient_kernel.get(sample);
+                const float gx = g * dx;
+                const float gy = g * dy;
+                const float n2 = g * g * dist2;
+                weight[k]   = w;
+                gradient[k] = g;
+                density_i    += w;
+                grad_x_i     += gx;
+                grad_y_i     += gy;
+                grad_norm2_i += n2;
+                // The neighbor sees the opposite offset
+                DensitySums& other = sums[slice.neighbors[k]];
+                other.density    += w;
+                other.grad_x     -= gx;
+                other.grad_y     -= gy;
+                other.grad_norm2 += n2;
+            }
+            DensitySums& atom = sums[slice.first_atom + i];
+            atom.density    += density_i;
+            atom.grad_x     += grad_x_i;
+            atom.grad_y     += grad_y_i;
+            atom.grad_norm2 += grad_norm2_i;
+        }
+    }
+
+    /**
+     * @brief Compute the density constraint multiplier of a range of atoms and reset their sums
+     *
+     */
+    void computeLambda(uint32_t start, uint32_t end)
+    {
+        const float relaxation   = settings.relaxation;
+        const float self_density = density_kernel.get(0.0f);
+        for (uint32_t i{start}; i < end; ++i) {
+            const DensitySums& atom = sums[i];
+            // Only push atoms apart, free surfaces don't attract
+            const float constraint  = std::max(atom.density * inv_rest_density - 1.0f, 0.0f);
+            const float denominator = (atom.grad_norm2 + atom.grad_x * atom.grad_x + atom.grad_y * atom.grad_y) * inv_rest_density * inv_rest_density;
+            lambda[i] = -constraint / (denominator + relaxation);
+            sums[i]   = {self_density, 0.0f, 0.0f, 0.0f};
+        }
+    }
+
+    /**
+     * @brief Add the position corrections of the pairs of a slice to both atoms
+     *
+     */
+    void computeDelta(const Slice& slice)
+    {
+        const float tensile_coef = settings.tensile_coef;
+        const auto  atoms_count  = to<uint32_t>(slice.offsets.size() - 1);
+        for (uint32_t i{0}; i < atoms_count; ++i) {
+            const uint32_t rank     = slice.first_atom + i;
+            const float    lambda_i = lambda[rank];
+            float delta_x_i = 0.0f;
+            float delta_y_i = 0.0f;
+            for (uint32_t k{slice.offsets[i]}; k < slice.offsets[i + 1]; ++k) {
+                const uint32_t other = slice.neighbors[k];
+                // Artificial pressure, the density kernel relative to its reference value to the fourth
+                const float s       = slice.weight[k] * tensile_scale;
+                const float tensile = -tensile_coef * (s * s) * (s * s);
+                const float coef    = (lambda_i + lambda[other] + tensile) * slice.gradient[k] * inv_rest_density;
+                const float cx      = coef * slice.relative_x[k];
+                const float cy      = coef * slice.relative_y[k];
+                delta_x_i += cx;
+                delta_y_i += cy;
+                delta_x[other] -= cx;
+                delta_y[other] -= cy;
+            }
+            delta_x[rank] += delta_x_i;
+            delta_y[rank] += delta_y_i;
+        }
+    }
+
+    /**
+     * @brief Add the XSPH velocity corrections of the pairs of a slice to both atoms, stored in delta
+     *
+     * Weights are the ones of the last iteration, before its position correction.
+     */
+    void computeViscosity(const Slice& slice)
+    {
+        const float viscosity   = settings.viscosity * inv_rest_density;
+        const auto  atoms_count = to<uint32_t>(slice.offsets.size() - 1);
+        for (uint32_t i{0}; i < atoms_count; ++i) {
+            const uint32_t rank = slice.first_atom + i;
+            const float vx = position_x[rank] - last_position_x[rank];
+            const float vy = position_y[rank] - last_position_y[rank];
+            float dv_x = 0.0f;
+            float dv_y = 0.0f;
+            for (uint32_t k{slice.offsets[i]}; k < slice.offsets[i + 1]; ++k) {
+                const uint32_t other = slice.neighbors[k];
+                const float    w     = slice.weight[k] * viscosity;
+                const float    ux    = (position_x[other] - last_position_x[other] - vx) * w;
+                const float    uy    = (position_y[other] - last_position_y[other] - vy) * w;
+                dv_x += ux;
+                dv_y += uy;
+                delta_x[other] -= ux;
+                delta_y[other] -= uy;
+            }
+            delta_x[rank] += dv_x;
+            delta_y[rank] += dv_y;
+        }
+    }
+
+    /**
+     * @brief Apply and reset the position corrections of a range of atoms
+     *
+     */
+    void applyDelta(uint32_t start, uint32_t end)
+    {
+        for (uint32_t i{start}; i < end; ++i) {
+            position_x[i] += delta_x[i];
+            position_y[i] += delta_y[i];
+            delta_x[i] = 0.0f;
+            delta_y[i] = 0.0f;
+        }
+    }
+
+    /**
+     * @brief Write back a range of atoms, the velocity correction left in delta is applied
+     *
+     * @param objects objects container indexable by atom id
+     * @param start first rank
+     * @param end last rank (excluded)
+     */
+    template<typename TObjects>
+    void store(TObjects& objects, uint32_t start, uint32_t end) const
+    {
+        for (uint32_t i{start}; i < end; ++i) {
+            objects[atoms[i]].position      = {position_x[i], position_y[i]};
+            objects[atoms[i]].last_position = {last_position_x[i] - delta_x[i], last_position_y[i] - delta_y[i]};
+        }
+    }
+};
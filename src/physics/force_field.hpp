@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Localized acceleration applied to the atoms during integration, like gravity
+ *
+ * The intensity decreases linearly from the center to the radius.
+ */
+struct ForceField
+{
+    enum class Type : uint8_t
+    {
+        // Toward the center, away from it with a negative strength
+        Radial,
+        // Around the center, clockwise on screen with a positive strength
+        Vortex
+    };
+
+    Type  type     = Type::Radial;
+    Vec2  center   = {};
+    float radius   = 0.0f;
+    float strength = 0.0f;
+    // Remaining time in seconds, negative for a permanent field
+    float duration = -1.0f;
+
+    static ForceField makeAttractor(Vec2 center_, float radius_, float strength_, float duration_ = -1.0f)
+    {
+        return {Type::Radial, center_, radius_, strength_, duration_};
+    }
+
+    static ForceField makeVortex(Vec2 center_, float radius_, float strength_, float duration_ = -1.0f)
+    {
+        return {Type::Vortex, center_, radius_, strength_, duration_};
+    }
+
+    /**
+     * @brief Short lived repulsion, the atoms velocity changes by about strength * duration / 2
+     */
+    static ForceField makeExplosion(Vec2 center_, float radius_, float strength_, float duration_ = 0.05f)
+    {
+        return {Type::Radial, center_, radius_, -strength_, duration_};
+    }
+
+    [[nodiscard]]
+    Vec2 getAcceleration(Vec2 position) const
+    {
+        const Vec2  v     = center - position;
+        const float dist2 = v.x * v.x + v.y * v.y;
+        if (dist2 >= radius * radius || dist2 == 0.0f) {
+            return {};
+        }
+        const float dist = std::sqrt(dist2);
+        // Normalization and linear falloff
+        const float coef = strength * (1.0f - dist / radius) / dist;
+        if (type == Type::Radial) {
+            return v * coef;
+        }
+        return Vec2{-v.y, v.x} * coef;
+    }
+};
+
+/**
+ * @brief Active force fields and the world tiles they reach
+ *
+ * Each tile stores a mask of the fields overlapping it, atoms only evaluate the fields
+ * of their own tile so a localized field costs nothing to atoms outside of it.
+ */
+struct ForceFieldSet
+{
+    static constexpr uint32_t max_fields = 64;
+    static constexpr int32_t  tile_size  = 8;
+
+    std::vector<ForceField> fields;
+    int32_t                 tiles_x = 0;
+    int32_t                 tiles_y = 0;
+    std::vector<uint64_t>   tile_masks;
+
+    /**
+     * @brief Add a field
+     *
+     * @return false if the set is full and the field dropped
+     */
+    bool add(const ForceField& field)
+    {
+        if (fields.size() >= max_fields) {
+            return false;
+        }
+        fields.push_back(field);
+        return true;
+    }
+
+    [[nodiscard]]
+    bool empty() const
+    {
+        return fields.empty();
+    }
+
+    void clear()
+    {
+        fields.clear();
+    }
+
+    /**
+     * @brief Rasterize the fields bounding boxes into the tiles, to call before integration
+     *
+     * @param world_size size of the world
+     */
+    void update(Vec2 world_size)
+    {
+        tiles_x = to<int32_t>(world_size.x) / tile_size + 1;
+        tiles_y = to<int32_t>(world_size.y) / tile_size + 1;
+        tile_masks.assign(tiles_x * tiles_y, 0);
+        const auto count = to<uint32_t>(fields.size());
+        for (uint32_t i{0}; i < count; ++i) {
+            const ForceField& field = fields[i];
+            const int32_t x_min = std::max(to<int32_t>(std::floor((field.center.x - field.radius) / tile_size)), 0);
+            const int32_t x_max = std::min(to<int32_t>(std::floor((field.center.x + field.radius) / tile_size)), tiles_x - 1);
+            const int32_t y_min = std::max(to<int32_t>(std::floor((field.center.y - field.radius) / tile_size)), 0);
+            const int32_t y_max = std::min(to<int32_t>(std::floor((field.center.y + field.radius) / tile_size)), tiles_y - 1);
+            for (int32_t x{x_min}; x <= x_max; ++x) {
+                for (int32_t y{y_min}; y <= y_max; ++y) {
+                    tile_masks[x * tiles_y + y] |= uint64_t{1} << i;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Sum of the fields reaching a position, atoms are always inside the world
+     */
+    [[nodiscard]]
+    Vec2 getAcceleration(Vec2 position) const
+    {
+        const int32_t x = to<int32_t>(position.x) / tile_size;
+        const int32_t y = to<int32_t>(position.y) / tile_size;
+        uint64_t mask = tile_masks[x * tiles_y + y];
+        Vec2 acceleration = {};
+        while (mask) {
+            const uint32_t i = countTrailingZeros(mask);
+            acceleration += fields[i].getAcceleration(position);
+            mask &= mask - 1;
+        }
+        return acceleration;
+    }
+
+    /**
+     * @brief Consume the fields duration and remove the expired ones
+     *
+     * @param dt elapsed time
+     */
+    void advance(float dt)
+    {
+        // Fields with less than half a step left are removed, durations are not exact multiples of the step
+        uint32_t kept = 0;
+        for (ForceField field : fields) {
+            const bool permanent = field.duration < 0.0f;
+            if (!permanent) {
+                field.duration -= dt;
+            }
+            if (permanent || field.duration >= 0.5f * dt) {
+                fields[kept++] = field;
+            }
+        }
+        fields.resize(kept);
+    }
+
+private:
+    static uint32_t countTrailingZeros(uint64_t mask)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return to<uint32_t>(__builtin_ctzll(mask));
+#else
+        uint32_t count = 0;
+        while (!(mask & 1)) {
+            mask >>= 1;
+            ++count;
+        }
+        return count;
+#endif
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "collision_grid.hpp"
+#include "solver_config.hpp"
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Atoms sorted by destination cell, used to build the collision grid in parallel
+ *
+ * Each batch of atoms (filled by one thread) has one bucket per grid stripe (a range of columns).
+ * Stripes are then filled concurrently, each one reading its buckets in batch order
+ * so the resulting cells content is the same as with a sequential insertion.
+ *
+ * @tparam TGrid collision grid type
+ */
+template<typename TGrid>
+struct GridBins
+{
+    struct Entry
+    {
+        uint32_t cell_idx;
+        uint32_t atom_idx;
+    };
+
+    std::vector<std::vector<Entry>> buckets;
+    uint32_t                        batch_count  = 0;
+    uint32_t                        stripe_count = 0;
+    int32_t                         grid_width   = 0;
+    int32_t                         grid_height  = 0;
+    // Atoms are added if strictly inside these bounds
+    Vec2                            bounds_min;
+    Vec2                            bounds_max;
+    typename TGrid::Layout          layout;
+
+    /**
+     * @brief Set the buckets layout, previous content is discarded
+     *
+     * @param batch_count_ number of filling batches
+     * @param stripe_count_ number of grid stripes
+     * @param grid grid to build
+     * @param boundaries boundary modes of the world, walled axes keep a one cell safety border
+     */
+    void resize(uint32_t batch_count_, uint32_t stripe_count_, const TGrid& grid, const BoundaryConditions& boundaries)
+    {
+        batch_count  = batch_count_;
+        stripe_count = stripe_count_;
+        grid_width   = grid.width;
+        grid_height  = grid.height;
+        layout       = grid.layout;
+        // Other modes use the edge cells, atoms outside the world are not added
+        const bool wall_x = boundaries.x == BoundaryMode::Wall;
+        const bool wall_y = boundaries.y == BoundaryMode::Wall;
+        bounds_min = {wall_x ? 1.0f : -1.0f, wall_y ? 1.0f : -1.0f};
+        bounds_max = {to<float>(grid_width) - (wall_x ? 1.0f : 0.0f), to<float>(grid_height) - (wall_y ? 1.0f : 0.0f)};
+        buckets.resize(batch_count * stripe_count);
+        for (std::vector<Entry>& bucket : buckets) {
+            bucket.clear();
+        }
+    }
+
+    /**
+     * @brief Add an atom if it is inside the grid bounds
+     *
+     * @param batch_idx index of the batch filled by the calling thread
+     * @param atom_idx index of the atom
+     * @param position position of the atom
+     */
+    void add(uint32_t batch_idx, uint32_t atom_idx, Vec2 position)
+    {
+        if (position.x > bounds_min.x && position.x < bounds_max.x &&
+            position.y > bounds_min.y && position.y < bounds_max.y) {
+            const auto x = to<uint32_t>(position.x);
+            const auto y = to<uint32_t>(position.y);
+            const uint32_t stripe = layout.getColumnGroup(x) * stripe_count / layout.getColumnGroupCount();
+            buckets[batch_idx * stripe_count + stripe].push_back({layout.getIndex(x, y), atom_idx});
+        }
+    }
+
+    /**
+     * @brief First column group of a stripe
+     *
+     * @param stripe_idx index of the stripe
+     */
+    [[nodiscard]]
+    uint32_t getStripeStart(uint32_t stripe_idx) const
+    {
+        // Smallest group such that group * stripe_count / group_count == stripe_idx
+        return (stripe_idx * layout.getColumnGroupCount() + stripe_count - 1) / stripe_count;
+    }
+
+    /**
+     * @brief Clear and fill the cells of a stripe
+     *
+     * @param grid grid to build
+     * @param stripe_idx index of the stripe
+     * @return the number of atoms dropped because their cell was full
+     */
+    uint64_t buildStripe(TGrid& grid, uint32_t stripe_idx) const
+    {
+        const uint32_t first_cell = layout.getColumnGroupStart(getStripeStart(stripe_idx));
+        const uint32_t last_cell  = layout.getColumnGroupStart(getStripeStart(stripe_idx + 1));
+        for (uint32_t i{first_cell}; i < last_cell; ++i) {
+            grid.data[i].clear();
+        }
+        uint64_t overflow = 0;
+        for (uint32_t b{0}; b < batch_count; ++b) {
+            for (const Entry& entry : buckets[b * stripe_count + stripe_idx]) {
+                overflow += !grid.data[entry.cell_idx].addAtom(entry.atom_idx);
+            }
+        }
+        return overflow;
+    }
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Coarse grid levels holding the atoms too large for the collision grid
+ *
+ * Level 0 is the collision grid itself (cell size 1, radius up to 0.5). Level k has a cell size
+ * of 2^k and holds atoms with a radius up to 2^(k - 1), so each atom only needs to look at the
+ * cells within its own radius plus the largest radius of a level.
+ * Large atoms are expected to be few, levels are rebuilt every sub step with a counting sort.
+ */
+struct MultiLevelGrid
+{
+    static constexpr uint32_t level_count = 5;
+
+    /**
+     * @brief Cells of a level in column major order
+     *
+     * Atoms of cell c are atoms[cell_offsets[c]] to atoms[cell_offsets[c + 1]]
+     */
+    struct Level
+    {
+        float                 cell_size = 1.0f;
+        int32_t               width     = 0;
+        int32_t               height    = 0;
+        // Atoms of the level, in insertion order
+        std::vector<uint32_t> members;
+        std::vector<uint32_t> cell_offsets;
+        std::vector<uint32_t> atoms;
+        std::vector<uint32_t> atoms_cell;
+
+        [[nodiscard]]
+        int32_t getCellCoord(float v, int32_t size) const
+        {
+            return std::min(std::max(to<int32_t>(v / cell_size), 0), size - 1);
+        }
+
+        /**
+         * @brief Iterate over the atoms of the cells overlapping a box
+         *
+         * @param box_min top left corner of the box
+         * @param box_max bottom right corner of the box
+         * @param callback called with the atom index
+         */
+        template<typename TCallback>
+        void forEachAtom(Vec2 box_min, Vec2 box_max, TCallback&& callback) const
+        {
+            const int32_t x_min = getCellCoord(box_min.x, width);
+            const int32_t x_max = getCellCoord(box_max.x, width);
+            const int32_t y_min = getCellCoord(box_min.y, height);
+            const int32_t y_max = getCellCoord(box_max.y, height);
+            for (int32_t x{x_min}; x <= x_max; ++x) {
+                const uint32_t column = x * height;
+                for (uint32_t c{column + y_min}; c <= column + y_max; ++c) {
+                    for (uint32_t i{cell_offsets[c]}; i < cell_offsets[c + 1]; ++i) {
+                        callback(atoms[i]);
+                    }
+                }
+            }
+        }
+    };
+
+    std::array<Level, level_count> levels;
+    // Atoms found by each binning batch, per level
+    std::vector<std::array<std::vector<uint32_t>, level_count>> batches;
+
+    /**
+     * @brief Largest radius stored in a level
+     *
+     * @param level_idx index of the level
+     */
+    static constexpr float getMaxRadius(uint32_t level_idx)
+    {
+        return 0.5f * static_cast<float>(1 << level_idx);
+    }
+
+    /**
+     * @brief Level of an atom, radius above getMaxRadius(level_count - 1) are not supported
+     *
+     * @param radius radius of the atom
+     */
+    static uint32_t getLevel(float radius)
+    {
+        uint32_t level_idx = 0;
+        while (level_idx < level_count - 1 && radius > getMaxRadius(level_idx)) {
+            ++level_idx;
+        }
+        return level_idx;
+    }
+
+    /**
+     * @brief Set the levels size
+     *
+     * @param world_size size of the world
+     */
+    void resize(IVec2 world_size)
+    {
+        for (uint32_t k{1}; k < level_count; ++k) {
+            Level& level    = levels[k];
+            const int32_t cell_size = 1 << k;
+            level.cell_size = to<float>(cell_size);
+            level.width     = (world_size.x + cell_size - 1) / cell_size;
+            level.height    = (world_size.y + cell_size - 1) / cell_size;
+        }
+    }
+
+    /**
+     * @brief Discard previously binned atoms
+     *
+     * @param batch_count number of binning batches
+     */
+    void resetBatches(uint32_t batch_count)
+    {
+        batches.resize(batch_count);
+        for (auto& batch : batches) {
+            for (std::vector<uint32_t>& atoms : batch) {
+                atoms.clear();
+            }
+        }
+    }
+
+    /**
+     * @brief Add a large atom found by a binning batch
+     *
+     * @param batch_idx index of the batch filled by the calling thread
+     * @param atom_idx index of the atom
+     * @param radius radius of the atom
+     */
+    void add(uint32_t batch_idx, uint32_t atom_idx, float radius)
+    {
+        batches[batch_idx][getLevel(radius)].push_back(atom_idx);
+    }
+
+    /**
+     * @brief Gather the atoms found by all batches into the levels members
+     *
+     */
+    void gather()
+    {
+        for (uint32_t k{1}; k < level_count; ++k) {
+            std::vector<uint32_t>& members = levels[k].members;
+            members.clear();
+            for (const auto& batch : batches) {
+                members.insert(members.end(), batch[k].begin(), batch[k].end());
+            }
+        }
+    }
+
+    /**
+     * @brief Sort the members of all levels by cell using their current position
+     *
+     * @param objects objects container indexable by atom id
+     */
+    template<typename TObjects>
+    void update(const TObjects& objects)
+    {
+        for (uint32_t k{1}; k < level_count; ++k) {
+            Level& level = levels[k];
+            if (level.members.empty()) {
+                continue;
+            }
+            const uint32_t members_count = to<uint32_t>(level.members.size());
+            level.cell_offsets.assign(level.width * level.height + 1, 0);
+            level.atoms_cell.resize(members_count);
+            for (uint32_t i{0}; i < members_count; ++i) {
+                const Vec2 position = objects[level.members[i]].position;
+                const uint32_t cell = level.getCellCoord(position.x, level.width) * level.height +
+                                      level.getCellCoord(position.y, level.height);
+                level.atoms_cell[i] = cell;
+                ++level.cell_offsets[cell + 1];
+            }
+            for (uint32_t c{1}; c < level.cell_offsets.size(); ++c) {
+                level.cell_offsets[c] += level.cell_offsets[c - 1];
+            }
+            // Offsets are used as insertion cursors then shifted back
+            level.atoms.resize(members_count);
+            for (uint32_t i{0}; i < members_count; ++i) {
+                level.atoms[level.cell_offsets[level.atoms_cell[i]]++] = level.members[i];
+            }
+            for (uint32_t c{to<uint32_t>(level.cell_offsets.size()) - 1}; c > 0; --c) {
+                level.cell_offsets[c] = level.cell_offsets[c - 1];
+            }
+            level.cell_offsets[0] = 0;
+        }
+    }
+};
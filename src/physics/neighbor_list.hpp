@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "collision_grid.hpp"
+#include "engine/common/vec.hpp"
+
+/**
+ * @brief Verlet neighbor lists, candidates are all atoms closer than 1 + skin when the list is built
+ *
+ * Lists stay valid as long as no atom moved by more than half the skin since the build.
+ * They are stored per collision slice in a flat CSR layout so slices can be built and
+ * solved in parallel with the same two passes scheme used for the grid. Candidates can
+ * be more than one cell away, see getSearchReach.
+ */
+struct NeighborList
+{
+    /**
+     * @brief Candidates of all the atoms of a collision slice
+     *
+     * Neighbors of atoms[i] are neighbors[offsets[i]] to neighbors[offsets[i + 1]]
+     */
+    struct Slice
+    {
+        std::vector<uint32_t> atoms;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> neighbors;
+
+        void clear()
+        {
+            atoms.clear();
+            neighbors.clear();
+            offsets.clear();
+            offsets.push_back(0);
+        }
+    };
+
+    std::vector<Slice> slices;
+    // Positions of the atoms when the list was built
+    std::vector<Vec2>  build_positions;
+    float              skin              = 0.4f;
+    float              max_displacement2 = 0.0f;
+    // Objects operation count when the list was built, used to detect creations and removals
+    uint64_t           build_op_count    = 0;
+    bool               valid             = false;
+
+    /**
+     * @brief Checks if the list has to be rebuilt
+     *
+     * @param objects_op_count current operation count of the objects container
+     */
+    [[nodiscard]]
+    bool needsRebuild(uint64_t objects_op_count) const
+    {
+        const float half_skin = 0.5f * skin;
+        return !valid || objects_op_count != build_op_count || max_displacement2 > half_skin * half_skin;
+    }
+
+    /**
+     * @brief Number of cells searched on each side of an atom cell, cells are one contact distance wide
+     */
+    [[nodiscard]]
+    int32_t getSearchReach() const
+    {
+        return static_cast<int32_t>(std::ceil(1.0f + skin));
+    }
+
+    /**
+     * @brief Build the list of a slice of cells
+     *
+     * @param slice slice to build
+     * @param grid collision grid, up to date
+     * @param objects objects container indexable by atom id
+     * @param first_group first column group of the slice
+     * @param last_group last column group of the slice (excluded)
+     */
+    template<typename TGrid, typename TObjects>
+    void buildSlice(Slice& slice, const TGrid& grid, const TObjects& objects, uint32_t first_group, uint32_t last_group) const
+    {
+        const float   max_dist2 = (1.0f + skin) * (1.0f + skin);
+        const int32_t reach     = getSearchReach();
+        slice.clear();
+        grid.layout.forEachCell(first_group, last_group, [&](uint32_t idx, uint32_t x, uint32_t y) {
+            const CollisionCell& c = grid.data[idx];
+            if (!c.objects_count) {
+                return;
+            }
+            const int32_t x_min = std::max(static_cast<int32_t>(x) - reach, 0);
+            const int32_t x_max = std::min(static_cast<int32_t>(x) + reach, grid.width - 1);
+            const int32_t y_min = std::max(static_cast<int32_t>(y) - reach, 0);
+            const int32_t y_max = std::min(static_cast<int32_t>(y) + reach, grid.height - 1);
+            for (uint32_t i{0}; i < c.objects_count; ++i) {
+                const uint32_t atom_idx = c.objects[i];
+                const Vec2     position = objects[atom_idx].position;
+                slice.atoms.push_back(atom_idx);
+                for (int32_t nx{x_min}; nx <= x_max; ++nx) {
+                    for (int32_t ny{y_min}; ny <= y_max; ++ny) {
+                        const CollisionCell& n = grid.get(nx, ny);
+                        for (uint32_t k{0}; k < n.objects_count; ++k) {
+                            const uint32_t other_idx = n.objects[k];
+                            const Vec2     v         = position - objects[other_idx].position;
+                            if (other_idx != atom_idx && v.x * v.x + v.y * v.y < max_dist2) {
+                                slice.neighbors.push_back(other_idx);
+                            }
+                        }
+                    }
+                }
+                slice.offsets.push_back(static_cast<uint32_t>(slice.neighbors.size()));
+            }
+        });
+    }
+};
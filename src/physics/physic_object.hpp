@@ -7,13 +7,14 @@ struct PhysicObject {
 /**
  * @brief Represents a physics object in a simulation.
  *
- * This class stores the position, last position, acceleration, and color of a physics object.
+ * This class stores the position, last position, acceleration and color index of a physics object.
+ * Radius and mass are stored apart in an AtomShape, only by solvers with variable radius.
  * It provides a method to update the object's position based on the current acceleration and time step.
  */
     Vec2 position       = {0.0f, 0.0f};     /**< The current position of the physics object. */
     Vec2 last_position  = {0.0f, 0.0f};     /**< The previous position of the physics object. */
     Vec2 acceleration   = {0.0f, 0.0f};     /**< The acceleration of the physics object. */
-    sf::Color color;                        /**< The color of the physics object. */
+    uint8_t color       = 0;                /**< The color of the physics object, an index in the render palette. */
 
     /**
      * @brief Represents a physics object.
@@ -38,16 +39,41 @@ struct PhysicObject {
      * @brief Updates the position of the physics object based on the current acceleration and time step.
      *
      * @param dt The time step for the update.
+     * @param damping The damping model, see solver_config.hpp.
      */
-    void update(float dt)
+    template<typename TDamping>
+    void update(float dt, const TDamping& damping)
     {
         const Vec2 last_update_move = position - last_position;
 
-        const float VELOCITY_DAMPING = 40.0f; // arbitrary, approximating air friction
-
-        const Vec2 new_position = position + last_update_move + (acceleration - last_update_move * VELOCITY_DAMPING) * (dt * dt);
+        const Vec2 new_position = position + last_update_move + (acceleration + damping.getAcceleration(last_update_move)) * (dt * dt);
         last_position           = position;
         position                = new_position;
         acceleration = {0.0f, 0.0f};
     }
 };
+
+/**
+ * @brief Radius and mass of an atom
+ *
+ * Kept out of PhysicObject so solvers with a single radius do not load them, see
+ * BasicPhysicSolver::shapes.
+ */
+struct AtomShape
+{
+    float radius = 0.5f;
+    float mass   = 1.0f;
+
+    constexpr AtomShape() = default;
+
+    /**
+     * @brief The mass is proportional to the area, an atom of radius 0.5 has a mass of 1
+     *
+     * @param radius_ radius of the atom
+     */
+    constexpr explicit
+    AtomShape(float radius_)
+        : radius(radius_)
+        , mass(4.0f * radius_ * radius_)
+    {}
+};
@@ -1,29 +1,100 @@
 #pragma once
 
 #include <cmath>
+#include <type_traits>
 
 #include "collision_grid.hpp"
 #include "physic_object.hpp"
+#include "emitter.hpp"
+#include "solver_stats.hpp"
+#include "neighbor_list.hpp"
+#include "grid_bins.hpp"
+#include "radius_model.hpp"
+#include "solver_config.hpp"
+#include "multi_level_grid.hpp"
+#include "fluid.hpp"
+#include "distance_field.hpp"
+#include "rigid_body.hpp"
+#include "spatial_query.hpp"
+#include "force_field.hpp"
+#include "solver_command.hpp"
 #include "engine/common/utils.hpp"
 #include "engine/common/index_vector.hpp"
 #include "thread_pool/thread_pool.hpp"
+#include "thread_pool/task_graph.hpp"
+#include "profiler/profiler.hpp"
 
 /**
  * @brief Represents a physics solver.
  *
  * This class stores the physics objects in a simulation, and provides methods to update the simulation.
  * It also stores a collision grid, which is used to detect collisions between physics objects.
+ *
+ * @tparam TConfig compile time configuration, see solver_config.hpp
  */
-struct PhysicSolver
+template<typename TConfig = DefaultSolverConfig>
+struct BasicPhysicSolver
 {
+    using Config            = TConfig;
+    using CollisionGridType = BasicCollisionGrid<typename TConfig::Layout>;
+
     CIVector<PhysicObject> objects;
-    CollisionGrid          grid;
+    CollisionGridType      grid;
     Vec2                   world_size;
+    // Behavior of the world sides for atoms, walls on both axes by default
+    BoundaryConditions     boundaries;
     Vec2                   gravity = {0.0f, 20.0f};
+    // Localized accelerations added to gravity, see force_field.hpp
+    ForceFieldSet          force_fields;
+    typename TConfig::Damping damping;
 
     // Simulation solving pass count
     uint32_t        sub_steps;
     tp::ThreadPool& thread_pool;
+    // Changes requested by the input thread, applied before each sub step
+    SolverCommandQueue commands;
+    // Sub steps are skipped while paused, commands are still applied
+    bool               paused = false;
+    // Per object removal flags, reused across removeIf calls
+    std::vector<uint8_t> removal_flags;
+    // Atoms sorted by cell during integration, consumed by the next grid build
+    GridBins<CollisionGridType>   grid_bins;
+    bool                          bins_valid = false;
+    std::vector<uint64_t>         overflow_accumulators;
+    // Grid build and collision passes scheduled with dependencies instead of barriers
+    bool                          use_task_graph = true;
+    tp::TaskGraph                 substep_graph;
+    uint32_t                      substep_graph_threads = 0;
+    // Verlet neighbor lists reused across sub steps, disabled by default
+    bool                          use_neighbor_list = false;
+    NeighborList                  neighbor_list;
+    std::vector<float>            displacement_accumulators;
+    // Statistics gathering, disabled by default
+    bool                          stats_enabled = false;
+    SolverStats                   stats;
+    std::vector<StatsAccumulator> stats_accumulators;
+    std::vector<SolverStats::OccupancyHistogram> occupancy_accumulators;
+    std::vector<double>           stats_energy;
+    std::vector<float>            stats_velocity;
+    // Per atom radius and mass, atoms larger than a cell are stored in coarser grid levels.
+    // Only read with the RuntimeRadius model
+    bool                          variable_radius = false;
+    // Shapes indexed like objects.data, only filled by variable radius solvers. Atoms created
+    // without a radius get the default one on the next sub step, see syncShapes. Once filled,
+    // atoms have to be removed through the solver to keep both arrays aligned
+    std::vector<AtomShape>        shapes;
+    // Shape of all the atoms with a single radius
+    static constexpr AtomShape    default_shape{};
+    MultiLevelGrid                multi_level_grid;
+    // Position based fluid mode, replaces hard contacts between grid atoms when enabled
+    bool                          fluid_enabled = false;
+    Fluid                         fluid;
+    // Static obstacles, resolved during integration
+    DistanceField                 obstacles;
+    // Moving bodies, contacts with atoms are solved after the atoms collisions
+    std::vector<RigidBody>        bodies;
+    BodyCells                     body_cells;
+    std::vector<std::vector<BodyCorrection>> body_corrections;
 
     /**
      * @brief Construct a new Physic Solver object
@@ -31,36 +102,103 @@ struct PhysicSolver
      * @param size size of the world
      * @param tp thread pool to use
      */
-    PhysicSolver(IVec2 size, tp::ThreadPool& tp)
+    BasicPhysicSolver(IVec2 size, tp::ThreadPool& tp)
         : grid{size.x, size.y}
         , world_size{to<float>(size.x), to<float>(size.y)}
-        , sub_steps{8}
+        , sub_steps{TConfig::sub_steps}
         , thread_pool{tp}
     {
         grid.clear();
+        multi_level_grid.resize(size);
+        obstacles = DistanceField{size};
+        distributeMemory();
+    }
+
+    /**
+     * @brief Move the grid and objects memory close to the workers processing them
+     *
+     * Only has an effect with pinned workers. Called on construction, call it again after
+     * creating many objects from the main thread.
+     */
+    void distributeMemory()
+    {
+        thread_pool.firstTouch(grid.data.data(), to<uint32_t>(grid.data.size()));
+        thread_pool.firstTouch(objects.data.data(), to<uint32_t>(objects.size()));
     }
 
     /**
      * @brief Checks if two atoms are colliding and if so create a new contact
      * 
+     * @tparam TRadius radius model, see radius_model.hpp
      * @param atom_1_idx index of the first atom
      * @param atom_2_idx index of the second atom
+     * @param contact_stats statistics accumulator of the calling thread
      */
-    void solveContact(uint32_t atom_1_idx, uint32_t atom_2_idx)
+    template<typename TRadius, typename TStats>
+    void solveContact(uint32_t atom_1_idx, uint32_t atom_2_idx, TStats& contact_stats)
     {
-        constexpr float response_coef = 1.0f;
-        constexpr float eps           = 0.0001f;
-        PhysicObject& obj_1 = objects.data[atom_1_idx];
-        PhysicObject& obj_2 = objects.data[atom_2_idx];
-        const Vec2 o2_o1  = obj_1.position - obj_2.position;
-        const float dist2 = o2_o1.x * o2_o1.x + o2_o1.y * o2_o1.y;
-        if (dist2 < 1.0f && dist2 > eps) {
-            const float dist          = std::sqrt(dist2);
-            // Radius are all equal to 1.0f
-            const float delta  = response_coef * 0.5f * (1.0f - dist);
-            const Vec2 col_vec = (o2_o1 / dist) * delta;
-            obj_1.position += col_vec;
-            obj_2.position -= col_vec;
+        TRadius::template solveContact<TConfig>(objects.data[atom_1_idx], getShape<TRadius>(atom_1_idx),
+                                                objects.data[atom_2_idx], getShape<TRadius>(atom_2_idx), contact_stats);
+    }
+
+    /**
+     * @brief Shape of an atom as seen by a radius model, uniform models get the default shape
+     * without reading the shapes array
+     *
+     * @tparam TRadius radius model, see radius_model.hpp
+     * @param atom_idx data index of the atom
+     */
+    template<typename TRadius>
+    [[nodiscard]]
+    const AtomShape& getShape(uint32_t atom_idx) const
+    {
+        if constexpr (TRadius::variable) {
+            return shapes[atom_idx];
+        } else {
+            return default_shape;
+        }
+    }
+
+    /**
+     * @brief Shape of an atom, also valid for atoms created since the last sub step
+     *
+     * @param atom_idx data index of the atom
+     */
+    [[nodiscard]]
+    AtomShape getObjectShape(uint32_t atom_idx) const
+    {
+        return atom_idx < shapes.size() ? shapes[atom_idx] : AtomShape{};
+    }
+
+    /**
+     * @brief Checks if atoms have their own radius, either from the configuration or from variable_radius
+     */
+    [[nodiscard]]
+    bool isVariableRadius() const
+    {
+        if constexpr (std::is_same_v<typename TConfig::Radius, RuntimeRadius>) {
+            return variable_radius;
+        } else {
+            return TConfig::Radius::variable;
+        }
+    }
+
+    /**
+     * @brief Call a function with the radius model in use, resolves RuntimeRadius
+     * 
+     * @param callback called with a default constructed radius model
+     */
+    template<typename TCallback>
+    void withRadiusModel(TCallback&& callback)
+    {
+        if constexpr (std::is_same_v<typename TConfig::Radius, RuntimeRadius>) {
+            if (variable_radius) {
+                callback(VariableRadius{});
+            } else {
+                callback(UniformRadius{});
+            }
+        } else {
+            callback(typename TConfig::Radius{});
         }
     }
 
@@ -69,11 +207,13 @@ struct PhysicSolver
      * 
      * @param atom_idx index of the atom
      * @param c cell to check
+     * @param contact_stats statistics accumulator of the calling thread
      */
-    void checkAtomCellCollisions(uint32_t atom_idx, const CollisionCell& c)
+    template<typename TRadius, typename TStats>
+    void checkAtomCellCollisions(uint32_t atom_idx, const CollisionCell& c, TStats& contact_stats)
     {
         for (uint32_t i{0}; i < c.objects_count; ++i) {
-            solveContact(atom_idx, c.objects[i]);
+            solveContact<TRadius>(atom_idx, c.objects[i], contact_stats);
         }
     }
 
@@ -82,33 +222,235 @@ struct PhysicSolver
      * 
      * @param c cell to check
      * @param index index of the cell
+     * @param x x coordinate of the cell
+     * @param y y coordinate of the cell
+     * @param contact_stats statistics accumulator of the calling thread
      */
-    void processCell(const CollisionCell& c, uint32_t index)
+    template<typename TRadius, typename TStats>
+    void processCell(const CollisionCell& c, uint32_t index, uint32_t x, uint32_t y, TStats& contact_stats)
     {
+        if (!c.objects_count) {
+            return;
+        }
+        // Edge cells are left to solveEdgeCells, their neighborhood can wrap around the world
+        if (!boundaries.isDefault() && isEdgeCell(x, y)) {
+            return;
+        }
+        const std::array<uint32_t, 9> neighbors = grid.layout.getNeighbors(index, x, y);
         for (uint32_t i{0}; i < c.objects_count; ++i) {
             const uint32_t atom_idx = c.objects[i];
-            checkAtomCellCollisions(atom_idx, grid.data[index - 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + grid.height - 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + grid.height    ]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + grid.height + 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index - grid.height - 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index - grid.height    ]);
-            checkAtomCellCollisions(atom_idx, grid.data[index - grid.height + 1]);
+            for (const uint32_t neighbor_idx : neighbors) {
+                checkAtomCellCollisions<TRadius>(atom_idx, grid.data[neighbor_idx], contact_stats);
+            }
         }
     }
 
+    [[nodiscard]]
+    bool isEdgeCell(uint32_t x, uint32_t y) const
+    {
+        return x == 0 || y == 0 || x == to<uint32_t>(grid.width) - 1 || y == to<uint32_t>(grid.height) - 1;
+    }
+
     /**
-     * @brief Checks if an atom is colliding with all the atoms in a cell
+     * @brief Checks collisions for the atoms of the cells on the world sides
+     *
+     * Only needed when a side is not a wall, walls keep these cells empty. Neighbors across a
+     * periodic side are the cells of the opposite side, their atoms are seen shifted by the world
+     * size. Runs on the calling thread once the collision passes are done, edge cells are few.
+     */
+    void solveEdgeCells()
+    {
+        PROFILE_SCOPE("edge_cells");
+        withRadiusModel([&](auto radius_model) {
+            using Radius = decltype(radius_model);
+            if (stats_enabled) {
+                solveEdgeCells<Radius>(stats_accumulators[0]);
+            } else {
+                NoStats no_stats;
+                solveEdgeCells<Radius>(no_stats);
+            }
+        });
+    }
+
+    template<typename TRadius, typename TStats>
+    void solveEdgeCells(TStats& contact_stats)
+    {
+        const int32_t width  = grid.width;
+        const int32_t height = grid.height;
+        for (int32_t x{0}; x < width; ++x) {
+            // Inner columns only have their first and last cells on a side
+            const int32_t step = (x == 0 || x == width - 1) ? 1 : std::max(height - 1, 1);
+            for (int32_t y{0}; y < height; y += step) {
+                solveEdgeCell<TRadius>(x, y, contact_stats);
+            }
+        }
+    }
+
+    template<typename TRadius, typename TStats>
+    void solveEdgeCell(int32_t x, int32_t y, TStats& contact_stats)
+    {
+        const CollisionCell& c = grid.data[grid.layout.getIndex(x, y)];
+        if (!c.objects_count) {
+            return;
+        }
+        const bool periodic_x = boundaries.x == BoundaryMode::Periodic;
+        const bool periodic_y = boundaries.y == BoundaryMode::Periodic;
+        for (int32_t dx{-1}; dx <= 1; ++dx) {
+            int32_t nx       = x + dx;
+            float   offset_x = 0.0f;
+            if (nx < 0 || nx >= grid.width) {
+                if (!periodic_x) {
+                    continue;
+                }
+                offset_x = nx < 0 ? -world_size.x : world_size.x;
+                nx       = nx < 0 ? nx + grid.width : nx - grid.width;
+            }
+            for (int32_t dy{-1}; dy <= 1; ++dy) {
+                int32_t ny       = y + dy;
+                float   offset_y = 0.0f;
+                if (ny < 0 || ny >= grid.height) {
+                    if (!periodic_y) {
+                        continue;
+                    }
+                    offset_y = ny < 0 ? -world_size.y : world_size.y;
+                    ny       = ny < 0 ? ny + grid.height : ny - grid.height;
+                }
+                const CollisionCell& neighbor = grid.data[grid.layout.getIndex(nx, ny)];
+                const Vec2 offset{offset_x, offset_y};
+                const bool wrapped = offset_x != 0.0f || offset_y != 0.0f;
+                for (uint32_t i{0}; i < c.objects_count; ++i) {
+                    for (uint32_t k{0}; k < neighbor.objects_count; ++k) {
+                        if (wrapped) {
+                            solveWrappedContact<TRadius>(c.objects[i], neighbor.objects[k], offset, contact_stats);
+                        } else {
+                            solveContact<TRadius>(c.objects[i], neighbor.objects[k], contact_stats);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Solve a contact with an atom seen through a periodic side
+     *
+     * @param offset shift from the second atom position to its image next to the first one
+     */
+    template<typename TRadius, typename TStats>
+    void solveWrappedContact(uint32_t atom_1_idx, uint32_t atom_2_idx, Vec2 offset, TStats& contact_stats)
+    {
+        PhysicObject& obj_2 = objects.data[atom_2_idx];
+        PhysicObject  image = obj_2;
+        image.position += offset;
+        const Vec2 image_position = image.position;
+        TRadius::template solveContact<TConfig>(objects.data[atom_1_idx], getShape<TRadius>(atom_1_idx),
+                                                image, getShape<TRadius>(atom_2_idx), contact_stats);
+        // Only the correction is applied, the position is left untouched without contact
+        obj_2.position += image.position - image_position;
+    }
+
+    /**
+     * @brief Range of column groups processed by a collision task
+     */
+    struct CellRange
+    {
+        uint32_t start;
+        uint32_t end;
+    };
+
+    /**
+     * @brief Number of collision slices, the last one holds the rest of the grid
+     */
+    [[nodiscard]]
+    uint32_t getCollisionSliceCount() const
+    {
+        return thread_pool.m_thread_count * 2 + 1;
+    }
+
+    /**
+     * @brief Get the column groups of a collision slice
+     * 
+     * @param slice_idx index of the slice
+     */
+    [[nodiscard]]
+    CellRange getCollisionSlice(uint32_t slice_idx) const
+    {
+        const uint32_t slice_count = thread_pool.m_thread_count * 2;
+        const uint32_t group_count = grid.layout.getColumnGroupCount();
+        const uint32_t slice_size  = group_count / slice_count;
+        if (slice_idx < slice_count) {
+            return {slice_idx * slice_size, (slice_idx + 1) * slice_size};
+        }
+        // Eventually process rest if the world is not divisible by the thread count
+        return {slice_count * slice_size, group_count};
+    }
+
+    /**
+     * @brief Checks collisions for all the atoms of a slice
+     * 
+     * @param slice_idx index of the slice
+     * @param task_idx index of the task, used to select the statistics accumulator
+     */
+    void solveCollisionThreaded(uint32_t slice_idx, uint32_t task_idx)
+    {
+        withRadiusModel([&](auto radius_model) {
+            using Radius = decltype(radius_model);
+            if (stats_enabled) {
+                solveCollisionSlice<Radius>(slice_idx, stats_accumulators[task_idx]);
+            } else {
+                NoStats no_stats;
+                solveCollisionSlice<Radius>(slice_idx, no_stats);
+            }
+        });
+    }
+
+    /**
+     * @brief Checks collisions for all the atoms of a slice, using the grid or the neighbor list
      * 
-     * @param start start index
-     * @param end end index
+     * @param slice_idx index of the slice
+     * @param contact_stats statistics accumulator of the calling thread
      */
-    void solveCollisionThreaded(uint32_t start, uint32_t end)
+    template<typename TRadius, typename TStats>
+    void solveCollisionSlice(uint32_t slice_idx, TStats& contact_stats)
     {
-        for (uint32_t idx{start}; idx < end; ++idx) {
-            processCell(grid.data[idx], idx);
+        if (usesNeighborList()) {
+            solveNeighborListSlice<TRadius>(neighbor_list.slices[slice_idx], contact_stats);
+        } else {
+            const CellRange range = getCollisionSlice(slice_idx);
+            solveCollisionRange<TRadius>(range.start, range.end, contact_stats);
+        }
+    }
+
+    /**
+     * @brief Checks collisions for all the cells of a range of column groups, in memory order
+     * 
+     * @param start first column group
+     * @param end last column group (excluded)
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TRadius, typename TStats>
+    void solveCollisionRange(uint32_t start, uint32_t end, TStats& contact_stats)
+    {
+        grid.layout.forEachCell(start, end, [&](uint32_t idx, uint32_t x, uint32_t y) {
+            processCell<TRadius>(grid.data[idx], idx, x, y, contact_stats);
+        });
+    }
+
+    /**
+     * @brief Checks collisions of the atoms of a slice against their neighbor list candidates
+     * 
+     * @param slice neighbor list slice
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TRadius, typename TStats>
+    void solveNeighborListSlice(const NeighborList::Slice& slice, TStats& contact_stats)
+    {
+        const uint32_t atoms_count = to<uint32_t>(slice.atoms.size());
+        for (uint32_t i{0}; i < atoms_count; ++i) {
+            const uint32_t atom_idx = slice.atoms[i];
+            for (uint32_t k{slice.offsets[i]}; k < slice.offsets[i + 1]; ++k) {
+                solveContact<TRadius>(atom_idx, slice.neighbors[k], contact_stats);
+            }
         }
     }
 
@@ -118,37 +460,505 @@ struct PhysicSolver
      */
     void solveCollisions()
     {
-        // Multi-thread grid
-        const uint32_t thread_count = thread_pool.m_thread_count;
-        const uint32_t slice_count  = thread_count * 2;
-        const uint32_t slice_size   = (grid.width / slice_count) * grid.height;
-        const uint32_t last_cell    = (2 * (thread_count - 1) + 2) * slice_size;
+        PROFILE_SCOPE("collisions");
         // Find collisions in two passes to avoid data races
+        solveCollisionsPass(0);
+        solveCollisionsPass(1);
+        if (!boundaries.isDefault()) {
+            solveEdgeCells();
+        }
+        if (isVariableRadius()) {
+            solveLargeAtomsCollisions();
+        }
+    }
 
-        // First collision pass
+    /**
+     * @brief Process one every two grid slices, consecutive slices are never processed concurrently
+     * 
+     * @param pass 0 for even slices, 1 for odd slices
+     */
+    void solveCollisionsPass(uint32_t pass)
+    {
+        PROFILE_SCOPE(pass ? "collision_pass_2" : "collision_pass_1");
+        // Multi-thread grid
+        const uint32_t thread_count = thread_pool.m_thread_count;
         for (uint32_t i{0}; i < thread_count; ++i) {
-            thread_pool.addTask([this, i, slice_size]{
-                uint32_t const start{2 * i * slice_size};
-                uint32_t const end  {start + slice_size};
-                solveCollisionThreaded(start, end);
+            thread_pool.addTask(i, [this, i, pass]{
+                solveCollisionThreaded(2 * i + pass, i);
             });
         }
-        // Eventually process rest if the world is not divisible by the thread count
-        if (last_cell < grid.data.size()) {
-            thread_pool.addTask([this, last_cell]{
-                solveCollisionThreaded(last_cell, to<uint32_t>(grid.data.size()));
-            });
+        // The rest slice is not adjacent to the last even slice, it is processed by the
+        // calling thread like the remainder of ThreadPool::dispatchIndexed
+        const CellRange rest = getCollisionSlice(2 * thread_count);
+        if (pass == 0 && rest.start < rest.end) {
+            solveCollisionThreaded(2 * thread_count, thread_count);
         }
         thread_pool.waitForCompletion();
-        // Second collision pass
+    }
+
+    /**
+     * @brief Checks if the grid build and collision passes run as a task graph
+     *
+     * Only the plain contact path is scheduled this way, other modes need the whole grid between phases.
+     */
+    [[nodiscard]]
+    bool usesTaskGraph() const
+    {
+        return use_task_graph && !usesNeighborList() && !fluid_enabled && bodies.empty();
+    }
+
+    /**
+     * @brief Build the grid and solve the collisions without global barriers
+     *
+     * @return the number of objects dropped because their cell was full
+     */
+    uint64_t solveSubStepGraph()
+    {
+        PROFILE_SCOPE("substep_graph");
+        if (!bins_valid) {
+            binObjects();
+        }
+        bins_valid = false;
+        if (substep_graph.empty() || substep_graph_threads != thread_pool.m_thread_count) {
+            buildSubStepGraph();
+        }
+        overflow_accumulators.assign(grid_bins.stripe_count, 0);
+        substep_graph.run(thread_pool);
+        if (!boundaries.isDefault()) {
+            solveEdgeCells();
+        }
+        uint64_t overflow{0};
+        for (const uint64_t stripe_overflow : overflow_accumulators) {
+            overflow += stripe_overflow;
+        }
+        if (isVariableRadius()) {
+            multi_level_grid.gather();
+            solveLargeAtomsCollisions();
+        }
+        return overflow;
+    }
+
+    /**
+     * @brief Create the tasks of a sub step and their dependencies
+     *
+     * A collision slice reads the cells of its columns and of the neighbor columns, it waits for
+     * the grid stripes covering them. Odd slices also wait for the two even slices next to them,
+     * which move atoms of their border columns.
+     */
+    void buildSubStepGraph()
+    {
+        const uint32_t thread_count = thread_pool.m_thread_count;
+        substep_graph.clear();
+        substep_graph_threads = thread_count;
+        // Stripes of the grid build, stripe_count is set by the binning
+        std::vector<uint32_t> stripe_nodes(thread_count);
         for (uint32_t i{0}; i < thread_count; ++i) {
-            thread_pool.addTask([this, i, slice_size]{
-                uint32_t const start{(2 * i + 1) * slice_size};
-                uint32_t const end  {start + slice_size};
-                solveCollisionThreaded(start, end);
+            stripe_nodes[i] = substep_graph.addNode(i, [this, i]{
+                overflow_accumulators[i] = grid_bins.buildStripe(grid, i);
             });
         }
-        thread_pool.waitForCompletion();
+        const uint32_t slice_count = getCollisionSliceCount();
+        std::vector<uint32_t> slice_nodes(slice_count);
+        for (uint32_t k{0}; k < slice_count; ++k) {
+            // Same task index as solveCollisionsPass, used for the statistics accumulators
+            const uint32_t task_idx = std::min(k / 2, thread_count);
+            // The rest slice is not bound to the worker owning the last even slice
+            const uint32_t owner = task_idx < thread_count ? task_idx : tp::ThreadPool::any_worker;
+            slice_nodes[k] = substep_graph.addNode(owner, [this, k, task_idx]{
+                solveCollisionThreaded(k, task_idx);
+            });
+            const CellRange range     = getCollisionSlice(k);
+            const uint32_t  first     = range.start > 0 ? range.start - 1 : 0;
+            const uint32_t  last      = range.end + 1;
+            for (uint32_t i{0}; i < thread_count; ++i) {
+                const uint32_t stripe_start = grid_bins.getStripeStart(i);
+                const uint32_t stripe_end   = grid_bins.getStripeStart(i + 1);
+                if (stripe_start < last && first < stripe_end && stripe_start < stripe_end) {
+                    substep_graph.addDependency(stripe_nodes[i], slice_nodes[k]);
+                }
+            }
+        }
+        // The rest slice is last and handled like an even slice
+        for (uint32_t k{1}; k < slice_count; k += 2) {
+            substep_graph.addDependency(slice_nodes[k - 1], slice_nodes[k]);
+            if (k + 1 < slice_count) {
+                substep_graph.addDependency(slice_nodes[k + 1], slice_nodes[k]);
+            }
+        }
+    }
+
+    /**
+     * @brief Checks collisions of the atoms stored in the coarse grid levels
+     *
+     * Large atoms solve their contacts with atoms of the same level and of all the finer ones.
+     * Each level is split in slices of at least two coarse columns so atoms processed
+     * concurrently never reach the same cell, slices are processed in two passes like the grid.
+     */
+    void solveLargeAtomsCollisions()
+    {
+        PROFILE_SCOPE("large_atoms");
+        multi_level_grid.update(objects.data);
+        const uint32_t thread_count = thread_pool.m_thread_count;
+        for (uint32_t k{1}; k < MultiLevelGrid::level_count; ++k) {
+            const MultiLevelGrid::Level& level = multi_level_grid.levels[k];
+            if (level.members.empty()) {
+                continue;
+            }
+            const uint32_t width       = to<uint32_t>(level.width);
+            const uint32_t slice_width = std::max(2u, (width + 2 * thread_count - 1) / (2 * thread_count));
+            const uint32_t slice_count = (width + slice_width - 1) / slice_width;
+            for (uint32_t pass{0}; pass < 2; ++pass) {
+                for (uint32_t i{pass}; i < slice_count; i += 2) {
+                    thread_pool.addTask([this, k, i, slice_width, width]{
+                        const uint32_t first_column = i * slice_width;
+                        const uint32_t last_column  = std::min(first_column + slice_width, width);
+                        if (stats_enabled) {
+                            solveLevelSlice(k, first_column, last_column, stats_accumulators[i / 2]);
+                        } else {
+                            NoStats no_stats;
+                            solveLevelSlice(k, first_column, last_column, no_stats);
+                        }
+                    });
+                }
+                thread_pool.waitForCompletion();
+            }
+        }
+    }
+
+    /**
+     * @brief Checks collisions for all the atoms of a range of columns of a level
+     * 
+     * @param level_idx index of the level
+     * @param first_column first column of the range
+     * @param last_column last column of the range (excluded)
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TStats>
+    void solveLevelSlice(uint32_t level_idx, uint32_t first_column, uint32_t last_column, TStats& contact_stats)
+    {
+        const MultiLevelGrid::Level& level = multi_level_grid.levels[level_idx];
+        const uint32_t first_cell = first_column * level.height;
+        const uint32_t last_cell  = last_column * level.height;
+        for (uint32_t i{level.cell_offsets[first_cell]}; i < level.cell_offsets[last_cell]; ++i) {
+            solveLargeAtom(level_idx, level.atoms[i], contact_stats);
+        }
+    }
+
+    /**
+     * @brief Checks collisions of a large atom with the atoms of its level and of the finer levels
+     * 
+     * @param level_idx level of the atom
+     * @param atom_idx index of the atom
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TStats>
+    void solveLargeAtom(uint32_t level_idx, uint32_t atom_idx, TStats& contact_stats)
+    {
+        const Vec2  position = objects.data[atom_idx].position;
+        const float radius   = shapes[atom_idx].radius;
+        for (uint32_t k{1}; k <= level_idx; ++k) {
+            const MultiLevelGrid::Level& level = multi_level_grid.levels[k];
+            if (level.members.empty()) {
+                continue;
+            }
+            const float reach = radius + MultiLevelGrid::getMaxRadius(k);
+            level.forEachAtom(position - Vec2{reach, reach}, position + Vec2{reach, reach}, [&](uint32_t other_idx) {
+                if (other_idx != atom_idx) {
+                    solveContact<VariableRadius>(atom_idx, other_idx, contact_stats);
+                }
+            });
+        }
+        // Small atoms are in the collision grid
+        const float reach = radius + MultiLevelGrid::getMaxRadius(0);
+        const int32_t x_min = std::max(to<int32_t>(position.x - reach), 0);
+        const int32_t x_max = std::min(to<int32_t>(position.x + reach), grid.width - 1);
+        const int32_t y_min = std::max(to<int32_t>(position.y - reach), 0);
+        const int32_t y_max = std::min(to<int32_t>(position.y + reach), grid.height - 1);
+        for (int32_t x{x_min}; x <= x_max; ++x) {
+            for (int32_t y{y_min}; y <= y_max; ++y) {
+                checkAtomCellCollisions<VariableRadius>(atom_idx, grid.get(x, y), contact_stats);
+            }
+        }
+    }
+
+    /**
+     * @brief Solve the fluid constraints of the atoms in the grid, then the large atoms contacts
+     * 
+     */
+    void solveFluid()
+    {
+        PROFILE_SCOPE("fluid");
+        if (!fluid.initialized) {
+            fluid.initialize();
+        }
+        fluid.resize(to<uint32_t>(objects.size()), grid.width, grid.height);
+        const auto     width       = to<uint32_t>(grid.width);
+        const uint32_t slice_count = fluid.getSliceCount(2 * thread_pool.m_thread_count);
+        thread_pool.dispatch(width, [&](uint32_t start, uint32_t end) {
+            fluid.countAtoms(grid, start, end);
+        });
+        const uint32_t atoms_count = fluid.computeColumnStarts();
+        thread_pool.dispatch(width, [&](uint32_t start, uint32_t end) {
+            fluid.load(grid, objects.data, start, end);
+        });
+        fluid.slices.resize(slice_count);
+        thread_pool.dispatch(slice_count, [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                fluid.buildSlice(fluid.slices[i], to<int32_t>(width * i / slice_count), to<int32_t>(width * (i + 1) / slice_count));
+            }
+        });
+        // Passes write atoms of the next slice, consecutive slices are never processed concurrently
+        const auto for_each_slice = [&](auto&& pass) {
+            for (uint32_t parity{0}; parity < 2; ++parity) {
+                thread_pool.dispatch((slice_count + 1 - parity) / 2, [&](uint32_t start, uint32_t end) {
+                    for (uint32_t i{start}; i < end; ++i) {
+                        pass(fluid.slices[2 * i + parity]);
+                    }
+                });
+            }
+        };
+        for (uint32_t k{0}; k < fluid.settings.iterations; ++k) {
+            // Relative positions are gathered by the build for the first iteration
+            if (k > 0) {
+                thread_pool.dispatch(slice_count, [&](uint32_t start, uint32_t end) {
+                    for (uint32_t i{start}; i < end; ++i) {
+                        fluid.updatePairs(fluid.slices[i]);
+                    }
+                });
+            }
+            for_each_slice([&](Fluid::Slice& slice) { fluid.accumulateDensity(slice); });
+            thread_pool.dispatch(atoms_count, [&](uint32_t start, uint32_t end) {
+                fluid.computeLambda(start, end);
+            });
+            for_each_slice([&](const Fluid::Slice& slice) { fluid.computeDelta(slice); });
+            thread_pool.dispatch(atoms_count, [&](uint32_t start, uint32_t end) {
+                fluid.applyDelta(start, end);
+            });
+        }
+        for_each_slice([&](const Fluid::Slice& slice) { fluid.computeViscosity(slice); });
+        thread_pool.dispatch(atoms_count, [&](uint32_t start, uint32_t end) {
+            fluid.store(objects.data, start, end);
+        });
+        if (isVariableRadius()) {
+            solveLargeAtomsCollisions();
+        }
+    }
+
+    /**
+     * @brief Queries over the current grid, see spatial_query.hpp
+     *
+     * The grid is only rebuilt by update, results are unreliable between removeIf and the next update.
+     */
+    [[nodiscard]]
+    GridQuery<CollisionGridType> getGridQuery() const
+    {
+        return {grid, objects.data.data(), to<uint32_t>(objects.size()), shapes.empty() ? nullptr : shapes.data(), to<uint32_t>(shapes.size())};
+    }
+
+    /**
+     * @brief Run a query, results are atoms data indices
+     *
+     * @param q RadiusQuery, BoxQuery, NearestQuery or RaycastQuery
+     */
+    template<typename TQuery>
+    void query(TQuery& q) const
+    {
+        getGridQuery().query(q);
+    }
+
+    /**
+     * @brief Run queries in parallel on the thread pool, each query writes to its own buffers
+     *
+     * @param queries queries of the same type
+     * @param count number of queries
+     */
+    template<typename TQuery>
+    void queryBatch(TQuery* queries, uint32_t count) const
+    {
+        const GridQuery<CollisionGridType> grid_query = getGridQuery();
+        thread_pool.dispatch(count, [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                grid_query.query(queries[i]);
+            }
+        });
+    }
+
+    /**
+     * @brief Add a rigid body, atoms overlapping it are pushed out in a single sub step
+     *
+     * @param body the body, see RigidBody::makeCircle and RigidBody::makePolygon
+     * @return the index of the body
+     */
+    uint32_t addBody(const RigidBody& body)
+    {
+        bodies.push_back(body);
+        return to<uint32_t>(bodies.size() - 1);
+    }
+
+    /**
+     * @brief Solve the contacts between atoms and bodies
+     *
+     * Bodies are rasterized over the grid cells they overlap, each touched cell is then processed
+     * by a single task so atoms are never accessed concurrently. Corrections received by the bodies
+     * are accumulated per task and reduced once all the cells are done.
+     */
+    void solveBodiesContacts()
+    {
+        PROFILE_SCOPE("bodies");
+        const uint32_t batch_count = thread_pool.getBatchCount();
+        const uint32_t body_count  = to<uint32_t>(bodies.size());
+        body_cells.build(grid, bodies, 0.5f);
+        // Batches may be empty, accumulators are cleared first
+        body_corrections.resize(batch_count);
+        for (std::vector<BodyCorrection>& corrections : body_corrections) {
+            corrections.assign(body_count, {});
+        }
+        withRadiusModel([&](auto radius_model) {
+            using Radius = decltype(radius_model);
+            thread_pool.dispatchIndexed(to<uint32_t>(body_cells.touched_cells.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end) {
+                std::vector<BodyCorrection>& corrections = body_corrections[batch_idx];
+                for (uint32_t i{start}; i < end; ++i) {
+                    const CollisionCell& cell = grid.data[body_cells.touched_cells[i]];
+                    for (uint32_t k{body_cells.offsets[i]}; k < body_cells.offsets[i + 1]; ++k) {
+                        const uint32_t body_idx = body_cells.bodies[k];
+                        for (uint32_t a{0}; a < cell.objects_count; ++a) {
+                            const uint32_t atom_idx = cell.objects[a];
+                            solveBodyContact(objects.data[atom_idx], getShape<Radius>(atom_idx), body_idx, corrections[body_idx]);
+                        }
+                    }
+                }
+            });
+        });
+        if (isVariableRadius()) {
+            solveLargeAtomsBodiesContacts();
+        }
+        // Reduce the corrections
+        for (uint32_t b{0}; b < body_count; ++b) {
+            RigidBody& body = bodies[b];
+            if (body.kinematic) {
+                continue;
+            }
+            BodyCorrection total;
+            for (const std::vector<BodyCorrection>& corrections : body_corrections) {
+                total.translation += corrections[b].translation;
+                total.rotation    += corrections[b].rotation;
+            }
+            body.position += total.translation;
+            body.angle    += total.rotation;
+            body.updateShape();
+        }
+    }
+
+    /**
+     * @brief Solve the contacts between bodies and the atoms stored in the coarse grid levels
+     *
+     * There are few large atoms, they are processed by the calling thread.
+     */
+    void solveLargeAtomsBodiesContacts()
+    {
+        std::vector<BodyCorrection>& corrections = body_corrections[0];
+        const uint32_t body_count = to<uint32_t>(bodies.size());
+        for (uint32_t k{1}; k < MultiLevelGrid::level_count; ++k) {
+            for (const uint32_t atom_idx : multi_level_grid.levels[k].members) {
+                PhysicObject&    obj    = objects.data[atom_idx];
+                const AtomShape& shape  = shapes[atom_idx];
+                const float      radius = shape.radius;
+                for (uint32_t b{0}; b < body_count; ++b) {
+                    const RigidBody& body = bodies[b];
+                    if (obj.position.x + radius > body.aabb_min.x && obj.position.x - radius < body.aabb_max.x &&
+                        obj.position.y + radius > body.aabb_min.y && obj.position.y - radius < body.aabb_max.y) {
+                        solveBodyContact(obj, shape, b, corrections[b]);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Push an atom out of a body, the body correction is accumulated
+     *
+     * The penetration is split according to the atom mass and to the body mass and inertia
+     * at the contact point, kinematic bodies have neither and push the atom by the full penetration.
+     *
+     * @param obj the atom
+     * @param shape radius and mass of the atom
+     * @param body_idx index of the body
+     * @param correction correction accumulator of the body for the calling thread
+     */
+    void solveBodyContact(PhysicObject& obj, const AtomShape& shape, uint32_t body_idx, BodyCorrection& correction)
+    {
+        const RigidBody& body   = bodies[body_idx];
+        const float      radius = shape.radius;
+        Vec2 normal;
+        const float dist = body.getDistance(obj.position, normal);
+        if (dist < radius) {
+            // Lever arm of the contact point
+            const Vec2  arm      = obj.position - normal * dist - body.position;
+            const float arm_n    = arm.x * normal.y - arm.y * normal.x;
+            const float obj_w    = 1.0f / shape.mass;
+            const float body_w   = body.inv_mass + body.inv_inertia * arm_n * arm_n;
+            const float impulse  = TConfig::response_coef * (radius - dist) / (obj_w + body_w);
+            obj.position           += normal * (impulse * obj_w);
+            correction.translation -= normal * (impulse * body.inv_mass);
+            correction.rotation    -= arm_n * impulse * body.inv_inertia;
+        }
+    }
+
+    /**
+     * @brief Checks if neighbor lists are in use, the fluid mode, bodies and non wall boundaries always use the grid
+     *
+     * Lists reach atoms getSearchReach cells away, slices solved concurrently have to stay apart by
+     * twice that many columns. Narrower slices, on small worlds or with many threads, use the grid.
+     * Variable radius atoms use the grid too: large atoms find their contacts in the collision grid,
+     * which is not rebuilt while lists are reused.
+     */
+    [[nodiscard]]
+    bool usesNeighborList() const
+    {
+        return use_neighbor_list && !fluid_enabled && bodies.empty() && boundaries.isDefault() && !isVariableRadius() &&
+               getMinSliceColumns() >= 2 * to<uint32_t>(neighbor_list.getSearchReach());
+    }
+
+    /**
+     * @brief Lower bound of the number of columns of the collision slices, the rest slice excluded
+     */
+    [[nodiscard]]
+    uint32_t getMinSliceColumns() const
+    {
+        const uint32_t group_count = grid.layout.getColumnGroupCount();
+        const uint32_t slice_size  = group_count / (thread_pool.m_thread_count * 2);
+        return slice_size * (to<uint32_t>(grid.width) / std::max(group_count, 1u));
+    }
+
+    /**
+     * @brief Build the neighbor lists of all slices from the current grid
+     * 
+     */
+    void buildNeighborList()
+    {
+        PROFILE_SCOPE("neighbor_list_build");
+        const uint32_t slice_count = getCollisionSliceCount();
+        neighbor_list.slices.resize(slice_count);
+        // Built by the worker solving the slice, slices 2k and 2k + 1 are solved by task k,
+        // the rest slice by the calling thread
+        for (uint32_t i{0}; i < slice_count; ++i) {
+            const uint32_t owner = i / 2 < thread_pool.m_thread_count ? i / 2 : tp::ThreadPool::any_worker;
+            thread_pool.addTask(owner, [this, i]{
+                const CellRange range = getCollisionSlice(i);
+                neighbor_list.buildSlice(neighbor_list.slices[i], grid, objects.data, range.start, range.end);
+            });
+        }
+        // Slices are built while positions are saved, dispatch waits for all tasks
+        const uint32_t objects_count = to<uint32_t>(objects.size());
+        neighbor_list.build_positions.resize(objects_count);
+        thread_pool.dispatch(objects_count, [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                neighbor_list.build_positions[i] = objects.data[i].position;
+            }
+        });
+        neighbor_list.max_displacement2 = 0.0f;
+        neighbor_list.build_op_count    = objects.op_count;
+        neighbor_list.valid             = true;
     }
 
 
@@ -162,6 +972,168 @@ struct PhysicSolver
         return objects.emplace_back(pos);
     }
 
+    /**
+     * @brief Add a new object with its own radius, enables variable radius
+     * 
+     * @param pos position of the object
+     * @param radius radius of the object, see setObjectRadius
+     */
+    uint64_t createObject(Vec2 pos, float radius)
+    {
+        const uint64_t id = objects.emplace_back(pos);
+        // Created objects are always last
+        setObjectRadius(to<uint32_t>(objects.size()) - 1, radius);
+        return id;
+    }
+
+    /**
+     * @brief Give an object its own radius, enables variable radius
+     *
+     * Larger atoms than the coarsest grid level supports would miss contacts, their radius is clamped.
+     *
+     * @param atom_idx data index of the object
+     * @param radius radius of the object, up to MultiLevelGrid::getMaxRadius(MultiLevelGrid::level_count - 1)
+     */
+    void setObjectRadius(uint32_t atom_idx, float radius)
+    {
+        static_assert(!std::is_same_v<typename TConfig::Radius, UniformRadius>, "Uniform radius solvers ignore the radius");
+        constexpr float max_radius = MultiLevelGrid::getMaxRadius(MultiLevelGrid::level_count - 1);
+        variable_radius = true;
+        syncShapes();
+        shapes[atom_idx] = AtomShape{std::min(radius, max_radius)};
+    }
+
+    /**
+     * @brief Give the default shape to the objects created without one, no effect with a single radius
+     */
+    void syncShapes()
+    {
+        if (isVariableRadius()) {
+            shapes.resize(objects.size());
+        }
+    }
+
+    /**
+     * @brief Remove an object, the last object is moved to its data index
+     *
+     * @param atom_idx data index of the object
+     */
+    void eraseObjectViaData(uint32_t atom_idx)
+    {
+        if (!shapes.empty()) {
+            shapes.resize(objects.size());
+            shapes[atom_idx] = shapes.back();
+            shapes.pop_back();
+        }
+        objects.eraseViaData(atom_idx);
+    }
+
+    /**
+     * @brief Add objects in bulk, storage is grown only once
+     *
+     * @param count number of objects to create
+     * @param initializer callable taking the object index in the batch and a PhysicObject& to fill, called in parallel
+     * @return the data index of the first created object
+     */
+    template<typename TInitializer>
+    uint64_t createObjects(uint32_t count, TInitializer&& initializer)
+    {
+        const uint64_t first = objects.allocate(count);
+        thread_pool.dispatch(count, [&](uint32_t start, uint32_t end){
+            for (uint32_t k{start}; k < end; ++k) {
+                initializer(k, objects.data[first + k]);
+            }
+        });
+        return first;
+    }
+
+    /**
+     * @brief Add objects in bulk from arrays of attributes
+     *
+     * @param positions positions of the objects
+     * @param velocities initial velocities expressed as a displacement per sub step, can be null
+     * @param colors palette indices of the objects colors, can be null
+     * @param count number of objects to create
+     * @return the data index of the first created object
+     */
+    uint64_t createObjects(const Vec2* positions, const Vec2* velocities, const uint8_t* colors, uint32_t count)
+    {
+        return createObjects(count, [=](uint32_t k, PhysicObject& obj) {
+            obj = PhysicObject{positions[k]};
+            if (velocities) {
+                obj.last_position -= velocities[k];
+            }
+            if (colors) {
+                obj.color = colors[k];
+            }
+        });
+    }
+
+    /**
+     * @brief Add objects following an emitter shape
+     *
+     * @param shape emitter shape, see emitter.hpp
+     * @param velocity initial velocity expressed as a displacement per sub step
+     * @return the data index of the first created object
+     */
+    template<typename TShape>
+    uint64_t emit(const TShape& shape, Vec2 velocity = {})
+    {
+        return createObjects(shape.getCount(), [&shape, velocity](uint32_t k, PhysicObject& obj) {
+            obj = PhysicObject{shape.getPosition(k)};
+            obj.last_position -= velocity;
+        });
+    }
+
+    /**
+     * @brief Remove all objects matching a predicate
+     *
+     * The predicate is evaluated in parallel, removal is then performed
+     * with swap-remove so only the removed objects are touched.
+     *
+     * @param predicate callable taking a const PhysicObject& and returning true if it has to be removed
+     * @return the number of removed objects
+     */
+    template<typename TPredicate>
+    uint64_t removeIf(TPredicate&& predicate)
+    {
+        const uint32_t objects_count = to<uint32_t>(objects.size());
+        removal_flags.resize(objects_count);
+        thread_pool.dispatch(objects_count, [&](uint32_t start, uint32_t end){
+            for (uint32_t i{start}; i < end; ++i) {
+                removal_flags[i] = predicate(objects.data[i]) ? 1 : 0;
+            }
+        });
+        // Backward iteration so swapped in objects have already been tested
+        uint64_t removed_count = 0;
+        for (uint32_t i{objects_count}; i--;) {
+            if (removal_flags[i]) {
+                eraseObjectViaData(i);
+                ++removed_count;
+            }
+        }
+        // Binned indices now point to the objects swapped in the freed emplacements
+        if (removed_count) {
+            bins_valid = false;
+        }
+        return removed_count;
+    }
+
+    /**
+     * @brief Remove all objects located inside a rectangular region
+     *
+     * @param region_min top left corner of the region
+     * @param region_max bottom right corner of the region
+     * @return the number of removed objects
+     */
+    uint64_t removeInRegion(Vec2 region_min, Vec2 region_max)
+    {
+        return removeIf([region_min, region_max](const PhysicObject& obj) {
+            return obj.position.x >= region_min.x && obj.position.x <= region_max.x &&
+                   obj.position.y >= region_min.y && obj.position.y <= region_max.y;
+        });
+    }
+
     /**
      * @brief Update the solver
      * 
@@ -169,60 +1141,401 @@ struct PhysicSolver
      */
     void update(float dt)
     {
+        PROFILE_SCOPE("update");
+        if (stats_enabled) {
+            stats.reset(sub_steps);
+        }
         // Perform the sub steps
         const float sub_dt = dt / static_cast<float>(sub_steps);
         for (uint32_t i(sub_steps); i--;) {
-            addObjectsToGrid();
-            solveCollisions();
-            updateObjects_multi(sub_dt);
+            PROFILE_SCOPE("substep");
+            applyCommands();
+            if (paused) {
+                break;
+            }
+            resetStatsAccumulators();
+            uint64_t overflow = 0;
+            // Lists are not maintained while disabled
+            const bool neighbor_list_used = usesNeighborList();
+            neighbor_list.valid &= neighbor_list_used;
+            if (usesTaskGraph()) {
+                overflow = solveSubStepGraph();
+            } else {
+                if (!neighbor_list_used || neighbor_list.needsRebuild(objects.op_count)) {
+                    overflow = addObjectsToGrid();
+                    if (neighbor_list_used) {
+                        buildNeighborList();
+                    }
+                }
+                if (!bodies.empty()) {
+                    solveBodiesContacts();
+                }
+                if (fluid_enabled) {
+                    solveFluid();
+                } else {
+                    solveCollisions();
+                }
+            }
+            if (stats_enabled) {
+                reduceSubStepStats(sub_steps - 1 - i, overflow);
+            }
+            // Objects are binned while integrated, except after the last sub step since
+            // they can be modified before the next update and with neighbor lists since
+            // the grid is rarely needed
+            updateObjects_multi(sub_dt, i > 0 && !neighbor_list_used);
+        }
+        if (boundaries.hasOpenSide()) {
+            removeOutflow();
+        }
+        if (stats_enabled) {
+            computeFrameStats(sub_dt);
         }
     }
 
     /**
-     * @brief Add all objects to the grid
+     * @brief Apply the commands pushed since the previous sub step, in order
+     */
+    void applyCommands()
+    {
+        SolverCommand command;
+        bool applied = false;
+        while (commands.pop(command)) {
+            applyCommand(command);
+            applied = true;
+        }
+        // Created atoms are missing from the bins of the last integration
+        bins_valid &= !applied;
+        syncShapes();
+    }
+
+    void applyCommand(const SolverCommand& command)
+    {
+        using Type = SolverCommand::Type;
+        switch (command.type) {
+        case Type::None:
+            break;
+        case Type::Spawn: {
+            const SolverCommand::Spawn& spawn = command.payload.spawn;
+            uint64_t id;
+            if constexpr (std::is_same_v<typename TConfig::Radius, UniformRadius>) {
+                id = createObject(spawn.position);
+            } else {
+                id = spawn.radius == AtomShape{}.radius ? createObject(spawn.position) : createObject(spawn.position, spawn.radius);
+            }
+            PhysicObject& obj = objects[id];
+            obj.last_position -= spawn.velocity;
+            obj.color          = spawn.color;
+            break;
+        }
+        case Type::Emit: {
+            const SolverCommand::Emit& emit = command.payload.emit;
+            const uint64_t objects_count = objects.size();
+            if (objects_count >= emit.max_objects) {
+                break;
+            }
+            const auto count = to<uint32_t>(std::min<uint64_t>(emit.line.getCount(), emit.max_objects - objects_count));
+            createObjects(count, [&emit](uint32_t k, PhysicObject& obj) {
+                obj = PhysicObject{emit.line.getPosition(k)};
+                obj.last_position -= emit.velocity;
+                obj.color          = emit.color;
+            });
+            break;
+        }
+        case Type::AddForceField:
+            force_fields.add(command.payload.force_field);
+            break;
+        case Type::AddBody: {
+            RigidBody body;
+            if (commands.popBody(body)) {
+                bodies.push_back(std::move(body));
+            }
+            break;
+        }
+        case Type::ClearBodies:
+            bodies.clear();
+            break;
+        case Type::AddObstacleSegment: {
+            const SolverCommand::Segment& segment = command.payload.segment;
+            obstacles.addSegment(segment.start, segment.end, segment.thickness);
+            break;
+        }
+        case Type::AddObstacleCircle:
+            obstacles.addCircle(command.payload.circle.center, command.payload.circle.radius);
+            break;
+        case Type::ClearObstacles:
+            obstacles.clear();
+            break;
+        case Type::SetGravity:
+            gravity = command.payload.gravity;
+            break;
+        case Type::SetBoundaries:
+            boundaries = command.payload.boundaries;
+            break;
+        case Type::TogglePause:
+            paused = !paused;
+            break;
+        case Type::ToggleNeighborList:
+            use_neighbor_list = !use_neighbor_list;
+            break;
+        case Type::ToggleFluid:
+            fluid_enabled = !fluid_enabled;
+            break;
+        case Type::ToggleStats:
+            stats_enabled = !stats_enabled;
+            // Enabled during an update, the frame statistics start at this sub step
+            if (stats_enabled) {
+                stats.reset(sub_steps);
+            }
+            break;
+        }
+    }
+
+    /**
+     * @brief Remove the atoms that left the world through an open side
+     *
+     * @return the number of removed objects
+     */
+    uint64_t removeOutflow()
+    {
+        return removeIf([this](const PhysicObject& obj) {
+            return boundaries.hasLeft(obj.position, world_size);
+        });
+    }
+
+    /**
+     * @brief Reset the per thread accumulators, one per collision task
      * 
      */
-    void addObjectsToGrid()
+    void resetStatsAccumulators()
     {
-        grid.clear();
-        // Safety border to avoid adding object outside the grid
-        uint32_t i{0};
-        for (const PhysicObject& obj : objects.data) {
-            if (obj.position.x > 1.0f && obj.position.x < world_size.x - 1.0f &&
-                obj.position.y > 1.0f && obj.position.y < world_size.y - 1.0f) {
-                grid.addAtom(to<int32_t>(obj.position.x), to<int32_t>(obj.position.y), i);
+        if (!stats_enabled) {
+            return;
+        }
+        stats_accumulators.resize(thread_pool.getBatchCount());
+        for (StatsAccumulator& accumulator : stats_accumulators) {
+            accumulator.reset();
+        }
+    }
+
+    /**
+     * @brief Merge per thread accumulators into the stats of a sub step
+     * 
+     * @param sub_step_idx index of the sub step
+     * @param overflow number of objects dropped by full cells
+     */
+    void reduceSubStepStats(uint32_t sub_step_idx, uint64_t overflow)
+    {
+        StatsAccumulator total;
+        for (const StatsAccumulator& accumulator : stats_accumulators) {
+            total.merge(accumulator);
+        }
+        SubStepStats& sub_step     = stats.sub_steps[sub_step_idx];
+        sub_step.contacts_tested   = total.contacts_tested;
+        sub_step.contacts_resolved = total.contacts_resolved;
+        sub_step.max_penetration   = total.max_penetration;
+        sub_step.cell_overflow     = overflow;
+        stats.addSubStep(sub_step);
+    }
+
+    /**
+     * @brief Compute end of frame statistics: energy, velocity and cells occupancy
+     * 
+     * @param sub_dt sub step duration, used to compute velocities
+     */
+    void computeFrameStats(float sub_dt)
+    {
+        PROFILE_SCOPE("stats");
+        const uint32_t batch_count = thread_pool.getBatchCount();
+        ++stats.frame;
+        stats.objects_count = objects.size();
+        // Energy and velocity
+        stats_energy.assign(batch_count, 0.0);
+        stats_velocity.assign(batch_count, 0.0f);
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end) {
+            double energy       = 0.0;
+            float  max_velocity = 0.0f;
+            for (uint32_t i{start}; i < end; ++i) {
+                const PhysicObject& obj = objects.data[i];
+                const Vec2  v  = (obj.position - obj.last_position) / sub_dt;
+                const float v2 = v.x * v.x + v.y * v.y;
+                energy      += 0.5 * getObjectShape(i).mass * v2;
+                max_velocity = std::max(max_velocity, v2);
+            }
+            stats_energy[batch_idx]   = energy;
+            stats_velocity[batch_idx] = std::sqrt(max_velocity);
+        });
+        // Cells occupancy
+        occupancy_accumulators.assign(batch_count, {});
+        thread_pool.dispatchIndexed(to<uint32_t>(grid.data.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end) {
+            SolverStats::OccupancyHistogram histogram = {};
+            for (uint32_t i{start}; i < end; ++i) {
+                ++histogram[grid.data[i].objects_count];
+            }
+            occupancy_accumulators[batch_idx] = histogram;
+        });
+        for (uint32_t i{0}; i < batch_count; ++i) {
+            stats.kinetic_energy += stats_energy[i];
+            stats.max_velocity    = std::max(stats.max_velocity, stats_velocity[i]);
+            for (uint32_t k{0}; k < CollisionCell::cell_capacity; ++k) {
+                stats.cell_occupancy[k] += occupancy_accumulators[i][k];
             }
-            ++i;
         }
+        // Layout padding cells are not part of the world
+        stats.cell_occupancy[0] -= grid.data.size() - to<uint64_t>(grid.width) * grid.height;
+    }
+
+    /**
+     * @brief Add all objects to the grid
+     * 
+     * @return the number of objects dropped because their cell was full
+     */
+    uint64_t addObjectsToGrid()
+    {
+        PROFILE_SCOPE("grid_build");
+        if (!bins_valid) {
+            binObjects();
+        }
+        bins_valid = false;
+        // Fill grid stripes in parallel
+        const uint32_t stripe_count = grid_bins.stripe_count;
+        overflow_accumulators.assign(stripe_count, 0);
+        for (uint32_t i{0}; i < stripe_count; ++i) {
+            thread_pool.addTask(i, [this, i]{
+                overflow_accumulators[i] = grid_bins.buildStripe(grid, i);
+            });
+        }
+        thread_pool.waitForCompletion();
+        uint64_t overflow{0};
+        for (const uint64_t stripe_overflow : overflow_accumulators) {
+            overflow += stripe_overflow;
+        }
+        if (isVariableRadius()) {
+            multi_level_grid.gather();
+        }
+        return overflow;
+    }
+
+    /**
+     * @brief Sort objects by cell without integrating them, used when bins are not up to date
+     * 
+     */
+    void binObjects()
+    {
+        grid_bins.resize(thread_pool.getBatchCount(), thread_pool.m_thread_count, grid, boundaries);
+        if (!isVariableRadius()) {
+            thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end){
+                for (uint32_t i{start}; i < end; ++i) {
+                    grid_bins.add(batch_idx, i, objects.data[i].position);
+                }
+            });
+            return;
+        }
+        multi_level_grid.resetBatches(thread_pool.getBatchCount());
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end){
+            for (uint32_t i{start}; i < end; ++i) {
+                const PhysicObject& obj   = objects.data[i];
+                const AtomShape&    shape = shapes[i];
+                if (VariableRadius::isInGrid(shape)) {
+                    grid_bins.add(batch_idx, i, obj.position);
+                } else if (BoundaryConditions::isInside(obj.position, world_size)) {
+                    multi_level_grid.add(batch_idx, i, shape.radius);
+                }
+            }
+        });
     }
 
     /**
      * @brief Update all objects
      * 
      * @param dt time step
+     * @param bin_objects if true, objects are also sorted by cell for the next grid build
+     */
+    void updateObjects_multi(float dt, bool bin_objects)
+    {
+        PROFILE_SCOPE("integration");
+        if (bin_objects) {
+            grid_bins.resize(thread_pool.getBatchCount(), thread_pool.m_thread_count, grid, boundaries);
+            if (isVariableRadius()) {
+                multi_level_grid.resetBatches(thread_pool.getBatchCount());
+            }
+        }
+        bins_valid = bin_objects;
+        withRadiusModel([&](auto radius_model) {
+            integrateObjects<decltype(radius_model)>(dt, bin_objects);
+        });
+        for (RigidBody& body : bodies) {
+            body.update(dt, gravity);
+            body.applyBorders(world_size, TConfig::border_margin);
+        }
+    }
+
+    /**
+     * @brief Update all objects with a given radius model
+     * 
+     * @tparam TRadius radius model, see radius_model.hpp
+     * @param dt time step
+     * @param bin_objects if true, objects are also sorted by cell for the next grid build
      */
-    void updateObjects_multi(float dt)
+    template<typename TRadius>
+    void integrateObjects(float dt, bool bin_objects)
     {
-        thread_pool.dispatch(to<uint32_t>(objects.size()), [&](uint32_t start, uint32_t end){
+        displacement_accumulators.assign(thread_pool.getBatchCount(), 0.0f);
+        const bool track_displacement = usesNeighborList();
+        const bool collide_obstacles  = !obstacles.empty;
+        const bool apply_fields       = !force_fields.empty();
+        const bool walls_only         = boundaries.isDefault();
+        const bool open_side          = boundaries.hasOpenSide();
+        if (apply_fields) {
+            force_fields.update(world_size);
+        }
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end){
+            float max_displacement2 = 0.0f;
             for (uint32_t i{start}; i < end; ++i) {
                 PhysicObject& obj = objects.data[i];
+                // Atoms that left through an open side wait for their removal
+                if (open_side && boundaries.hasLeft(obj.position, world_size)) {
+                    continue;
+                }
                 // Add gravity
                 obj.acceleration += gravity;
+                // Contacts can push atoms slightly across a periodic side, out of the fields tiles
+                if (apply_fields && (walls_only || BoundaryConditions::isInside(obj.position, world_size))) {
+                    obj.acceleration += force_fields.getAcceleration(obj.position);
+                }
                 // Apply Verlet integration
-                obj.update(dt);
+                obj.update(dt, damping);
                 // Apply map borders collisions
-                const float margin = 2.0f;
-                if (obj.position.x > world_size.x - margin) {
-                    obj.position.x = world_size.x - margin;
-                } else if (obj.position.x < margin) {
-                    obj.position.x = margin;
+                const AtomShape& shape  = getShape<TRadius>(i);
+                const float      margin = TRadius::template getBorderMargin<TConfig>(shape);
+                if (walls_only) {
+                    TConfig::Boundary::apply(obj, world_size, margin);
+                } else if (!boundaries.template apply<typename TConfig::Boundary>(obj, world_size, margin)) {
+                    continue;
+                }
+                if (collide_obstacles) {
+                    obstacles.solveCollision(obj.position, TRadius::getRadius(shape));
                 }
-                if (obj.position.y > world_size.y - margin) {
-                    obj.position.y = world_size.y - margin;
-                } else if (obj.position.y < margin) {
-                    obj.position.y = margin;
+                // Sort by cell while the object is in cache
+                if (bin_objects) {
+                    if (TRadius::isInGrid(shape)) {
+                        grid_bins.add(batch_idx, i, obj.position);
+                    } else {
+                        multi_level_grid.add(batch_idx, i, shape.radius);
+                    }
+                }
+                // Track motion since the neighbor list build
+                if (track_displacement) {
+                    const Vec2 d = obj.position - neighbor_list.build_positions[i];
+                    max_displacement2 = std::max(max_displacement2, d.x * d.x + d.y * d.y);
                 }
             }
+            displacement_accumulators[batch_idx] = max_displacement2;
         });
+        for (const float displacement2 : displacement_accumulators) {
+            neighbor_list.max_displacement2 = std::max(neighbor_list.max_displacement2, displacement2);
+        }
+        force_fields.advance(dt);
     }
 };
+
+using PhysicSolver = BasicPhysicSolver<DefaultSolverConfig>;
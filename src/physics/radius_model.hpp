@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+
+#include "physic_object.hpp"
+
+/**
+ * @brief All atoms have a radius of 0.5 and the same mass
+ *
+ * Contact distance and border margin are constants, shapes are never read.
+ */
+struct UniformRadius
+{
+    static constexpr bool variable = false;
+
+    /**
+     * @brief Checks if two atoms are colliding and if so push them apart
+     *
+     * @tparam TConfig solver configuration, see solver_config.hpp
+     * @param obj_1 first atom
+     * @param obj_2 second atom
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TConfig, typename TStats>
+    static void solveContact(PhysicObject& obj_1, const AtomShape&, PhysicObject& obj_2, const AtomShape&, TStats& contact_stats)
+    {
+        using Float = typename TConfig::Float;
+        const Float dx    = static_cast<Float>(obj_1.position.x) - static_cast<Float>(obj_2.position.x);
+        const Float dy    = static_cast<Float>(obj_1.position.y) - static_cast<Float>(obj_2.position.y);
+        const Float dist2 = dx * dx + dy * dy;
+        contact_stats.addTested();
+        if (dist2 < Float{1} && dist2 > Float{TConfig::contact_eps}) {
+            const Float dist = std::sqrt(dist2);
+            contact_stats.addResolved(static_cast<float>(Float{1} - dist));
+            // Radius are all equal to 0.5f
+            const Float delta = Float{TConfig::response_coef} * Float{0.5} * (Float{1} - dist);
+            const Vec2 col_vec{static_cast<float>(dx / dist * delta), static_cast<float>(dy / dist * delta)};
+            obj_1.position += col_vec;
+            obj_2.position -= col_vec;
+        }
+    }
+
+    /**
+     * @brief Distance between an atom center and the world borders
+     */
+    template<typename TConfig>
+    static float getBorderMargin(const AtomShape&)
+    {
+        return TConfig::border_margin + 0.5f;
+    }
+
+    /**
+     * @brief Checks if an atom fits in the collision grid cells
+     */
+    static bool isInGrid(const AtomShape&)
+    {
+        return true;
+    }
+
+    static float getRadius(const AtomShape&)
+    {
+        return 0.5f;
+    }
+};
+
+/**
+ * @brief Atoms have their own radius and mass, read from their AtomShape
+ *
+ * Atoms with a radius up to 0.5 are stored in the collision grid, larger ones
+ * in the coarser levels of the MultiLevelGrid.
+ */
+struct VariableRadius
+{
+    static constexpr bool variable = true;
+
+    /**
+     * @brief Checks if two atoms are colliding and if so push them apart, lighter atoms move more
+     *
+     * @tparam TConfig solver configuration, see solver_config.hpp
+     * @param obj_1 first atom
+     * @param shape_1 shape of the first atom
+     * @param obj_2 second atom
+     * @param shape_2 shape of the second atom
+     * @param contact_stats statistics accumulator of the calling thread
+     */
+    template<typename TConfig, typename TStats>
+    static void solveContact(PhysicObject& obj_1, const AtomShape& shape_1, PhysicObject& obj_2, const AtomShape& shape_2, TStats& contact_stats)
+    {
+        using Float = typename TConfig::Float;
+        const Float dx       = static_cast<Float>(obj_1.position.x) - static_cast<Float>(obj_2.position.x);
+        const Float dy       = static_cast<Float>(obj_1.position.y) - static_cast<Float>(obj_2.position.y);
+        const Float dist2    = dx * dx + dy * dy;
+        const Float min_dist = static_cast<Float>(shape_1.radius) + static_cast<Float>(shape_2.radius);
+        contact_stats.addTested();
+        if (dist2 < min_dist * min_dist && dist2 > Float{TConfig::contact_eps}) {
+            const Float dist    = std::sqrt(dist2);
+            contact_stats.addResolved(static_cast<float>(min_dist - dist));
+            const Float ratio_1 = static_cast<Float>(shape_2.mass) / (static_cast<Float>(shape_1.mass) + static_cast<Float>(shape_2.mass));
+            const Float delta   = Float{TConfig::response_coef} * (min_dist - dist);
+            const Float col_x   = dx / dist * delta;
+            const Float col_y   = dy / dist * delta;
+            obj_1.position += Vec2{static_cast<float>(col_x * ratio_1), static_cast<float>(col_y * ratio_1)};
+            obj_2.position -= Vec2{static_cast<float>(col_x * (Float{1} - ratio_1)), static_cast<float>(col_y * (Float{1} - ratio_1))};
+        }
+    }
+
+    template<typename TConfig>
+    static float getBorderMargin(const AtomShape& shape)
+    {
+        return TConfig::border_margin + shape.radius;
+    }
+
+    static bool isInGrid(const AtomShape& shape)
+    {
+        return shape.radius <= 0.5f;
+    }
+
+    static float getRadius(const AtomShape& shape)
+    {
+        return shape.radius;
+    }
+};
+
+/**
+ * @brief Radius model selected at run time by BasicPhysicSolver::variable_radius
+ *
+ * Both kernels are compiled, the choice is made once per task and not per contact.
+ */
+struct RuntimeRadius
+{
+};
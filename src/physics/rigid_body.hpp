@@ -0,0 +1,330 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Circle or convex polygon body colliding with the atoms
+ *
+ * Dynamic bodies use Verlet integration like the atoms and receive position corrections from
+ * contacts. Kinematic bodies follow their velocity and angular velocity and are not affected.
+ * Bodies don't collide with each other.
+ */
+struct RigidBody
+{
+    enum class Shape : uint8_t
+    {
+        Circle,
+        Polygon
+    };
+
+    Shape             shape            = Shape::Circle;
+    bool              kinematic        = false;
+    Vec2              position         = {};
+    Vec2              last_position    = {};
+    float             angle            = 0.0f;
+    float             last_angle       = 0.0f;
+    // Kinematic bodies motion, in world units and radians per second
+    Vec2              velocity         = {};
+    float             angular_velocity = 0.0f;
+    float             inv_mass         = 0.0f;
+    float             inv_inertia      = 0.0f;
+    // Circle radius, or polygon bounding radius
+    float             radius           = 0.0f;
+    // Polygon vertices relative to the center of mass, and their current world position
+    std::vector<Vec2> local_points;
+    std::vector<Vec2> points;
+    // Outward normal of the edge starting at each point, in world space
+    std::vector<Vec2> normals;
+    Vec2              aabb_min         = {};
+    Vec2              aabb_max         = {};
+
+    /**
+     * @brief Create a circle body
+     *
+     * @param position_ center of the circle
+     * @param radius_ radius of the circle
+     * @param density mass per unit area, 0 for a kinematic body
+     */
+    static RigidBody makeCircle(Vec2 position_, float radius_, float density)
+    {
+        RigidBody body;
+        body.shape  = Shape::Circle;
+        body.radius = radius_;
+        body.setPosition(position_);
+        if (density > 0.0f) {
+            const float mass  = density * 3.14159265f * radius_ * radius_;
+            body.inv_mass     = 1.0f / mass;
+            body.inv_inertia  = 2.0f / (mass * radius_ * radius_);
+        }
+        body.kinematic = density <= 0.0f;
+        body.updateShape();
+        return body;
+    }
+
+    /**
+     * @brief Create a convex polygon body, vertices are recentered on the center of mass
+     *
+     * @param position_ position of the polygon origin
+     * @param points_ vertices relative to the origin, convex and in any winding order
+     * @param density mass per unit area, 0 for a kinematic body
+     */
+    static RigidBody makePolygon(Vec2 position_, const std::vector<Vec2>& points_, float density)
+    {
+        RigidBody body;
+        body.shape = Shape::Polygon;
+        // Area, centroid and inertia per unit density of the fan triangles
+        const auto count = to<uint32_t>(points_.size());
+        float area    = 0.0f;
+        Vec2  center  = {};
+        float inertia = 0.0f;
+        for (uint32_t i{0}; i < count; ++i) {
+            const Vec2  a = points_[i];
+            const Vec2  b = points_[(i + 1) % count];
+            const float c = a.x * b.y - a.y * b.x;
+            area    += 0.5f * c;
+            center  += (a + b) * (c / 6.0f);
+            inertia += c * (a.x * a.x + a.x * b.x + b.x * b.x + a.y * a.y + a.y * b.y + b.y * b.y) / 12.0f;
+        }
+        center /= area;
+        // Counter clockwise order in world space, y pointing down
+        body.local_points.resize(count);
+        for (uint32_t i{0}; i < count; ++i) {
+            body.local_points[area > 0.0f ? i : count - 1 - i] = points_[i] - center;
+        }
+        for (const Vec2 p : body.local_points) {
+            body.radius = std::max(body.radius, std::sqrt(p.x * p.x + p.y * p.y));
+        }
+        area    = std::abs(area);
+        // Parallel axis theorem, inertia about the centroid
+        inertia = std::abs(inertia) - area * (center.x * center.x + center.y * center.y);
+        if (density > 0.0f) {
+            body.inv_mass    = 1.0f / (density * area);
+            body.inv_inertia = 1.0f / (density * inertia);
+        }
+        body.kinematic = density <= 0.0f;
+        body.points.resize(count);
+        body.normals.resize(count);
+        body.setPosition(position_ + center);
+        body.updateShape();
+        return body;
+    }
+
+    /**
+     * @brief Teleport the body, its velocity is not changed for kinematic bodies and reset otherwise
+     */
+    void setPosition(Vec2 position_)
+    {
+        position      = position_;
+        last_position = position_;
+    }
+
+    /**
+     * @brief Update the world space points, normals and bounding box after a motion
+     *
+     */
+    void updateShape()
+    {
+        if (shape == Shape::Circle) {
+            aabb_min = position - Vec2{radius, radius};
+            aabb_max = position + Vec2{radius, radius};
+            return;
+        }
+        const float ca = std::cos(angle);
+        const float sa = std::sin(angle);
+        const auto count = to<uint32_t>(local_points.size());
+        aabb_min = aabb_max = position;
+        for (uint32_t i{0}; i < count; ++i) {
+            const Vec2 p = local_points[i];
+            points[i] = position + Vec2{p.x * ca - p.y * sa, p.x * sa + p.y * ca};
+            aabb_min  = {std::min(aabb_min.x, points[i].x), std::min(aabb_min.y, points[i].y)};
+            aabb_max  = {std::max(aabb_max.x, points[i].x), std::max(aabb_max.y, points[i].y)};
+        }
+        for (uint32_t i{0}; i < count; ++i) {
+            const Vec2  e = points[(i + 1) % count] - points[i];
+            const float l = std::sqrt(e.x * e.x + e.y * e.y);
+            // Counter clockwise with y down, the outward normal is on the left of the edge
+            normals[i] = Vec2{e.y, -e.x} / l;
+        }
+    }
+
+    /**
+     * @brief Signed distance from a point to the body surface
+     *
+     * @param p the point
+     * @param normal receives the outward surface normal closest to the point
+     * @return the distance, negative inside the body
+     */
+    float getDistance(Vec2 p, Vec2& normal) const
+    {
+        if (shape == Shape::Circle) {
+            const Vec2  v    = p - position;
+            const float dist = std::sqrt(v.x * v.x + v.y * v.y);
+            normal = dist > 0.0f ? v / dist : Vec2{0.0f, -1.0f};
+            return dist - radius;
+        }
+        const auto count = to<uint32_t>(points.size());
+        // Inside, the closest edge is the one with the largest plane distance
+        float    max_plane = -1e9f;
+        uint32_t max_edge  = 0;
+        for (uint32_t i{0}; i < count; ++i) {
+            const Vec2  v = p - points[i];
+            const float d = v.x * normals[i].x + v.y * normals[i].y;
+            if (d > max_plane) {
+                max_plane = d;
+                max_edge  = i;
+            }
+        }
+        if (max_plane <= 0.0f) {
+            normal = normals[max_edge];
+            return max_plane;
+        }
+        // Outside, closest point of the edges
+        float min_dist2 = 1e18f;
+        for (uint32_t i{0}; i < count; ++i) {
+            const Vec2  a   = points[i];
+            const Vec2  ab  = points[(i + 1) % count] - a;
+            const Vec2  ap  = p - a;
+            const float t   = std::min(std::max((ap.x * ab.x + ap.y * ab.y) / (ab.x * ab.x + ab.y * ab.y), 0.0f), 1.0f);
+            const Vec2  v   = ap - ab * t;
+            const float d2  = v.x * v.x + v.y * v.y;
+            if (d2 < min_dist2) {
+                min_dist2 = d2;
+                normal    = v;
+            }
+        }
+        const float dist = std::sqrt(min_dist2);
+        normal /= dist;
+        return dist;
+    }
+
+    /**
+     * @brief Advance the body
+     *
+     * @param dt time step
+     * @param gravity gravity applied to dynamic bodies
+     */
+    void update(float dt, Vec2 gravity)
+    {
+        if (kinematic) {
+            last_position = position;
+            last_angle    = angle;
+            position     += velocity * dt;
+            angle        += angular_velocity * dt;
+        } else {
+            const Vec2  move       = position - last_position;
+            const float angle_move = angle - last_angle;
+            last_position = position;
+            last_angle    = angle;
+            position     += move + gravity * (dt * dt);
+            angle        += angle_move;
+        }
+        updateShape();
+    }
+
+    /**
+     * @brief Keep the body inside the world, only its bounding box is considered
+     *
+     * @param world_size size of the world
+     * @param margin distance to the world borders
+     */
+    void applyBorders(Vec2 world_size, float margin)
+    {
+        Vec2 shift = {};
+        shift.x = std::max(margin - aabb_min.x, 0.0f) + std::min(world_size.x - margin - aabb_max.x, 0.0f);
+        shift.y = std::max(margin - aabb_min.y, 0.0f) + std::min(world_size.y - margin - aabb_max.y, 0.0f);
+        if (shift.x != 0.0f || shift.y != 0.0f) {
+            position += shift;
+            updateShape();
+        }
+    }
+};
+
+/**
+ * @brief Position correction received by a body from its contacts, accumulated per thread
+ */
+struct BodyCorrection
+{
+    Vec2  translation = {};
+    float rotation    = 0.0f;
+};
+
+/**
+ * @brief Bodies overlapping each cell of the collision grid, in CSR form over the touched cells only
+ *
+ * Bodies of touched_cells[i] are bodies[offsets[i]] to bodies[offsets[i + 1]]
+ */
+struct BodyCells
+{
+    std::vector<uint32_t> touched_cells;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> bodies;
+    // Slot of each grid cell in touched_cells, -1 if untouched
+    std::vector<int32_t>  cell_slots;
+
+    /**
+     * @brief Rasterize the bodies bounding boxes
+     *
+     * @param grid collision grid, only used for its size and layout
+     * @param body_list bodies, their shape must be up to date
+     * @param margin atoms radius
+     */
+    template<typename TGrid>
+    void build(const TGrid& grid, const std::vector<RigidBody>& body_list, float margin)
+    {
+        cell_slots.resize(grid.data.size(), -1);
+        for (const uint32_t cell : touched_cells) {
+            cell_slots[cell] = -1;
+        }
+        touched_cells.clear();
+        offsets.clear();
+        const auto body_count = to<uint32_t>(body_list.size());
+        // Count bodies per cell, then fill
+        for (uint32_t pass{0}; pass < 2; ++pass) {
+            for (uint32_t b{0}; b < body_count; ++b) {
+                const RigidBody& body = body_list[b];
+                // Atoms are only stored between 1 and size - 2
+                const int32_t x_min = std::max(to<int32_t>(body.aabb_min.x - margin), 1);
+                const int32_t x_max = std::min(to<int32_t>(body.aabb_max.x + margin), grid.width - 2);
+                const int32_t y_min = std::max(to<int32_t>(body.aabb_min.y - margin), 1);
+                const int32_t y_max = std::min(to<int32_t>(body.aabb_max.y + margin), grid.height - 2);
+                for (int32_t x{x_min}; x <= x_max; ++x) {
+                    for (int32_t y{y_min}; y <= y_max; ++y) {
+                        const uint32_t cell = grid.layout.getIndex(x, y);
+                        if (pass == 0) {
+                            if (cell_slots[cell] < 0) {
+                                cell_slots[cell] = to<int32_t>(touched_cells.size());
+                                touched_cells.push_back(cell);
+                                offsets.push_back(0);
+                            }
+                            ++offsets[cell_slots[cell]];
+                        } else {
+                            bodies[offsets[cell_slots[cell]]++] = b;
+                        }
+                    }
+                }
+            }
+            if (pass == 0) {
+                // Exclusive prefix sum, offsets are used as insertion cursors in the second pass
+                uint32_t sum = 0;
+                for (uint32_t& offset : offsets) {
+                    const uint32_t count = offset;
+                    offset = sum;
+                    sum   += count;
+                }
+                offsets.push_back(sum);
+                bodies.resize(sum);
+            }
+        }
+        // Cursors now point to the start of the next cell
+        for (uint32_t i{to<uint32_t>(offsets.size()) - 1}; i > 0; --i) {
+            offsets[i] = offsets[i - 1];
+        }
+        offsets[0] = 0;
+    }
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+#include "emitter.hpp"
+#include "force_field.hpp"
+#include "rigid_body.hpp"
+#include "solver_config.hpp"
+#include "engine/common/vec.hpp"
+#include "engine/common/spsc_queue.hpp"
+
+/**
+ * @brief Change of the solver state requested by the input thread, applied by the solver at a sub step boundary
+ *
+ * Built with the make functions, only the payload member matching the type is set. Commands are
+ * trivially copyable so the queue slots stay small, bodies go through SolverCommandQueue::pushBody.
+ */
+struct SolverCommand
+{
+    enum class Type : uint8_t
+    {
+        // Default constructed commands, ignored
+        None,
+        // Single atom, see Spawn
+        Spawn,
+        // Line of atoms created at once, see Emit
+        Emit,
+        AddForceField,
+        // Takes the next body of the queue bodies
+        AddBody,
+        ClearBodies,
+        AddObstacleSegment,
+        AddObstacleCircle,
+        ClearObstacles,
+        SetGravity,
+        SetBoundaries,
+        TogglePause,
+        ToggleNeighborList,
+        ToggleFluid,
+        ToggleStats
+    };
+
+    // Atom moving by velocity per sub step
+    struct Spawn
+    {
+        Vec2    position;
+        Vec2    velocity;
+        float   radius;
+        uint8_t color;
+    };
+
+    // Atoms of a line moving by velocity per sub step, created while there are less than max_objects atoms
+    struct Emit
+    {
+        emitter::Line line;
+        Vec2          velocity;
+        uint32_t      max_objects;
+        uint8_t       color;
+    };
+
+    struct Segment
+    {
+        Vec2  start;
+        Vec2  end;
+        float thickness;
+    };
+
+    struct Circle
+    {
+        Vec2  center;
+        float radius;
+    };
+
+    union Payload
+    {
+        // Active member of the commands without payload
+        uint8_t            none;
+        Spawn              spawn;
+        Emit               emit;
+        ForceField         force_field;
+        Segment            segment;
+        Circle             circle;
+        Vec2               gravity;
+        BoundaryConditions boundaries;
+
+        Payload()
+            : none{0}
+        {}
+    };
+
+    Type    type = Type::None;
+    Payload payload;
+
+    static SolverCommand make(Type type_)
+    {
+        SolverCommand command;
+        command.type = type_;
+        return command;
+    }
+
+    static SolverCommand makeSpawn(Vec2 position_, float radius_, uint8_t color_, Vec2 velocity_ = {})
+    {
+        SolverCommand command = make(Type::Spawn);
+        command.payload.spawn = {position_, velocity_, radius_, color_};
+        return command;
+    }
+
+    static SolverCommand makeEmit(const emitter::Line& line, Vec2 velocity, uint8_t color_, uint32_t max_objects)
+    {
+        SolverCommand command = make(Type::Emit);
+        command.payload.emit = {line, velocity, max_objects, color_};
+        return command;
+    }
+
+    static SolverCommand makeForceField(const ForceField& field)
+    {
+        SolverCommand command = make(Type::AddForceField);
+        command.payload.force_field = field;
+        return command;
+    }
+
+    static SolverCommand makeObstacleSegment(Vec2 start, Vec2 end, float thickness)
+    {
+        SolverCommand command = make(Type::AddObstacleSegment);
+        command.payload.segment = {start, end, thickness};
+        return command;
+    }
+
+    static SolverCommand makeObstacleCircle(Vec2 center, float radius_)
+    {
+        SolverCommand command = make(Type::AddObstacleCircle);
+        command.payload.circle = {center, radius_};
+        return command;
+    }
+
+    static SolverCommand makeGravity(Vec2 gravity)
+    {
+        SolverCommand command = make(Type::SetGravity);
+        command.payload.gravity = gravity;
+        return command;
+    }
+
+    static SolverCommand makeBoundaries(BoundaryConditions boundaries_)
+    {
+        SolverCommand command = make(Type::SetBoundaries);
+        command.payload.boundaries = boundaries_;
+        return command;
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<SolverCommand>, "Commands are copied in and out of the queue slots");
+
+/**
+ * @brief Commands pushed by the input thread between two solver updates
+ *
+ * Bodies own their vertices, they wait in a smaller queue of their own and their AddBody command
+ * takes them in order.
+ */
+struct SolverCommandQueue
+{
+    static constexpr uint32_t capacity      = 256;
+    static constexpr uint32_t body_capacity = 16;
+
+    civ::SPSCQueue<SolverCommand, capacity>  commands;
+    civ::SPSCQueue<RigidBody, body_capacity> bodies;
+
+    /**
+     * @brief Add a command, only called by the input thread
+     *
+     * @return false if the queue is full and the command dropped
+     */
+    bool push(const SolverCommand& command)
+    {
+        return commands.push(command);
+    }
+
+    /**
+     * @brief Add a body and its AddBody command, only called by the input thread
+     *
+     * @return false if one of the queues is full, nothing is added
+     */
+    bool pushBody(RigidBody body)
+    {
+        // The solver only frees slots, a command queue with room now still has room after the body is added
+        if (commands.size() >= capacity || !bodies.push(std::move(body))) {
+            return false;
+        }
+        return commands.push(SolverCommand::make(SolverCommand::Type::AddBody));
+    }
+
+    /**
+     * @brief Remove the oldest command, only called by the solver
+     */
+    bool pop(SolverCommand& command)
+    {
+        return commands.pop(command);
+    }
+
+    /**
+     * @brief Remove the body of an AddBody command, only called by the solver
+     */
+    bool popBody(RigidBody& body)
+    {
+        return bodies.pop(body);
+    }
+};
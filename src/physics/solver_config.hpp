@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "radius_model.hpp"
+#include "physic_object.hpp"
+#include "engine/common/grid.hpp"
+
+/**
+ * @brief Velocity damping proportional to the last displacement, approximating air friction
+ */
+struct AirDamping
+{
+    float coefficient = 40.0f;
+
+    [[nodiscard]]
+    Vec2 getAcceleration(Vec2 last_update_move) const
+    {
+        return -last_update_move * coefficient;
+    }
+};
+
+/**
+ * @brief No velocity damping, the energy is only lost in contacts
+ */
+struct NoDamping
+{
+    [[nodiscard]]
+    Vec2 getAcceleration(Vec2) const
+    {
+        return {};
+    }
+};
+
+/**
+ * @brief Atoms leaving the world are put back on its border, keeping their velocity along it
+ */
+struct ClampBoundary
+{
+    /**
+     * @brief Apply the world borders to an atom
+     *
+     * @param obj the atom
+     * @param world_size size of the world
+     * @param margin distance between the atom center and the borders
+     */
+    static void apply(PhysicObject& obj, Vec2 world_size, float margin)
+    {
+        applyAxis(obj.position.x, obj.last_position.x, margin, world_size.x - margin);
+        applyAxis(obj.position.y, obj.last_position.y, margin, world_size.y - margin);
+    }
+
+    /**
+     * @brief Apply the borders of one axis
+     *
+     * @param position coordinate of the atom position
+     * @param last_position coordinate of the atom last position, unchanged
+     * @param min lowest coordinate of the atom center
+     * @param max highest coordinate of the atom center
+     */
+    static void applyAxis(float& position, float&, float min, float max)
+    {
+        if (position > max) {
+            position = max;
+        } else if (position < min) {
+            position = min;
+        }
+    }
+};
+
+/**
+ * @brief Atoms leaving the world are put back on its border and bounce off it
+ */
+struct ReflectBoundary
+{
+    static void apply(PhysicObject& obj, Vec2 world_size, float margin)
+    {
+        applyAxis(obj.position.x, obj.last_position.x, margin, world_size.x - margin);
+        applyAxis(obj.position.y, obj.last_position.y, margin, world_size.y - margin);
+    }
+
+    /**
+     * @brief Mirror the position and the last position of an atom on one axis
+     */
+    static void applyAxis(float& position, float& last_position, float min, float max)
+    {
+        if (position > max) {
+            last_position = 2.0f * max - last_position;
+            position      = 2.0f * max - position;
+        } else if (position < min) {
+            last_position = 2.0f * min - last_position;
+            position      = 2.0f * min - position;
+        }
+    }
+};
+
+/**
+ * @brief Behavior of the world sides along one axis
+ */
+enum class BoundaryMode : uint8_t
+{
+    // Atoms are kept inside by the configuration boundary policy
+    Wall,
+    // Atoms leaving one side enter from the opposite one, contacts are solved across the sides
+    Periodic,
+    // Atoms leaving the world are removed at the end of the update
+    Open
+};
+
+/**
+ * @brief Boundary mode of each axis, selected at run time
+ *
+ * Walls use the configuration boundary policy. Only atoms are affected, bodies stay inside the walls.
+ */
+struct BoundaryConditions
+{
+    BoundaryMode x = BoundaryMode::Wall;
+    BoundaryMode y = BoundaryMode::Wall;
+
+    [[nodiscard]]
+    bool isDefault() const
+    {
+        return x == BoundaryMode::Wall && y == BoundaryMode::Wall;
+    }
+
+    [[nodiscard]]
+    bool hasOpenSide() const
+    {
+        return x == BoundaryMode::Open || y == BoundaryMode::Open;
+    }
+
+    /**
+     * @brief Apply the boundaries to an atom after its integration
+     *
+     * @tparam TBoundary wall policy
+     * @param obj the atom
+     * @param world_size size of the world
+     * @param margin distance between the atom center and the walls
+     * @return false if the atom left the world through an open side
+     */
+    template<typename TBoundary>
+    bool apply(PhysicObject& obj, Vec2 world_size, float margin) const
+    {
+        const bool inside_x = applyAxis<TBoundary>(x, obj.position.x, obj.last_position.x, world_size.x, margin);
+        const bool inside_y = applyAxis<TBoundary>(y, obj.position.y, obj.last_position.y, world_size.y, margin);
+        return inside_x && inside_y;
+    }
+
+    /**
+     * @brief Checks if a position is inside the world
+     */
+    static bool isInside(Vec2 position, Vec2 world_size)
+    {
+        return position.x >= 0.0f && position.x < world_size.x && position.y >= 0.0f && position.y < world_size.y;
+    }
+
+    /**
+     * @brief Checks if a position is past an open side, other axes are ignored since
+     * contacts can push atoms slightly across a periodic side before they are wrapped
+     */
+    [[nodiscard]]
+    bool hasLeft(Vec2 position, Vec2 world_size) const
+    {
+        const bool left_x = x == BoundaryMode::Open && (position.x < 0.0f || position.x >= world_size.x);
+        const bool left_y = y == BoundaryMode::Open && (position.y < 0.0f || position.y >= world_size.y);
+        return left_x || left_y;
+    }
+
+private:
+    template<typename TBoundary>
+    static bool applyAxis(BoundaryMode mode, float& position, float& last_position, float size, float margin)
+    {
+        if (mode == BoundaryMode::Wall) {
+            TBoundary::applyAxis(position, last_position, margin, size - margin);
+        } else if (mode == BoundaryMode::Periodic) {
+            // Both positions are moved so the velocity is kept
+            const float shift = position >= size ? -size : (position < 0.0f ? size : 0.0f);
+            position      += shift;
+            last_position += shift;
+            // A tiny negative coordinate rounds to size once shifted
+            position = std::min(position, std::nextafter(size, 0.0f));
+        } else {
+            return position >= 0.0f && position < size;
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief Compile time configuration of a BasicPhysicSolver
+ *
+ * Each combination of policies is compiled to its own kernels without run time branches.
+ *
+ * @tparam TRadius radius model: UniformRadius, VariableRadius or RuntimeRadius, see radius_model.hpp
+ * @tparam TDamping damping model, its coefficients are set at run time through BasicPhysicSolver::damping
+ * @tparam TBoundary world borders model
+ * @tparam TFloat type used for the contact kernels math, positions are always stored as float
+ * @tparam TLayout memory layout of the collision grid cells, defines the stencil traversal order
+ */
+template<typename TRadius   = RuntimeRadius,
+         typename TDamping  = AirDamping,
+         typename TBoundary = ClampBoundary,
+         typename TFloat    = float,
+         typename TLayout   = ColumnMajorLayout>
+struct SolverConfig
+{
+    using Radius   = TRadius;
+    using Damping  = TDamping;
+    using Boundary = TBoundary;
+    using Float    = TFloat;
+    using Layout   = TLayout;
+
+    static constexpr float    response_coef = 1.0f;
+    static constexpr float    contact_eps   = 0.0001f;
+    // Distance between the atoms edge and the world borders
+    static constexpr float    border_margin = 1.5f;
+    // Initial value of BasicPhysicSolver::sub_steps
+    static constexpr uint32_t sub_steps     = 8;
+};
+
+using DefaultSolverConfig = SolverConfig<>;
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+#include "physics.hpp"
+#include "compact_solver.hpp"
+
+/**
+ * @brief Solver with its configuration erased, used to pick an instantiation at run time
+ *
+ * Only whole steps go through virtual calls, the kernels stay specialized.
+ */
+struct SolverInterface
+{
+    virtual ~SolverInterface() = default;
+
+    virtual void                update(float dt) = 0;
+    virtual uint64_t            createObjects(const Vec2* positions, const Vec2* velocities, const uint8_t* colors, uint32_t count) = 0;
+    virtual uint64_t            removeInRegion(Vec2 region_min, Vec2 region_max) = 0;
+    [[nodiscard]]
+    virtual uint64_t            getObjectsCount() const = 0;
+    // Objects in data order, valid until the next creation or removal
+    [[nodiscard]]
+    virtual const PhysicObject* getObjects() const = 0;
+    virtual void                setSubSteps(uint32_t sub_steps) = 0;
+    virtual void                setGravity(Vec2 gravity) = 0;
+    // Ignored by configurations without damping coefficient
+    virtual void                setDamping(float coefficient) = 0;
+    // Returns false if the solver does not support the modes, its boundaries are left unchanged
+    virtual bool                setBoundaries(BoundaryConditions boundaries) = 0;
+    virtual void                setStatsEnabled(bool enabled) = 0;
+    [[nodiscard]]
+    virtual const SolverStats&  getStats() const = 0;
+};
+
+/**
+ * @brief SolverInterface implementation for a given configuration
+ *
+ * @tparam TConfig solver configuration, see solver_config.hpp
+ */
+template<typename TConfig>
+struct SolverInstance : public SolverInterface
+{
+    BasicPhysicSolver<TConfig> solver;
+
+    SolverInstance(IVec2 size, tp::ThreadPool& tp)
+        : solver{size, tp}
+    {}
+
+    void update(float dt) override
+    {
+        solver.update(dt);
+    }
+
+    uint64_t createObjects(const Vec2* positions, const Vec2* velocities, const uint8_t* colors, uint32_t count) override
+    {
+        return solver.createObjects(positions, velocities, colors, count);
+    }
+
+    uint64_t removeInRegion(Vec2 region_min, Vec2 region_max) override
+    {
+        return solver.removeInRegion(region_min, region_max);
+    }
+
+    [[nodiscard]]
+    uint64_t getObjectsCount() const override
+    {
+        return solver.objects.size();
+    }
+
+    [[nodiscard]]
+    const PhysicObject* getObjects() const override
+    {
+        return solver.objects.data.data();
+    }
+
+    void setSubSteps(uint32_t sub_steps) override
+    {
+        solver.sub_steps = sub_steps;
+    }
+
+    void setGravity(Vec2 gravity) override
+    {
+        solver.gravity = gravity;
+    }
+
+    void setDamping(float coefficient) override
+    {
+        if constexpr (std::is_same_v<typename TConfig::Damping, AirDamping>) {
+            solver.damping.coefficient = coefficient;
+        } else {
+            (void)coefficient;
+        }
+    }
+
+    bool setBoundaries(BoundaryConditions boundaries) override
+    {
+        solver.boundaries = boundaries;
+        return true;
+    }
+
+    void setStatsEnabled(bool enabled) override
+    {
+        solver.stats_enabled = enabled;
+    }
+
+    [[nodiscard]]
+    const SolverStats& getStats() const override
+    {
+        return solver.stats;
+    }
+};
+
+/**
+ * @brief SolverInterface implementation for a CompactPhysicSolver
+ *
+ * Objects are decoded on each getObjects call. Boundary modes are not supported, sides are walls.
+ *
+ * @tparam TConfig solver configuration, see solver_config.hpp
+ */
+template<typename TConfig>
+struct CompactSolverInstance : public SolverInterface
+{
+    CompactPhysicSolver<TConfig>      solver;
+    mutable std::vector<PhysicObject> decoded;
+
+    CompactSolverInstance(IVec2 size, tp::ThreadPool& tp)
+        : solver{size, tp}
+    {}
+
+    void update(float dt) override
+    {
+        solver.update(dt);
+    }
+
+    uint64_t createObjects(const Vec2* positions, const Vec2* velocities, const uint8_t* colors, uint32_t count) override
+    {
+        return solver.createObjects(positions, velocities, colors, count);
+    }
+
+    uint64_t removeInRegion(Vec2 region_min, Vec2 region_max) override
+    {
+        return solver.removeInRegion(region_min, region_max);
+    }
+
+    [[nodiscard]]
+    uint64_t getObjectsCount() const override
+    {
+        return solver.getObjectsCount();
+    }
+
+    [[nodiscard]]
+    const PhysicObject* getObjects() const override
+    {
+        solver.decode(decoded);
+        return decoded.data();
+    }
+
+    void setSubSteps(uint32_t sub_steps) override
+    {
+        solver.sub_steps = sub_steps;
+    }
+
+    void setGravity(Vec2 gravity) override
+    {
+        solver.gravity = gravity;
+    }
+
+    void setDamping(float coefficient) override
+    {
+        if constexpr (std::is_same_v<typename TConfig::Damping, AirDamping>) {
+            solver.damping.coefficient = coefficient;
+        } else {
+            (void)coefficient;
+        }
+    }
+
+    bool setBoundaries(BoundaryConditions boundaries) override
+    {
+        return boundaries.x == BoundaryMode::Wall && boundaries.y == BoundaryMode::Wall;
+    }
+
+    void setStatsEnabled(bool enabled) override
+    {
+        solver.stats_enabled = enabled;
+    }
+
+    [[nodiscard]]
+    const SolverStats& getStats() const override
+    {
+        return solver.stats;
+    }
+};
+
+/**
+ * @brief Named solver instantiations available at run time
+ */
+struct SolverRegistry
+{
+    using Factory = std::unique_ptr<SolverInterface>(*)(IVec2, tp::ThreadPool&);
+
+    struct Entry
+    {
+        const char* name;
+        const char* description;
+        Factory     create;
+    };
+
+    /**
+     * @brief All the registered instantiations, the first one is the default PhysicSolver
+     */
+    static const std::vector<Entry>& getEntries()
+    {
+        static const std::vector<Entry> entries{
+            {"default"       , "radius model selected at run time"            , &createInstance<DefaultSolverConfig>},
+            {"uniform"       , "single radius"                                , &createInstance<SolverConfig<UniformRadius>>},
+            {"variable"      , "per atom radius and mass"                     , &createInstance<SolverConfig<VariableRadius>>},
+            {"uniform_tiled" , "single radius, tiled grid layout"             , &createInstance<SolverConfig<UniformRadius, AirDamping, ClampBoundary, float, TiledLayout<3>>>},
+            {"uniform_double", "single radius, double precision contacts"     , &createInstance<SolverConfig<UniformRadius, AirDamping, ClampBoundary, double>>},
+            {"uniform_bounce", "single radius, no damping, reflective borders", &createInstance<SolverConfig<UniformRadius, NoDamping, ReflectBoundary>>},
+            {"compact"       , "single radius, quantized atoms sorted by cell", &createCompactInstance<SolverConfig<UniformRadius>>},
+        };
+        return entries;
+    }
+
+    /**
+     * @brief Create a solver from its registered name
+     *
+     * @param name name of the instantiation
+     * @param size size of the world
+     * @param tp thread pool to use
+     * @return the solver, or null if the name is unknown
+     */
+    static std::unique_ptr<SolverInterface> create(const std::string& name, IVec2 size, tp::ThreadPool& tp)
+    {
+        for (const Entry& entry : getEntries()) {
+            if (name == entry.name) {
+                return entry.create(size, tp);
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    template<typename TConfig>
+    static std::unique_ptr<SolverInterface> createInstance(IVec2 size, tp::ThreadPool& tp)
+    {
+        return std::make_unique<SolverInstance<TConfig>>(size, tp);
+    }
+
+    template<typename TConfig>
+    static std::unique_ptr<SolverInterface> createCompactInstance(IVec2 size, tp::ThreadPool& tp)
+    {
+        return std::make_unique<CompactSolverInstance<TConfig>>(size, tp);
+    }
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+
+#include "collision_grid.hpp"
+
+/**
+ * @brief Collision statistics accumulator, one instance per thread
+ *
+ * Aligned on a cache line so concurrent accumulators don't share one.
+ */
+struct alignas(64) StatsAccumulator
+{
+    uint64_t contacts_tested   = 0;
+    uint64_t contacts_resolved = 0;
+    float    max_penetration   = 0.0f;
+
+    void addTested()
+    {
+        ++contacts_tested;
+    }
+
+    void addResolved(float penetration)
+    {
+        ++contacts_resolved;
+        max_penetration = std::max(max_penetration, penetration);
+    }
+
+    void reset()
+    {
+        *this = StatsAccumulator{};
+    }
+
+    void merge(const StatsAccumulator& other)
+    {
+        contacts_tested   += other.contacts_tested;
+        contacts_resolved += other.contacts_resolved;
+        max_penetration    = std::max(max_penetration, other.max_penetration);
+    }
+};
+
+/**
+ * @brief Accumulator used when statistics are disabled, compiles to nothing
+ */
+struct NoStats
+{
+    void addTested() {}
+    void addResolved(float) {}
+};
+
+/**
+ * @brief Statistics of a single sub step
+ */
+struct SubStepStats
+{
+    uint64_t contacts_tested   = 0;
+    uint64_t contacts_resolved = 0;
+    float    max_penetration   = 0.0f;
+    uint64_t cell_overflow     = 0;
+};
+
+/**
+ * @brief Statistics of a frame, reduced at the end of PhysicSolver::update
+ */
+struct SolverStats
+{
+    using OccupancyHistogram = std::array<uint64_t, CollisionCell::cell_capacity>;
+
+    uint64_t                  frame             = 0;
+    uint64_t                  objects_count     = 0;
+    uint64_t                  contacts_tested   = 0;
+    uint64_t                  contacts_resolved = 0;
+    float                     max_penetration   = 0.0f;
+    uint64_t                  cell_overflow     = 0;
+    double                    kinetic_energy    = 0.0;
+    float                     max_velocity      = 0.0f;
+    // Number of cells for each objects count, measured on the last sub step grid
+    OccupancyHistogram        cell_occupancy    = {};
+    std::vector<SubStepStats> sub_steps;
+
+    /**
+     * @brief Reset the frame totals
+     *
+     * @param sub_steps_count number of sub steps in the frame
+     */
+    void reset(uint32_t sub_steps_count)
+    {
+        contacts_tested   = 0;
+        contacts_resolved = 0;
+        max_penetration   = 0.0f;
+        cell_overflow     = 0;
+        kinetic_energy    = 0.0;
+        max_velocity      = 0.0f;
+        cell_occupancy    = {};
+        sub_steps.assign(sub_steps_count, {});
+    }
+
+    /**
+     * @brief Add a sub step to the frame totals
+     *
+     * @param sub_step sub step statistics
+     */
+    void addSubStep(const SubStepStats& sub_step)
+    {
+        contacts_tested   += sub_step.contacts_tested;
+        contacts_resolved += sub_step.contacts_resolved;
+        max_penetration    = std::max(max_penetration, sub_step.max_penetration);
+        cell_overflow     += sub_step.cell_overflow;
+    }
+
+    /**
+     * @brief Write the CSV header matching writeCSV
+     *
+     * @param stream output stream
+     */
+    static void writeCSVHeader(std::ostream& stream)
+    {
+        stream << "frame,objects,contacts_tested,contacts_resolved,max_penetration,cell_overflow,kinetic_energy,max_velocity";
+        for (uint32_t i{0}; i < CollisionCell::cell_capacity; ++i) {
+            stream << ",cells_with_" << i;
+        }
+        stream << "\n";
+    }
+
+    /**
+     * @brief Write the frame totals as a CSV line
+     *
+     * @param stream output stream
+     */
+    void writeCSV(std::ostream& stream) const
+    {
+        stream << frame << ","
+               << objects_count << ","
+               << contacts_tested << ","
+               << contacts_resolved << ","
+               << max_penetration << ","
+               << cell_overflow << ","
+               << kinetic_energy << ","
+               << max_velocity;
+        for (const uint64_t count : cell_occupancy) {
+            stream << "," << count;
+        }
+        stream << "\n";
+    }
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "collision_grid.hpp"
+#include "physic_object.hpp"
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+
+/**
+ * @brief Atoms whose center is inside a disc
+ *
+ * Found atoms data indices are written to results, up to capacity. count receives the number
+ * of atoms found, it can exceed capacity when results were truncated.
+ */
+struct RadiusQuery
+{
+    Vec2      center   = {};
+    float     radius   = 0.0f;
+    uint32_t* results  = nullptr;
+    uint32_t  capacity = 0;
+    uint32_t  count    = 0;
+};
+
+/**
+ * @brief Atoms whose center is inside an axis aligned box, results are stored like RadiusQuery
+ */
+struct BoxQuery
+{
+    Vec2      box_min  = {};
+    Vec2      box_max  = {};
+    uint32_t* results  = nullptr;
+    uint32_t  capacity = 0;
+    uint32_t  count    = 0;
+};
+
+/**
+ * @brief The k atoms closest to a point
+ *
+ * results and distances2 must hold k values, they receive the atoms data indices and their squared
+ * distance sorted from the closest. count receives the number of atoms found, at most k.
+ */
+struct NearestQuery
+{
+    Vec2      center     = {};
+    // Atoms further than this are ignored
+    float     max_radius = 0.0f;
+    uint32_t  k          = 0;
+    uint32_t* results    = nullptr;
+    float*    distances2 = nullptr;
+    uint32_t  count      = 0;
+};
+
+/**
+ * @brief First atom hit by a ray
+ */
+struct RaycastQuery
+{
+    Vec2     origin       = {};
+    // Does not need to be normalized
+    Vec2     direction    = {};
+    float    max_distance = 0.0f;
+    bool     hit          = false;
+    uint32_t atom         = 0;
+    float    distance     = 0.0f;
+};
+
+/**
+ * @brief Read only queries over the collision grid as left by the last sub step
+ *
+ * Atoms moved a little since the grid was built, cells are searched with a margin and
+ * candidates are tested against their current position. Atoms created since the last
+ * update and atoms stored in the coarse grid levels are not found. Removals swap atoms in
+ * the freed indices, so after BasicPhysicSolver::removeIf and until the next sub step the
+ * cell of a removed atom leads to the atom moved in its index: results can hold an atom
+ * twice. Run queries right after update to avoid it.
+ */
+template<typename TGrid>
+struct GridQuery
+{
+    // Maximum motion of an atom since the grid build, atoms move by a fraction of their radius per sub step
+    static constexpr float drift_margin = 0.5f;
+
+    const TGrid&        grid;
+    const PhysicObject* objects;
+    uint32_t            objects_count;
+    // Null with a single radius, atoms past shapes_count have the default shape
+    const AtomShape*    shapes;
+    uint32_t            shapes_count;
+
+    void query(RadiusQuery& q) const
+    {
+        const float radius2 = q.radius * q.radius;
+        q.count = 0;
+        forEachCandidate(q.center - Vec2{q.radius, q.radius}, q.center + Vec2{q.radius, q.radius}, [&](uint32_t atom_idx, Vec2 position) {
+            const Vec2 v = position - q.center;
+            if (v.x * v.x + v.y * v.y <= radius2) {
+                addResult(q, atom_idx);
+            }
+        });
+    }
+
+    void query(BoxQuery& q) const
+    {
+        q.count = 0;
+        forEachCandidate(q.box_min, q.box_max, [&](uint32_t atom_idx, Vec2 position) {
+            if (position.x >= q.box_min.x && position.x <= q.box_max.x &&
+                position.y >= q.box_min.y && position.y <= q.box_max.y) {
+                addResult(q, atom_idx);
+            }
+        });
+    }
+
+    /**
+     * @brief Search square rings of cells around the center until no closer atom can be found
+     */
+    void query(NearestQuery& q) const
+    {
+        q.count = 0;
+        if (!q.k) {
+            return;
+        }
+        const float   max_radius2 = q.max_radius * q.max_radius;
+        const int32_t cx = to<int32_t>(q.center.x);
+        const int32_t cy = to<int32_t>(q.center.y);
+        const int32_t max_ring = std::max(grid.width, grid.height);
+        for (int32_t ring{0}; ring < max_ring; ++ring) {
+            // Atoms of this ring are at least this far, their center can be anywhere in their cell
+            const float min_dist = std::max(to<float>(ring - 1) - drift_margin, 0.0f);
+            if (min_dist > q.max_radius || (q.count == q.k && min_dist * min_dist > q.distances2[q.k - 1])) {
+                return;
+            }
+            for (int32_t x{cx - ring}; x <= cx + ring; ++x) {
+                // Only the border of the ring
+                const int32_t y_step = (x == cx - ring || x == cx + ring) ? 1 : std::max(2 * ring, 1);
+                for (int32_t y{cy - ring}; y <= cy + ring; y += y_step) {
+                    if (x < 0 || y < 0 || x >= grid.width || y >= grid.height) {
+                        continue;
+                    }
+                    forEachCellAtom(x, y, [&](uint32_t atom_idx, Vec2 position) {
+                        const Vec2  v     = position - q.center;
+                        const float dist2 = v.x * v.x + v.y * v.y;
+                        if (dist2 <= max_radius2) {
+                            insertNearest(q, atom_idx, dist2);
+                        }
+                    });
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Walk the cells crossed by the ray (Amanatides and Woo DDA)
+     *
+     * Atoms overlap the neighbor cells of their own by their radius and drift, the 3x3 neighborhood
+     * of each crossed cell is tested and the walk stops once a hit is closer than the current cell exit.
+     */
+    void query(RaycastQuery& q) const
+    {
+        q.hit = false;
+        const float length = std::sqrt(q.direction.x * q.direction.x + q.direction.y * q.direction.y);
+        if (length == 0.0f) {
+            return;
+        }
+        const Vec2 d = q.direction / length;
+        float best = q.max_distance;
+        int32_t x = to<int32_t>(std::floor(q.origin.x));
+        int32_t y = to<int32_t>(std::floor(q.origin.y));
+        const int32_t step_x = d.x > 0.0f ? 1 : -1;
+        const int32_t step_y = d.y > 0.0f ? 1 : -1;
+        constexpr float inf = 1e30f;
+        const float delta_x = d.x != 0.0f ? std::abs(1.0f / d.x) : inf;
+        const float delta_y = d.y != 0.0f ? std::abs(1.0f / d.y) : inf;
+        float next_x = d.x != 0.0f ? (to<float>(x + (step_x > 0)) - q.origin.x) / d.x : inf;
+        float next_y = d.y != 0.0f ? (to<float>(y + (step_y > 0)) - q.origin.y) / d.y : inf;
+        float t = 0.0f;
+        while (t <= best) {
+            for (int32_t nx{std::max(x - 1, 0)}; nx <= std::min(x + 1, grid.width - 1); ++nx) {
+                for (int32_t ny{std::max(y - 1, 0)}; ny <= std::min(y + 1, grid.height - 1); ++ny) {
+                    forEachCellAtom(nx, ny, [&](uint32_t atom_idx, Vec2 position) {
+                        const float hit_dist = getRayDistance(q.origin, d, position, getRadius(atom_idx));
+                        if (hit_dist <= best) {
+                            best       = hit_dist;
+                            q.hit      = true;
+                            q.atom     = atom_idx;
+                            q.distance = hit_dist;
+                        }
+                    });
+                }
+            }
+            // Next cell
+            if (next_x < next_y) {
+                t       = next_x;
+                next_x += delta_x;
+                x      += step_x;
+            } else {
+                t       = next_y;
+                next_y += delta_y;
+                y      += step_y;
+            }
+            // Leaving the grid, atoms are at least one cell away from the borders
+            if ((x < 0 && step_x < 0) || (x >= grid.width && step_x > 0) ||
+                (y < 0 && step_y < 0) || (y >= grid.height && step_y > 0)) {
+                return;
+            }
+        }
+    }
+
+private:
+    template<typename TQuery>
+    static void addResult(TQuery& q, uint32_t atom_idx)
+    {
+        if (q.count < q.capacity) {
+            q.results[q.count] = atom_idx;
+        }
+        ++q.count;
+    }
+
+    static void insertNearest(NearestQuery& q, uint32_t atom_idx, float dist2)
+    {
+        if (q.count == q.k && dist2 >= q.distances2[q.k - 1]) {
+            return;
+        }
+        // Insertion sort, the last result is dropped when full
+        uint32_t i = std::min(q.count, q.k - 1);
+        while (i > 0 && q.distances2[i - 1] > dist2) {
+            q.results[i]    = q.results[i - 1];
+            q.distances2[i] = q.distances2[i - 1];
+            --i;
+        }
+        q.results[i]    = atom_idx;
+        q.distances2[i] = dist2;
+        q.count = std::min(q.count + 1, q.k);
+    }
+
+    /**
+     * @brief Distance along a normalized ray to a circle, a ray starting inside hits at 0
+     *
+     * @return the distance, or infinity if the circle is missed
+     */
+    static float getRayDistance(Vec2 origin, Vec2 d, Vec2 center, float radius)
+    {
+        const Vec2  oc    = center - origin;
+        const float proj  = oc.x * d.x + oc.y * d.y;
+        const float dist2 = oc.x * oc.x + oc.y * oc.y - proj * proj;
+        const float r2    = radius * radius;
+        if (dist2 > r2) {
+            return 1e30f;
+        }
+        const float half_chord = std::sqrt(r2 - dist2);
+        if (proj + half_chord < 0.0f) {
+            return 1e30f;
+        }
+        return std::max(proj - half_chord, 0.0f);
+    }
+
+    [[nodiscard]]
+    float getRadius(uint32_t atom_idx) const
+    {
+        return atom_idx < shapes_count ? shapes[atom_idx].radius : AtomShape{}.radius;
+    }
+
+    template<typename TCallback>
+    void forEachCellAtom(int32_t x, int32_t y, TCallback&& callback) const
+    {
+        const CollisionCell& cell = grid.get(x, y);
+        for (uint32_t i{0}; i < cell.objects_count; ++i) {
+            const uint32_t atom_idx = cell.objects[i];
+            // Objects may have been removed since the grid build
+            if (atom_idx < objects_count) {
+                callback(atom_idx, objects[atom_idx].position);
+            }
+        }
+    }
+
+    template<typename TCallback>
+    void forEachCandidate(Vec2 box_min, Vec2 box_max, TCallback&& callback) const
+    {
+        const int32_t x_min = std::max(to<int32_t>(std::floor(box_min.x - drift_margin)), 0);
+        const int32_t x_max = std::min(to<int32_t>(std::floor(box_max.x + drift_margin)), grid.width - 1);
+        const int32_t y_min = std::max(to<int32_t>(std::floor(box_min.y - drift_margin)), 0);
+        const int32_t y_max = std::min(to<int32_t>(std::floor(box_max.y + drift_margin)), grid.height - 1);
+        for (int32_t x{x_min}; x <= x_max; ++x) {
+            for (int32_t y{y_min}; y <= y_max; ++y) {
+                forEachCellAtom(x, y, callback);
+            }
+        }
+    }
+};
@@ -0,0 +1,293 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define PROF_HAS_RDTSC 1
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#endif
+
+
+namespace prof
+{
+
+/**
+ * @brief Read the current timestamp counter
+ *
+ * @return ticks, use Profiler::ticksToMicroseconds to convert them
+ */
+inline uint64_t readTicks()
+{
+#ifdef PROF_HAS_RDTSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+/**
+ * @brief A timed section of code
+ */
+struct Event
+{
+    const char* name  = nullptr;
+    uint64_t    start = 0;
+    uint64_t    end   = 0;
+    uint32_t    depth = 0;
+    uint32_t    thread_id = 0;
+};
+
+/**
+ * @brief Per thread ring buffer of events, only written by its owner thread
+ */
+struct ThreadBuffer
+{
+    static constexpr uint64_t capacity = 1 << 14;
+    static constexpr uint64_t mask     = capacity - 1;
+
+    std::vector<Event>    m_events;
+    std::atomic<uint64_t> m_write_index = 0;
+    uint32_t              m_thread_id   = 0;
+    uint32_t              m_depth       = 0;
+
+    explicit
+    ThreadBuffer(uint32_t thread_id)
+        : m_events(capacity)
+        , m_thread_id{thread_id}
+    {}
+
+    /**
+     * @brief Add an event, overwriting the oldest one if the buffer is full
+     *
+     * @param event event to add
+     */
+    void push(const Event& event)
+    {
+        const uint64_t index = m_write_index.load(std::memory_order_relaxed);
+        m_events[index & mask] = event;
+        m_events[index & mask].thread_id = m_thread_id;
+        m_write_index.store(index + 1, std::memory_order_release);
+    }
+};
+
+/**
+ * @brief Collects events from all threads
+ */
+struct Profiler
+{
+    std::atomic<bool>                          m_enabled = false;
+    std::mutex                                 m_registry_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    uint64_t                                   m_frame_start    = 0;
+    uint64_t                                   m_last_frame_start = 0;
+    uint64_t                                   m_origin_ticks;
+    std::chrono::steady_clock::time_point      m_origin_time;
+
+    Profiler()
+        : m_origin_ticks{readTicks()}
+        , m_origin_time{std::chrono::steady_clock::now()}
+    {}
+
+    /**
+     * @brief Get the global profiler
+     */
+    static Profiler& get()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    [[nodiscard]]
+    bool isEnabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled)
+    {
+        m_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the calling thread's buffer, registering it on first use
+     */
+    ThreadBuffer& getThreadBuffer()
+    {
+        thread_local ThreadBuffer* buffer = registerThread();
+        return *buffer;
+    }
+
+    /**
+     * @brief Mark the beginning of a new frame
+     */
+    void newFrame()
+    {
+        m_last_frame_start = m_frame_start;
+        m_frame_start      = readTicks();
+    }
+
+    /**
+     * @brief Convert a tick count to microseconds
+     */
+    [[nodiscard]]
+    double ticksToMicroseconds(uint64_t ticks) const
+    {
+        // Calibrated against the steady clock since the profiler creation
+        const uint64_t elapsed_ticks = readTicks() - m_origin_ticks;
+        const auto     elapsed_time  = std::chrono::steady_clock::now() - m_origin_time;
+        const double   elapsed_us    = std::chrono::duration<double, std::micro>(elapsed_time).count();
+        if (elapsed_ticks == 0) {
+            return 0.0;
+        }
+        return static_cast<double>(ticks) * elapsed_us / static_cast<double>(elapsed_ticks);
+    }
+
+    /**
+     * @brief Copy the events recorded in [start, end), should be called while the pool is idle
+     *
+     * @param start first tick
+     * @param end last tick
+     * @param events output, cleared first
+     */
+    void collect(uint64_t start, uint64_t end, std::vector<Event>& events)
+    {
+        events.clear();
+        std::lock_guard<std::mutex> lock_guard{m_registry_mutex};
+        for (const auto& buffer : m_buffers) {
+            const uint64_t write_index = buffer->m_write_index.load(std::memory_order_acquire);
+            const uint64_t first       = write_index > ThreadBuffer::capacity ? write_index - ThreadBuffer::capacity : 0;
+            for (uint64_t i{first}; i < write_index; ++i) {
+                const Event& event = buffer->m_events[i & ThreadBuffer::mask];
+                if (event.start >= start && event.end <= end) {
+                    events.push_back(event);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Copy the events of the last complete frame
+     */
+    void collectLastFrame(std::vector<Event>& events)
+    {
+        collect(m_last_frame_start, m_frame_start, events);
+    }
+
+    /**
+     * @brief Write all buffered events in the Chrome trace format (chrome://tracing, Perfetto)
+     *
+     * @param filename output file
+     * @return true if the file was written
+     */
+    bool exportChromeTrace(const std::string& filename)
+    {
+        std::vector<Event> events;
+        collect(0, UINT64_MAX, events);
+        std::ofstream file{filename};
+        if (!file) {
+            return false;
+        }
+        file << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (const Event& event : events) {
+            if (!first) {
+                file << ",\n";
+            }
+            first = false;
+            file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0"
+                 << ",\"tid\":"  << event.thread_id
+                 << ",\"ts\":"   << ticksToMicroseconds(event.start - m_origin_ticks)
+                 << ",\"dur\":"  << ticksToMicroseconds(event.end - event.start) << "}";
+        }
+        file << "\n]}\n";
+        return true;
+    }
+
+private:
+    ThreadBuffer* registerThread()
+    {
+        std::lock_guard<std::mutex> lock_guard{m_registry_mutex};
+        m_buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<uint32_t>(m_buffers.size())));
+        return m_buffers.back().get();
+    }
+};
+
+/**
+ * @brief Times the enclosing scope, does nothing but a flag check when profiling is off
+ */
+struct Scope
+{
+    ThreadBuffer* m_buffer = nullptr;
+    const char*   m_name;
+    uint64_t      m_start  = 0;
+
+    explicit
+    Scope(const char* name)
+        : m_name{name}
+    {
+        Profiler& profiler = Profiler::get();
+        if (profiler.isEnabled()) {
+            m_buffer = &profiler.getThreadBuffer();
+            ++m_buffer->m_depth;
+            m_start  = readTicks();
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    ~Scope()
+    {
+        if (m_buffer) {
+            const uint64_t end = readTicks();
+            --m_buffer->m_depth;
+            m_buffer->push({m_name, m_start, end, m_buffer->m_depth});
+        }
+    }
+};
+
+/**
+ * @brief Records spans of time a thread spends waiting for work
+ */
+struct IdleTracker
+{
+    uint64_t m_idle_start = 0;
+
+    /**
+     * @brief Called when no work is available
+     */
+    void idle()
+    {
+        if (!m_idle_start && Profiler::get().isEnabled()) {
+            m_idle_start = readTicks();
+        }
+    }
+
+    /**
+     * @brief Called when work is found, closes the current idle span if any
+     */
+    void busy()
+    {
+        if (m_idle_start) {
+            Profiler::get().getThreadBuffer().push({"idle", m_idle_start, readTicks(), 0});
+            m_idle_start = 0;
+        }
+    }
+};
+
+}
+
+#define PROF_CONCAT_IMPL(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) prof::Scope PROF_CONCAT(prof_scope_, __LINE__){name}
@@ -0,0 +1,82 @@
+#pragma once
+#include <SFML/Graphics/Color.hpp>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include "engine/common/color_utils.hpp"
+
+
+/**
+ * @brief Lookup table turning atoms color indices or scalar attributes into colors at render time
+ *
+ */
+struct ColorMap
+{
+    static constexpr uint32_t size         = 256;
+    // Entries of the rainbow palette, the last entry is white
+    static constexpr uint32_t rainbow_size = size - 1;
+
+    std::array<sf::Color, size> colors;
+
+    /**
+     * @brief One period of ColorUtils::getRainbow followed by white
+     *
+     */
+    static ColorMap makeRainbow()
+    {
+        ColorMap map;
+        for (uint32_t i{0}; i < rainbow_size; ++i) {
+            map.colors[i] = ColorUtils::getRainbow(to<float>(i) * ColorUtils::PI / to<float>(rainbow_size));
+        }
+        map.colors[rainbow_size] = sf::Color::White;
+        return map;
+    }
+
+    /**
+     * @brief Dark blue to red through cyan and yellow, for scalar attributes
+     *
+     */
+    static ColorMap makeHeat()
+    {
+        const sf::Color stops[] = {{20, 30, 90}, {40, 140, 230}, {90, 220, 200}, {250, 220, 60}, {230, 50, 30}};
+        const uint32_t  stops_count = std::size(stops);
+        ColorMap map;
+        for (uint32_t i{0}; i < size; ++i) {
+            const float    t     = to<float>(i * (stops_count - 1)) / to<float>(size - 1);
+            const uint32_t first = std::min(to<uint32_t>(t), stops_count - 2);
+            const float    ratio = t - to<float>(first);
+            const sf::Color a = stops[first];
+            const sf::Color b = stops[first + 1];
+            map.colors[i] = ColorUtils::createColor(to<float>(a.r) + (to<float>(b.r) - to<float>(a.r)) * ratio,
+                                                    to<float>(a.g) + (to<float>(b.g) - to<float>(a.g)) * ratio,
+                                                    to<float>(a.b) + (to<float>(b.b) - to<float>(a.b)) * ratio);
+        }
+        return map;
+    }
+
+    /**
+     * @brief Index of the rainbow entry matching ColorUtils::getRainbow(t)
+     *
+     */
+    static uint8_t getRainbowIndex(float t)
+    {
+        const float period = t / ColorUtils::PI;
+        return to<uint8_t>(to<uint32_t>((period - std::floor(period)) * to<float>(rainbow_size)) % rainbow_size);
+    }
+
+    [[nodiscard]]
+    sf::Color operator[](uint8_t index) const
+    {
+        return colors[index];
+    }
+
+    /**
+     * @brief Color of a scalar, values outside [0, 1] are clamped
+     *
+     */
+    [[nodiscard]]
+    sf::Color get(float t) const
+    {
+        return colors[to<uint32_t>(std::min(std::max(t, 0.0f), 1.0f) * to<float>(size - 1))];
+    }
+};
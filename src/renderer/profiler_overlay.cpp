@@ -0,0 +1,75 @@
+#include "profiler_overlay.hpp"
+#include "engine/common/color_utils.hpp"
+
+/**
+ * @brief Construct a new Profiler Overlay object
+ *
+ */
+ProfilerOverlay::ProfilerOverlay()
+    : bars_va{sf::Quads}
+{
+}
+
+/**
+ * @brief Show or hide the overlay, profiling is only enabled while visible
+ *
+ */
+void ProfilerOverlay::toggle()
+{
+    visible = !visible;
+    prof::Profiler::get().setEnabled(visible);
+}
+
+/**
+ * @brief Render the last frame timeline in screen space
+ *
+ * @param context render context
+ */
+void ProfilerOverlay::render(RenderContext& context)
+{
+    if (!visible) {
+        return;
+    }
+    prof::Profiler& profiler = prof::Profiler::get();
+    profiler.collectLastFrame(events);
+    const uint64_t frame_start    = profiler.m_last_frame_start;
+    const uint64_t frame_duration = profiler.m_frame_start - frame_start;
+    if (frame_duration == 0) {
+        return;
+    }
+
+    const float margin       = 10.0f;
+    const float width        = context.getRenderSize().x - 2.0f * margin;
+    const float depth_height = 6.0f;
+    const float row_height   = 5.0f * depth_height;
+    bars_va.resize(events.size() * 4);
+    uint32_t idx = 0;
+    for (const prof::Event& event : events) {
+        const float x_start = margin + width * to<float>(event.start - frame_start) / to<float>(frame_duration);
+        const float x_end   = margin + width * to<float>(event.end   - frame_start) / to<float>(frame_duration);
+        const float y_start = margin + to<float>(event.thread_id) * row_height + to<float>(event.depth) * depth_height;
+        const float y_end   = y_start + depth_height - 1.0f;
+        const sf::Color color = getEventColor(event.name);
+        bars_va[idx + 0] = sf::Vertex{{x_start, y_start}, color};
+        bars_va[idx + 1] = sf::Vertex{{x_end  , y_start}, color};
+        bars_va[idx + 2] = sf::Vertex{{x_end  , y_end  }, color};
+        bars_va[idx + 3] = sf::Vertex{{x_start, y_end  }, color};
+        idx += 4;
+    }
+    context.drawDirect(bars_va);
+}
+
+/**
+ * @brief Get a stable color for an event name
+ *
+ * @param name event name
+ * @return sf::Color color of the event
+ */
+sf::Color ProfilerOverlay::getEventColor(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (const char* c{name}; *c; ++c) {
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+    }
+    return ColorUtils::getRainbow(to<float>(hash % 1000) * 0.01f);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "profiler/profiler.hpp"
+#include "engine/window_context_handler.hpp"
+
+
+/**
+ * @brief Draws the events of the last profiled frame as a timeline, one row per thread
+ *
+ */
+struct ProfilerOverlay
+{
+    sf::VertexArray          bars_va;
+    std::vector<prof::Event> events;
+    bool                     visible = false;
+
+    ProfilerOverlay();
+
+    void render(RenderContext& context);
+
+    void toggle();
+
+    static sf::Color getEventColor(const char* name);
+};
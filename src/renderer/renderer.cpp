@@ -10,6 +10,8 @@ Renderer::Renderer(PhysicSolver& solver_, tp::ThreadPool& tp)
     : solver{solver_}
     , world_va{sf::Quads, 4}
     , objects_va{sf::Quads}
+    , obstacles_va{sf::Quads}
+    , bodies_va{sf::Triangles}
     , thread_pool{tp}
 {
     initializeWorldVA();
@@ -31,9 +33,124 @@ void Renderer::render(RenderContext& context)
     sf::RenderStates states;
     states.texture = &object_texture;
     context.draw(world_va, states);
+    // Obstacles
+    if (obstacles_version != solver.obstacles.version) {
+        updateObstaclesVA();
+    }
+    context.draw(obstacles_va);
+    // Bodies
+    updateBodiesVA();
+    context.draw(bodies_va);
     // Particles
-    updateParticlesVA();
-    context.draw(objects_va, states);
+    if (mode == Mode::Surface) {
+        surface_colors.resize(solver.objects.size());
+        thread_pool.dispatch(to<uint32_t>(solver.objects.size()), [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                surface_colors[i] = getObjectColor(i);
+            }
+        });
+        surface.update(solver, surface_colors, thread_pool);
+        PROFILE_SCOPE("draw");
+        context.draw(surface.va);
+    } else {
+        updateParticlesVA();
+        PROFILE_SCOPE("draw");
+        context.draw(objects_va, states);
+    }
+}
+
+/**
+ * @brief Switch between drawing the particles and the fluid surface
+ * 
+ */
+void Renderer::toggleMode()
+{
+    mode = mode == Mode::Particles ? Mode::Surface : Mode::Particles;
+}
+
+/**
+ * @brief Switch to the next atoms color mode
+ * 
+ */
+void Renderer::cycleColorMode()
+{
+    color_mode = static_cast<ColorMode>((static_cast<uint8_t>(color_mode) + 1) % 4);
+}
+
+/**
+ * @brief Color of an atom in the current color mode
+ * 
+ * @param atom_idx data index of the atom
+ */
+sf::Color Renderer::getObjectColor(uint32_t atom_idx) const
+{
+    const PhysicObject& object = solver.objects.data[atom_idx];
+    switch (color_mode) {
+    case ColorMode::Velocity: {
+        const Vec2 move = object.position - object.last_position;
+        return heat_map.get(std::sqrt(move.x * move.x + move.y * move.y) / max_velocity);
+    }
+    case ColorMode::Pressure:
+        return heat_map.get(getPressure(atom_idx) / max_pressure);
+    case ColorMode::Density:
+        return heat_map.get(getDensity(atom_idx) / max_density);
+    default:
+        return palette[object.color];
+    }
+}
+
+/**
+ * @brief Sum of the overlaps of an atom with the atoms of its neighbor cells
+ * 
+ * The grid was built during the last sub step. Indices past the atoms count are skipped, but
+ * removals swap atoms in the freed indices, so until the next sub step some overlaps can be
+ * missed or counted for an atom that moved there. Only used for display.
+ * 
+ * @param atom_idx data index of the atom
+ */
+float Renderer::getPressure(uint32_t atom_idx) const
+{
+    const PhysicObject& object = solver.objects.data[atom_idx];
+    const auto    objects_count = to<uint32_t>(solver.objects.size());
+    const float   radius        = solver.getObjectShape(atom_idx).radius;
+    const int32_t cell_x = to<int32_t>(object.position.x);
+    const int32_t cell_y = to<int32_t>(object.position.y);
+    float pressure = 0.0f;
+    for (int32_t x{std::max(cell_x - 1, 0)}; x <= std::min(cell_x + 1, solver.grid.width - 1); ++x) {
+        for (int32_t y{std::max(cell_y - 1, 0)}; y <= std::min(cell_y + 1, solver.grid.height - 1); ++y) {
+            const CollisionCell& cell = solver.grid.data[solver.grid.layout.getIndex(x, y)];
+            for (uint32_t k{0}; k < cell.objects_count; ++k) {
+                const uint32_t other_idx = cell.objects[k];
+                if (other_idx == atom_idx || other_idx >= objects_count) {
+                    continue;
+                }
+                const PhysicObject& other = solver.objects.data[other_idx];
+                const Vec2  v    = object.position - other.position;
+                const float dist = std::sqrt(v.x * v.x + v.y * v.y);
+                pressure += std::max(radius + solver.getObjectShape(other_idx).radius - dist, 0.0f);
+            }
+        }
+    }
+    return pressure;
+}
+
+/**
+ * @brief Number of atoms in the cell of an atom and in the cells around it
+ * 
+ * @param atom_idx data index of the atom
+ */
+float Renderer::getDensity(uint32_t atom_idx) const
+{
+    const PhysicObject& object = solver.objects.data[atom_idx];
+    const int32_t cell_x = to<int32_t>(object.position.x);
+    const int32_t cell_y = to<int32_t>(object.position.y);
+    uint32_t count = 0;
+    for (int32_t x{std::max(cell_x - 1, 0)}; x <= std::min(cell_x + 1, solver.grid.width - 1); ++x) {
+        for (int32_t y{std::max(cell_y - 1, 0)}; y <= std::min(cell_y + 1, solver.grid.height - 1); ++y) {
+            count += solver.grid.data[solver.grid.layout.getIndex(x, y)].objects_count;
+        }
+    }
+    return to<float>(count);
 }
 
 /**
@@ -61,14 +178,15 @@ void Renderer::initializeWorldVA()
  */
 void Renderer::updateParticlesVA()
 {
+    PROFILE_SCOPE("update_particles_va");
     objects_va.resize(solver.objects.size() * 4);
 
     const float texture_size = 1024.0f;
-    const float radius       = 0.5f;
     thread_pool.dispatch(to<uint32_t>(solver.objects.size()), [&](uint32_t start, uint32_t end) {
         for (uint32_t i{start}; i < end; ++i) {
             const PhysicObject& object = solver.objects.data[i];
             const uint32_t idx = i << 2;
+            const float radius = solver.getObjectShape(i).radius;
             objects_va[idx + 0].position = object.position + Vec2{-radius, -radius};
             objects_va[idx + 1].position = object.position + Vec2{ radius, -radius};
             objects_va[idx + 2].position = object.position + Vec2{ radius,  radius};
@@ -78,11 +196,67 @@ void Renderer::updateParticlesVA()
             objects_va[idx + 2].texCoords = {texture_size, texture_size};
             objects_va[idx + 3].texCoords = {0.0f        , texture_size};
 
-            const sf::Color color = object.color;
+            const sf::Color color = getObjectColor(i);
             objects_va[idx + 0].color = color;
             objects_va[idx + 1].color = color;
             objects_va[idx + 2].color = color;
             objects_va[idx + 3].color = color;
         }
     });
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Rebuild the obstacles vertex array, one quad per node inside an obstacle
+ * 
+ */
+void Renderer::updateObstaclesVA()
+{
+    const DistanceField& obstacles = solver.obstacles;
+    obstacles_version = obstacles.version;
+    obstacles_va.clear();
+    const sf::Color color{120, 120, 120};
+    for (int32_t x{0}; x < obstacles.width; ++x) {
+        for (int32_t y{0}; y < obstacles.height; ++y) {
+            if (obstacles.distances[obstacles.getIndex(x, y)] < 0.0f) {
+                const Vec2 position{to<float>(x), to<float>(y)};
+                obstacles_va.append({position + Vec2{-0.5f, -0.5f}, color});
+                obstacles_va.append({position + Vec2{ 0.5f, -0.5f}, color});
+                obstacles_va.append({position + Vec2{ 0.5f,  0.5f}, color});
+                obstacles_va.append({position + Vec2{-0.5f,  0.5f}, color});
+            }
+        }
+    }
+}
+
+/**
+ * @brief Rebuild the bodies vertex array, bodies are drawn as triangle fans
+ * 
+ */
+void Renderer::updateBodiesVA()
+{
+    bodies_va.clear();
+    const sf::Color dynamic_color{200, 160, 110};
+    const sf::Color kinematic_color{110, 140, 200};
+    for (const RigidBody& body : solver.bodies) {
+        const sf::Color color = body.kinematic ? kinematic_color : dynamic_color;
+        if (body.shape == RigidBody::Shape::Circle) {
+            const uint32_t segments = 24;
+            const float    step     = 2.0f * 3.141592653f / to<float>(segments);
+            for (uint32_t i{0}; i < segments; ++i) {
+                const float a1 = body.angle + step * to<float>(i);
+                const float a2 = a1 + step;
+                // The first triangle is highlighted to show the rotation
+                bodies_va.append({body.position, i ? color : sf::Color::White});
+                bodies_va.append({body.position + Vec2{std::cos(a1), std::sin(a1)} * body.radius, color});
+                bodies_va.append({body.position + Vec2{std::cos(a2), std::sin(a2)} * body.radius, color});
+            }
+        } else {
+            const auto count = to<uint32_t>(body.points.size());
+            for (uint32_t i{1}; i + 1 < count; ++i) {
+                bodies_va.append({body.points[0]    , color});
+                bodies_va.append({body.points[i]    , color});
+                bodies_va.append({body.points[i + 1], color});
+            }
+        }
+    }
+}
@@ -2,15 +2,52 @@
 #include <SFML/Graphics.hpp>
 #include "physics/physics.hpp"
 #include "engine/window_context_handler.hpp"
+#include "profiler/profiler.hpp"
+#include "surface_mesh.hpp"
+#include "color_map.hpp"
 
 
 struct Renderer
 {
+    enum class Mode : uint8_t
+    {
+        // One textured quad per atom
+        Particles,
+        // Iso contour of the atoms density, see SurfaceMesh
+        Surface
+    };
+
+    // Atoms attribute shown by their color, computed while building the vertices
+    enum class ColorMode : uint8_t
+    {
+        // Color index of the atoms in the palette
+        Palette,
+        // Displacement per sub step
+        Velocity,
+        // Overlap with the atoms of the neighbor cells
+        Pressure,
+        // Atoms count of the neighbor cells
+        Density
+    };
+
     PhysicSolver& solver;
+    Mode          mode       = Mode::Particles;
+    ColorMode     color_mode = ColorMode::Palette;
+    ColorMap      palette    = ColorMap::makeRainbow();
+    ColorMap      heat_map   = ColorMap::makeHeat();
+    // Attribute values mapped to the end of the heat map
+    float         max_velocity = 0.3f;
+    float         max_pressure = 0.1f;
+    float         max_density  = 12.0f;
 
     sf::VertexArray world_va;
     sf::VertexArray objects_va;
+    sf::VertexArray obstacles_va;
+    uint64_t        obstacles_version = 0;
+    sf::VertexArray bodies_va;
     sf::Texture     object_texture;
+    SurfaceMesh     surface;
+    std::vector<sf::Color> surface_colors;
 
     tp::ThreadPool& thread_pool;
 
@@ -23,4 +60,21 @@ struct Renderer
 
     void updateParticlesVA();
 
+    void updateObstaclesVA();
+
+    void updateBodiesVA();
+
+    void toggleMode();
+
+    void cycleColorMode();
+
+    [[nodiscard]]
+    sf::Color getObjectColor(uint32_t atom_idx) const;
+
+    [[nodiscard]]
+    float getPressure(uint32_t atom_idx) const;
+
+    [[nodiscard]]
+    float getDensity(uint32_t atom_idx) const;
+
 };
@@ -0,0 +1,321 @@
+#include "surface_mesh.hpp"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Construct an empty mesh, the field is sized on the first update
+ *
+ */
+SurfaceMesh::SurfaceMesh()
+    : va{sf::Triangles}
+{}
+
+/**
+ * @brief Rebuild the mesh from the current atoms
+ *
+ * @param solver solver to render
+ * @param colors colors of the atoms, by data index
+ * @param thread_pool thread pool to use
+ */
+void SurfaceMesh::update(const PhysicSolver& solver, const std::vector<sf::Color>& colors, tp::ThreadPool& thread_pool)
+{
+    PROFILE_SCOPE("update_surface");
+    width  = solver.grid.width + 1;
+    height = solver.grid.height + 1;
+    const uint32_t batch_count = thread_pool.getBatchCount();
+    batch_fields.resize(batch_count);
+    batch_columns.resize(batch_count);
+    batch_vertices.resize(batch_count);
+    batch_offsets.resize(batch_count + 1);
+    splatAtoms(solver, colors, thread_pool);
+    reduceFields(thread_pool);
+    buildTriangles(thread_pool);
+}
+
+/**
+ * @brief Add the density of each atom to the nodes closer than its diameter
+ *
+ * @param solver solver to render
+ * @param colors colors of the atoms, by data index
+ * @param thread_pool thread pool to use
+ */
+void SurfaceMesh::splatAtoms(const PhysicSolver& solver, const std::vector<sf::Color>& colors, tp::ThreadPool& thread_pool)
+{
+    batch_used.assign(thread_pool.getBatchCount(), 0);
+    thread_pool.dispatchIndexed(to<uint32_t>(solver.objects.size()), [&](uint32_t batch_idx, uint32_t start, uint32_t end) {
+        std::vector<Sample>& batch_field = batch_fields[batch_idx];
+        // Fields are cleared by the reduction, only a new size needs a full clear
+        if (batch_field.size() != to<uint64_t>(width) * height) {
+            batch_field.assign(to<uint64_t>(width) * height, Sample{});
+        }
+        ColumnRange& columns = batch_columns[batch_idx];
+        columns = {width, 0};
+        batch_used[batch_idx] = 1;
+        for (uint32_t i{start}; i < end; ++i) {
+            const PhysicObject& object = solver.objects.data[i];
+            const sf::Color     color  = colors[i];
+            const float reach  = 2.0f * solver.getObjectShape(i).radius;
+            const float reach2 = reach * reach;
+            const int32_t x_min = std::max(to<int32_t>(std::ceil(object.position.x - reach)), 0);
+            const int32_t x_max = std::min(to<int32_t>(std::floor(object.position.x + reach)), width - 1);
+            const int32_t y_min = std::max(to<int32_t>(std::ceil(object.position.y - reach)), 0);
+            const int32_t y_max = std::min(to<int32_t>(std::floor(object.position.y + reach)), height - 1);
+            columns.first = std::min(columns.first, x_min);
+            columns.last  = std::max(columns.last, x_max + 1);
+            for (int32_t x{x_min}; x <= x_max; ++x) {
+                for (int32_t y{y_min}; y <= y_max; ++y) {
+                    const float dx = to<float>(x) - object.position.x;
+                    const float dy = to<float>(y) - object.position.y;
+                    const float q  = 1.0f - (dx * dx + dy * dy) / reach2;
+                    if (q > 0.0f) {
+                        const float w = q * q;
+                        Sample& sample = batch_field[getIndex(x, y)];
+                        sample.density += w;
+                        sample.r       += w * to<float>(color.r);
+                        sample.g       += w * to<float>(color.g);
+                        sample.b       += w * to<float>(color.b);
+                    }
+                }
+            }
+        }
+    });
+}
+
+/**
+ * @brief Sum the batch fields, node columns are reduced in parallel
+ *
+ * Only the columns touched by a batch are read, they are cleared for the next update.
+ *
+ * @param thread_pool thread pool to use
+ */
+void SurfaceMesh::reduceFields(tp::ThreadPool& thread_pool)
+{
+    field.resize(to<uint64_t>(width) * height);
+    thread_pool.dispatch(to<uint32_t>(width), [&](uint32_t start, uint32_t end) {
+        std::fill(field.begin() + getIndex(to<int32_t>(start), 0), field.begin() + getIndex(to<int32_t>(end), 0), Sample{});
+        for (uint32_t b{0}; b < batch_used.size(); ++b) {
+            if (!batch_used[b]) {
+                continue;
+            }
+            const int32_t first_column = std::max(to<int32_t>(start), batch_columns[b].first);
+            const int32_t last_column  = std::min(to<int32_t>(end), batch_columns[b].last);
+            if (first_column >= last_column) {
+                continue;
+            }
+            std::vector<Sample>& batch_field = batch_fields[b];
+            const uint32_t first = getIndex(first_column, 0);
+            const uint32_t last  = getIndex(last_column, 0);
+            for (uint32_t i{first}; i < last; ++i) {
+                field[i].density += batch_field[i].density;
+                field[i].r       += batch_field[i].r;
+                field[i].g       += batch_field[i].g;
+                field[i].b       += batch_field[i].b;
+            }
+            std::fill(batch_field.begin() + first, batch_field.begin() + last, Sample{});
+        }
+    });
+}
+
+/**
+ * @brief Run marching squares over the cells, then gather the triangles of all batches
+ *
+ * Consecutive inside cells of a column are covered by a single quad, only the cells crossed by
+ * the iso contour are polygonized.
+ *
+ * @param thread_pool thread pool to use
+ */
+void SurfaceMesh::buildTriangles(tp::ThreadPool& thread_pool)
+{
+    const auto cell_columns = to<uint32_t>(width - 1);
+    batch_used.assign(thread_pool.getBatchCount(), 0);
+    thread_pool.dispatchIndexed(cell_columns, [&](uint32_t batch_idx, uint32_t start, uint32_t end) {
+        std::vector<sf::Vertex>& vertices = batch_vertices[batch_idx];
+        vertices.clear();
+        batch_used[batch_idx] = 1;
+        for (uint32_t x{start}; x < end; ++x) {
+            // First cell of the current run of inside cells, -1 outside of a run, and its top nodes colors
+            int32_t   run_start = -1;
+            sf::Color run_left;
+            sf::Color run_right;
+            for (int32_t y{0}; y < height - 1; ++y) {
+                if (isCellInside(to<int32_t>(x), y)) {
+                    const sf::Color left  = getNodeColor(to<int32_t>(x), y);
+                    const sf::Color right = getNodeColor(to<int32_t>(x) + 1, y);
+                    // Runs are interpolated between their ends, a color change starts a new one
+                    if (run_start >= 0 && !(isColorClose(left, run_left) && isColorClose(right, run_right))) {
+                        addRun(to<int32_t>(x), run_start, y, vertices);
+                        run_start = -1;
+                    }
+                    if (run_start < 0) {
+                        run_start = y;
+                        run_left  = left;
+                        run_right = right;
+                    }
+                    continue;
+                }
+                if (run_start >= 0) {
+                    addRun(to<int32_t>(x), run_start, y, vertices);
+                    run_start = -1;
+                }
+                polygonizeCell(to<int32_t>(x), y, vertices);
+            }
+            if (run_start >= 0) {
+                addRun(to<int32_t>(x), run_start, height - 1, vertices);
+            }
+        }
+    });
+    batch_offsets[0] = 0;
+    for (uint32_t b{0}; b < batch_used.size(); ++b) {
+        batch_offsets[b + 1] = batch_offsets[b] + (batch_used[b] ? to<uint32_t>(batch_vertices[b].size()) : 0);
+    }
+    va.resize(batch_offsets.back());
+    if (!va.getVertexCount()) {
+        return;
+    }
+    // Same split as the polygonization, each batch copies its own triangles
+    thread_pool.dispatchIndexed(cell_columns, [&](uint32_t batch_idx, uint32_t, uint32_t) {
+        const std::vector<sf::Vertex>& vertices = batch_vertices[batch_idx];
+        std::copy(vertices.begin(), vertices.end(), &va[0] + batch_offsets[batch_idx]);
+    });
+}
+
+/**
+ * @brief Check if the four corners of a cell are above the iso level
+ *
+ */
+bool SurfaceMesh::isCellInside(int32_t x, int32_t y) const
+{
+    const uint32_t left  = getIndex(x, y);
+    const uint32_t right = getIndex(x + 1, y);
+    return field[left].density >= iso_level && field[left + 1].density >= iso_level
+        && field[right].density >= iso_level && field[right + 1].density >= iso_level;
+}
+
+/**
+ * @brief Check if two colors differ by at most the runs tolerance on each channel
+ *
+ */
+bool SurfaceMesh::isColorClose(sf::Color c1, sf::Color c2) const
+{
+    return std::abs(c1.r - c2.r) <= run_color_tolerance
+        && std::abs(c1.g - c2.g) <= run_color_tolerance
+        && std::abs(c1.b - c2.b) <= run_color_tolerance;
+}
+
+/**
+ * @brief Append the two triangles covering a run of inside cells of a column
+ *
+ * @param x column of the cells
+ * @param first first cell of the run
+ * @param last last cell of the run (excluded)
+ * @param vertices receives the triangles
+ */
+void SurfaceMesh::addRun(int32_t x, int32_t first, int32_t last, std::vector<sf::Vertex>& vertices) const
+{
+    const sf::Vertex top_left     = getNodeVertex(x, first);
+    const sf::Vertex top_right    = getNodeVertex(x + 1, first);
+    const sf::Vertex bottom_right = getNodeVertex(x + 1, last);
+    const sf::Vertex bottom_left  = getNodeVertex(x, last);
+    vertices.push_back(top_left);
+    vertices.push_back(top_right);
+    vertices.push_back(bottom_right);
+    vertices.push_back(top_left);
+    vertices.push_back(bottom_right);
+    vertices.push_back(bottom_left);
+}
+
+/**
+ * @brief Append the triangles covering the part of a cell above the iso level
+ *
+ * Corners are visited clockwise, saddle cells are connected if the density at their center
+ * is above the iso level.
+ *
+ * @param x column of the cell
+ * @param y row of the cell
+ * @param vertices receives the triangles
+ */
+void SurfaceMesh::polygonizeCell(int32_t x, int32_t y, std::vector<sf::Vertex>& vertices) const
+{
+    const int32_t corners_x[4] = {x, x + 1, x + 1, x};
+    const int32_t corners_y[4] = {y, y, y + 1, y + 1};
+    uint32_t inside_mask   = 0;
+    float    total_density = 0.0f;
+    for (uint32_t k{0}; k < 4; ++k) {
+        const float density = field[getIndex(corners_x[k], corners_y[k])].density;
+        inside_mask   |= (density >= iso_level ? 1u : 0u) << k;
+        total_density += density;
+    }
+    if (!inside_mask) {
+        return;
+    }
+    const bool saddle = inside_mask == 0b0101 || inside_mask == 0b1010;
+    if (saddle && total_density * 0.25f < iso_level) {
+        // Two separate corners, each one with the crossings of its edges
+        for (uint32_t k{0}; k < 4; ++k) {
+            if (inside_mask & (1u << k)) {
+                const uint32_t next = (k + 1) % 4;
+                const uint32_t prev = (k + 3) % 4;
+                vertices.push_back(getNodeVertex(corners_x[k], corners_y[k]));
+                vertices.push_back(getEdgeVertex(corners_x[k], corners_y[k], corners_x[next], corners_y[next]));
+                vertices.push_back(getEdgeVertex(corners_x[k], corners_y[k], corners_x[prev], corners_y[prev]));
+            }
+        }
+        return;
+    }
+    // Inside corners and edges crossings, in order around the cell
+    sf::Vertex polygon[8];
+    uint32_t   count = 0;
+    for (uint32_t k{0}; k < 4; ++k) {
+        const uint32_t next = (k + 1) % 4;
+        if (inside_mask & (1u << k)) {
+            polygon[count++] = getNodeVertex(corners_x[k], corners_y[k]);
+        }
+        if (((inside_mask >> k) ^ (inside_mask >> next)) & 1u) {
+            polygon[count++] = getEdgeVertex(corners_x[k], corners_y[k], corners_x[next], corners_y[next]);
+        }
+    }
+    for (uint32_t i{1}; i + 1 < count; ++i) {
+        vertices.push_back(polygon[0]);
+        vertices.push_back(polygon[i]);
+        vertices.push_back(polygon[i + 1]);
+    }
+}
+
+/**
+ * @brief Vertex at a field node, with the color of the atoms around it
+ *
+ */
+sf::Vertex SurfaceMesh::getNodeVertex(int32_t x, int32_t y) const
+{
+    return {{to<float>(x), to<float>(y)}, getNodeColor(x, y)};
+}
+
+/**
+ * @brief Density weighted color of the atoms around a field node
+ *
+ */
+sf::Color SurfaceMesh::getNodeColor(int32_t x, int32_t y) const
+{
+    const Sample& sample = field[getIndex(x, y)];
+    const float   scale  = sample.density > 0.0f ? 1.0f / sample.density : 0.0f;
+    return {to<uint8_t>(sample.r * scale), to<uint8_t>(sample.g * scale), to<uint8_t>(sample.b * scale)};
+}
+
+/**
+ * @brief Vertex where the density crosses the iso level between two nodes
+ *
+ */
+sf::Vertex SurfaceMesh::getEdgeVertex(int32_t x1, int32_t y1, int32_t x2, int32_t y2) const
+{
+    const float d1 = field[getIndex(x1, y1)].density;
+    const float d2 = field[getIndex(x2, y2)].density;
+    const float t  = std::min(std::max((iso_level - d1) / (d2 - d1), 0.0f), 1.0f);
+    const sf::Vertex v1 = getNodeVertex(x1, y1);
+    const sf::Vertex v2 = getNodeVertex(x2, y2);
+    // The outside node may have no atom around it
+    const sf::Color  c2 = d2 > 0.0f ? v2.color : v1.color;
+    const auto lerp = [t](uint8_t a, uint8_t b) {
+        return to<uint8_t>(to<float>(a) + (to<float>(b) - to<float>(a)) * t);
+    };
+    return {v1.position + (v2.position - v1.position) * t, {lerp(v1.color.r, c2.r), lerp(v1.color.g, c2.g), lerp(v1.color.b, c2.b)}};
+}
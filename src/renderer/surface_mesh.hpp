@@ -0,0 +1,84 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "physics/physics.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+
+/**
+ * @brief Fluid like surface of the atoms, an iso contour of their density drawn as a single mesh
+ *
+ * Atoms are splatted into a density field sampled at the grid cells corners, each dispatch
+ * batch filling its own copy of the field. Marching squares then turn the area above the iso
+ * level into triangles, colored with the density weighted color of the atoms.
+ */
+struct SurfaceMesh
+{
+    struct Sample
+    {
+        float density = 0.0f;
+        float r       = 0.0f;
+        float g       = 0.0f;
+        float b       = 0.0f;
+    };
+
+    // Node columns touched by a batch, last excluded
+    struct ColumnRange
+    {
+        int32_t first = 0;
+        int32_t last  = 0;
+    };
+
+    // A lone atom has a density of 1 at its center and reaches the iso level at 1.5 times its radius
+    float iso_level = 0.2f;
+    // Largest color channel difference between the ends of a run of inside cells drawn as one quad
+    int32_t run_color_tolerance = 8;
+
+    // Field nodes per column and row, one more than the grid cells
+    int32_t                              width  = 0;
+    int32_t                              height = 0;
+    std::vector<Sample>                  field;
+    // Per dispatch batch fields and triangles, flagged once a batch ran. Fields are kept zeroed between updates
+    std::vector<std::vector<Sample>>     batch_fields;
+    std::vector<ColumnRange>             batch_columns;
+    std::vector<std::vector<sf::Vertex>> batch_vertices;
+    std::vector<uint8_t>                 batch_used;
+    std::vector<uint32_t>                batch_offsets;
+    sf::VertexArray                      va;
+
+    SurfaceMesh();
+
+    void update(const PhysicSolver& solver, const std::vector<sf::Color>& colors, tp::ThreadPool& thread_pool);
+
+private:
+    [[nodiscard]]
+    uint32_t getIndex(int32_t x, int32_t y) const
+    {
+        return to<uint32_t>(x * height + y);
+    }
+
+    void splatAtoms(const PhysicSolver& solver, const std::vector<sf::Color>& colors, tp::ThreadPool& thread_pool);
+
+    void reduceFields(tp::ThreadPool& thread_pool);
+
+    void buildTriangles(tp::ThreadPool& thread_pool);
+
+    [[nodiscard]]
+    bool isCellInside(int32_t x, int32_t y) const;
+
+    [[nodiscard]]
+    bool isColorClose(sf::Color c1, sf::Color c2) const;
+
+    void addRun(int32_t x, int32_t first, int32_t last, std::vector<sf::Vertex>& vertices) const;
+
+    void polygonizeCell(int32_t x, int32_t y, std::vector<sf::Vertex>& vertices) const;
+
+    [[nodiscard]]
+    sf::Vertex getNodeVertex(int32_t x, int32_t y) const;
+
+    [[nodiscard]]
+    sf::Color getNodeColor(int32_t x, int32_t y) const;
+
+    [[nodiscard]]
+    sf::Vertex getEdgeVertex(int32_t x1, int32_t y1, int32_t x2, int32_t y2) const;
+};
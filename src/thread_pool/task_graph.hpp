@@ -0,0 +1,118 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include "thread_pool.hpp"
+
+
+namespace tp
+{
+
+/**
+ * @brief Tasks with dependencies, a task is queued as soon as all its dependencies are done
+ *
+ * The graph is built once and run as many times as needed, running it does not allocate.
+ * Replaces global barriers between phases when tasks of a phase only depend on a few
+ * tasks of the previous one.
+ */
+struct TaskGraph
+{
+    struct Node
+    {
+        std::function<void()> m_task;
+        // Worker the task is bound to when workers are pinned, see ThreadPool::addTask
+        uint32_t              m_owner            = 0;
+        uint32_t              m_dependency_count = 0;
+        std::vector<uint32_t> m_successors;
+    };
+
+    std::vector<Node>                        m_nodes;
+    // Dependencies left before a node can run, reset on each run
+    std::unique_ptr<std::atomic<uint32_t>[]> m_pending;
+    uint32_t                                 m_pending_size = 0;
+    ThreadPool*                              m_pool         = nullptr;
+
+    /**
+     * @brief Add a task
+     *
+     * @param owner worker the task is meant for
+     * @param callback task to run
+     * @return index of the node
+     */
+    template<typename TCallback>
+    uint32_t addNode(uint32_t owner, TCallback&& callback)
+    {
+        m_nodes.push_back({std::forward<TCallback>(callback), owner, 0, {}});
+        return static_cast<uint32_t>(m_nodes.size() - 1);
+    }
+
+    /**
+     * @brief Declare that a node can only start once another one is done
+     *
+     * @param before node to wait for
+     * @param after node waiting
+     */
+    void addDependency(uint32_t before, uint32_t after)
+    {
+        m_nodes[before].m_successors.push_back(after);
+        ++m_nodes[after].m_dependency_count;
+    }
+
+    void clear()
+    {
+        m_nodes.clear();
+    }
+
+    [[nodiscard]]
+    bool empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    /**
+     * @brief Run all the tasks and wait for their completion
+     *
+     * @param pool thread pool running the tasks
+     */
+    void run(ThreadPool& pool)
+    {
+        const auto node_count = static_cast<uint32_t>(m_nodes.size());
+        if (m_pending_size != node_count) {
+            m_pending      = std::make_unique<std::atomic<uint32_t>[]>(node_count);
+            m_pending_size = node_count;
+        }
+        for (uint32_t i{0}; i < node_count; ++i) {
+            m_pending[i] = m_nodes[i].m_dependency_count;
+        }
+        m_pool = &pool;
+        for (uint32_t i{0}; i < node_count; ++i) {
+            if (!m_nodes[i].m_dependency_count) {
+                submit(i);
+            }
+        }
+        pool.waitForCompletion();
+    }
+
+private:
+    /**
+     * @brief Queue a node, its successors are queued before it completes so the pool never looks idle
+     */
+    void submit(uint32_t node_idx)
+    {
+        // Small capture, stored in place by std::function
+        m_pool->addTask(m_nodes[node_idx].m_owner, [this, node_idx]{
+            const Node& node = m_nodes[node_idx];
+            node.m_task();
+            for (const uint32_t successor : node.m_successors) {
+                if (--m_pending[successor] == 0) {
+                    submit(successor);
+                }
+            }
+        });
+    }
+};
+
+}
@@ -5,6 +5,19 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "topology.hpp"
+#include "profiler/profiler.hpp"
 
 
 namespace tp
@@ -15,6 +28,8 @@ struct TaskQueue
     std::queue<std::function<void()>> m_tasks;
     std::mutex                        m_mutex;
     std::atomic<uint32_t>             m_remaining_tasks = 0;
+    // Unfinished tasks counter, workers local queues use the one of the shared queue
+    std::atomic<uint32_t>*            m_counter         = &m_remaining_tasks;
 
     /**
      * @brief Add a task to the queue
@@ -27,7 +42,7 @@ struct TaskQueue
     {
         std::lock_guard<std::mutex> lock_guard{m_mutex};
         m_tasks.push(std::forward<TCallback>(callback));
-        m_remaining_tasks++;
+        ++*m_counter;
     }
 
     /**
@@ -60,7 +75,7 @@ struct TaskQueue
      */
     void waitForCompletion() const
     {
-        while (m_remaining_tasks > 0) {
+        while (*m_counter > 0) {
             wait();
         }
     }
@@ -70,17 +85,21 @@ struct TaskQueue
      */
     void workDone()
     {
-        m_remaining_tasks--;
+        --*m_counter;
     }
 };
 
 struct Worker
 {
     uint32_t              m_id      = 0;
+    // Logical CPU the worker is pinned to, -1 if it is free to move
+    int32_t               m_cpu     = -1;
     std::thread           m_thread;
     std::function<void()> m_task    = nullptr;
     bool                  m_running = true;
     TaskQueue*            m_queue   = nullptr;
+    // Tasks bound to this worker, processed before the shared ones
+    std::unique_ptr<TaskQueue> m_local_queue;
 
     Worker() = default;
 
@@ -89,11 +108,16 @@ struct Worker
      * 
      * @param queue task queue
      * @param id worker id
+     * @param cpu logical CPU to pin the worker to, -1 to let it move
      */
-    Worker(TaskQueue& queue, uint32_t id)
+    Worker(TaskQueue& queue, uint32_t id, int32_t cpu = -1)
         : m_id{id}
+        , m_cpu{cpu}
         , m_queue{&queue}
+        , m_local_queue{std::make_unique<TaskQueue>()}
     {
+        // A single counter so the pool can wait for all queues at once
+        m_local_queue->m_counter = &queue.m_remaining_tasks;
         m_thread = std::thread([this](){
             run();
         });
@@ -104,18 +128,45 @@ struct Worker
      */
     void run()
     {
+        pin();
+        prof::IdleTracker idle_tracker;
         while (m_running) {
-            m_queue->getTask(m_task);
+            TaskQueue* source = m_local_queue.get();
+            source->getTask(m_task);
+            if (m_task == nullptr) {
+                source = m_queue;
+                source->getTask(m_task);
+            }
             if (m_task == nullptr) {
+                idle_tracker.idle();
                 TaskQueue::wait();
             } else {
-                m_task();
-                m_queue->workDone();
+                idle_tracker.busy();
+                {
+                    PROFILE_SCOPE("task");
+                    m_task();
+                }
+                source->workDone();
                 m_task = nullptr;
             }
         }
     }
 
+    /**
+     * @brief Pin the calling thread to the worker CPU, only supported on Linux
+     */
+    void pin() const
+    {
+#ifdef __linux__
+        if (m_cpu >= 0) {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(m_cpu, &cpu_set);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        }
+#endif
+    }
+
     /**
      * @brief Stop the worker
      */
@@ -131,22 +182,59 @@ struct ThreadPool
     uint32_t            m_thread_count = 0;
     TaskQueue           m_queue;
     std::vector<Worker> m_workers;
+    CpuTopology         m_topology;
+    // When pinned, batch i of dispatchIndexed always runs on worker i
+    bool                m_pinned       = false;
+    // Tasks are run by the calling thread as soon as they are added
+    bool                m_inline       = false;
+
+    /**
+     * @brief Tag selecting the inline constructor
+     */
+    struct Inline {};
+
+    // Owner of tasks that can run on any worker, even when workers are pinned
+    static constexpr uint32_t any_worker = 0xFFFFFFFF;
+
+    /**
+     * @brief Construct a Thread Pool with one thread per physical core, workers are not pinned
+     */
+    ThreadPool()
+        : ThreadPool{CpuTopology::detect().getPhysicalCoreCount()}
+    {}
 
     /**
      * @brief Construct a new Thread Pool object
      * 
      * @param thread_count number of threads
+     * @param pin_workers if true, workers are pinned to physical cores, grouped by socket
      */
     explicit
-    ThreadPool(uint32_t thread_count)
+    ThreadPool(uint32_t thread_count, bool pin_workers = false)
         : m_thread_count{thread_count}
+        , m_topology{CpuTopology::detect()}
+        , m_pinned{pin_workers}
     {
         m_workers.reserve(thread_count);
         for (uint32_t i{thread_count}; i--;) {
-            m_workers.emplace_back(m_queue, static_cast<uint32_t>(m_workers.size()));
+            const auto id  = static_cast<uint32_t>(m_workers.size());
+            const auto cpu = pin_workers ? static_cast<int32_t>(m_topology.getWorkerCpu(id)) : -1;
+            m_workers.emplace_back(m_queue, id, cpu);
         }
     }
 
+    /**
+     * @brief Construct a pool without threads, tasks run on the calling thread
+     * 
+     * Users see a single worker, allowing solvers to run as tasks of another pool
+     * without spawning threads of their own.
+     */
+    explicit
+    ThreadPool(Inline)
+        : m_thread_count{1}
+        , m_inline{true}
+    {}
+
     /**
      * @brief Destroy the Thread Pool object
      */
@@ -166,7 +254,32 @@ struct ThreadPool
     template<typename TCallback>
     void addTask(TCallback&& callback)
     {
-        m_queue.addTask(std::forward<TCallback>(callback));
+        if (m_inline) {
+            callback();
+        } else {
+            m_queue.addTask(std::forward<TCallback>(callback));
+        }
+    }
+
+    /**
+     * @brief Add a task meant for a given worker, it is bound to it only when workers are pinned
+     * 
+     * Used by tasks that always process the same part of the data, so the memory they
+     * touch stays close to the core running them.
+     * 
+     * @param owner index of the worker, wrapped around the thread count, or any_worker
+     * @param callback callback to add
+     */
+    template<typename TCallback>
+    void addTask(uint32_t owner, TCallback&& callback)
+    {
+        if (m_inline) {
+            callback();
+        } else if (m_pinned && owner != any_worker) {
+            m_workers[owner % m_thread_count].m_local_queue->addTask(std::forward<TCallback>(callback));
+        } else {
+            m_queue.addTask(std::forward<TCallback>(callback));
+        }
     }
 
     /**
@@ -185,21 +298,85 @@ struct ThreadPool
      */
     template<typename TCallback>
     void dispatch(uint32_t element_count, TCallback&& callback)
+    {
+        dispatchIndexed(element_count, [&callback](uint32_t, uint32_t start, uint32_t end) {
+            callback(start, end);
+        });
+    }
+
+    /**
+     * @brief Dispatch a task to the workers, the callback also receives its batch index
+     * 
+     * Batch indices are lower than getBatchCount() and can be used to address per batch
+     * data like reduction accumulators without synchronization.
+     * 
+     * @tparam TCallback callback type
+     * @param callback callback to dispatch, called with (batch index, start, end)
+     */
+    template<typename TCallback>
+    void dispatchIndexed(uint32_t element_count, TCallback&& callback)
     {
         const uint32_t batch_size = element_count / m_thread_count;
         for (uint32_t i{0}; i < m_thread_count; ++i) {
             const uint32_t start = batch_size * i;
             const uint32_t end   = start + batch_size;
-            addTask([start, end, &callback](){ callback(start, end); });
+            addTask(i, [i, start, end, &callback](){ callback(i, start, end); });
         }
 
         if (batch_size * m_thread_count < element_count) {
             const uint32_t start = batch_size * m_thread_count;
-            callback(start, element_count);
+            callback(m_thread_count, start, element_count);
         }
 
         waitForCompletion();
     }
+
+    /**
+     * @brief Move the pages of an array close to the workers processing its batches
+     * 
+     * Pages are allocated on the memory node of the thread touching them first, arrays allocated
+     * by the main thread all end up on its socket. Each batch releases the whole pages it covers
+     * and writes its elements back, so they are allocated again near the worker owning the batch.
+     * Only has an effect on Linux with pinned workers, the content is preserved.
+     * 
+     * @param data first element of the array
+     * @param count number of elements
+     */
+    template<typename T>
+    void firstTouch(T* data, uint32_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Elements are copied as raw bytes");
+#ifdef __linux__
+        if (!m_pinned) {
+            return;
+        }
+        const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        dispatch(count, [&](uint32_t start, uint32_t end) {
+            // Only whole pages, pages shared with another batch are left in place
+            const auto first = (reinterpret_cast<uintptr_t>(data + start) + page_size - 1) / page_size * page_size;
+            const auto last  = reinterpret_cast<uintptr_t>(data + end) / page_size * page_size;
+            if (first >= last) {
+                return;
+            }
+            std::vector<uint8_t> copy(last - first);
+            std::memcpy(copy.data(), reinterpret_cast<void*>(first), copy.size());
+            madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+            std::memcpy(reinterpret_cast<void*>(first), copy.data(), copy.size());
+        });
+#else
+        (void)data;
+        (void)count;
+#endif
+    }
+
+    /**
+     * @brief Maximum number of batches created by dispatchIndexed
+     */
+    [[nodiscard]]
+    uint32_t getBatchCount() const
+    {
+        return m_thread_count + 1;
+    }
 };
 
 }
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+
+namespace tp
+{
+
+/**
+ * @brief Physical cores of the machine and the logical CPUs (hyper-threads) they host
+ *
+ * Read from /sys on Linux, every logical CPU is its own core elsewhere.
+ */
+struct CpuTopology
+{
+    struct Core
+    {
+        uint32_t              package = 0;
+        uint32_t              core    = 0;
+        std::vector<uint32_t> cpus;
+    };
+
+    // Sorted by package then core, so consecutive cores share a socket
+    std::vector<Core> cores;
+    uint32_t          package_count = 1;
+    uint32_t          logical_count = 0;
+
+    /**
+     * @brief Detect the topology of the machine
+     */
+    static CpuTopology detect()
+    {
+        CpuTopology topology;
+        const uint32_t hardware_count = std::max(std::thread::hardware_concurrency(), 1u);
+        for (const uint32_t cpu : readOnlineCpus(hardware_count)) {
+            const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            uint32_t package = 0;
+            uint32_t core    = cpu;
+            // Missing files, the CPU is its own core
+            if (readValue(path + "physical_package_id", package)) {
+                readValue(path + "core_id", core);
+            }
+            topology.addCpu(package, core, cpu);
+        }
+        std::sort(topology.cores.begin(), topology.cores.end(), [](const Core& a, const Core& b) {
+            return a.package != b.package ? a.package < b.package : a.core < b.core;
+        });
+        return topology;
+    }
+
+    [[nodiscard]]
+    uint32_t getPhysicalCoreCount() const
+    {
+        return std::max(static_cast<uint32_t>(cores.size()), 1u);
+    }
+
+    /**
+     * @brief Logical CPU a worker is pinned to, the first hyper-thread of each core, then the second ones
+     *
+     * @param worker_idx index of the worker
+     */
+    [[nodiscard]]
+    uint32_t getWorkerCpu(uint32_t worker_idx) const
+    {
+        const uint32_t core_count = getPhysicalCoreCount();
+        const Core&    core       = cores[worker_idx % core_count];
+        return core.cpus[(worker_idx / core_count) % core.cpus.size()];
+    }
+
+private:
+    void addCpu(uint32_t package, uint32_t core_id, uint32_t cpu)
+    {
+        ++logical_count;
+        package_count = std::max(package_count, package + 1);
+        for (Core& core : cores) {
+            if (core.package == package && core.core == core_id) {
+                core.cpus.push_back(cpu);
+                return;
+            }
+        }
+        cores.push_back({package, core_id, {cpu}});
+    }
+
+    static bool readValue(const std::string& path, uint32_t& value)
+    {
+        std::ifstream file(path);
+        return static_cast<bool>(file >> value);
+    }
+
+    /**
+     * @brief Parse /sys/devices/system/cpu/online, a list of ranges like "0-3,8-11"
+     */
+    static std::vector<uint32_t> readOnlineCpus(uint32_t hardware_count)
+    {
+        std::vector<uint32_t> cpus;
+        std::ifstream file("/sys/devices/system/cpu/online");
+        std::string   range;
+        while (std::getline(file, range, ',')) {
+            const size_t   dash  = range.find('-');
+            const uint32_t first = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+            const uint32_t last  = dash == std::string::npos ? first : static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+            for (uint32_t cpu{first}; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (cpus.empty()) {
+            for (uint32_t cpu{0}; cpu < hardware_count; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+};
+
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "engine/common/index_vector.hpp"
+#include "physics/collision_grid.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+/**
+ * Microbenchmarks of the core containers, headless.
+ * Usage: VerletBenchmarks [--quick], --quick runs small sizes only, used as a smoke test by ctest.
+ */
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the optimizer from removing the measured work
+volatile uint64_t sink = 0;
+
+/**
+ * @brief Best time of several runs of a function, in nanoseconds per operation
+ *
+ * @param repetitions number of runs
+ * @param operations number of operations done by one run
+ * @param callback run to measure
+ */
+template<typename TCallback>
+double measure(uint32_t repetitions, uint64_t operations, TCallback&& callback)
+{
+    double best = 0.0;
+    for (uint32_t i{0}; i < repetitions; ++i) {
+        const auto start = Clock::now();
+        callback();
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        best = i ? std::min(best, ns) : ns;
+    }
+    return best / static_cast<double>(std::max(operations, uint64_t{1}));
+}
+
+void printResult(const std::string& name, const std::string& parameters, double ns_per_op)
+{
+    std::cout << std::left << std::setw(24) << name
+              << std::setw(32) << parameters
+              << std::right << std::fixed << std::setprecision(2) << std::setw(12) << ns_per_op << " ns/op" << std::endl;
+}
+
+// tp::ThreadPool
+
+void benchmarkDispatch(bool quick)
+{
+    const uint32_t rounds = quick ? 100 : 10000;
+    std::vector<uint32_t> thread_counts = {1, 2, 4};
+    const uint32_t hardware_count = tp::CpuTopology::detect().getPhysicalCoreCount();
+    if (std::find(thread_counts.begin(), thread_counts.end(), hardware_count) == thread_counts.end()) {
+        thread_counts.push_back(hardware_count);
+    }
+    for (const uint32_t thread_count : thread_counts) {
+        tp::ThreadPool pool{thread_count};
+        // Round trip of an empty dispatch, the cost paid by each parallel phase of a sub step
+        const double dispatch_ns = measure(5, rounds, [&] {
+            for (uint32_t i{0}; i < rounds; ++i) {
+                pool.dispatch(thread_count, [](uint32_t start, uint32_t end) {
+                    sink = sink + end - start;
+                });
+            }
+        });
+        printResult("dispatch", std::to_string(thread_count) + " threads", dispatch_ns);
+        // Single task added then waited for
+        const double task_ns = measure(5, rounds, [&] {
+            for (uint32_t i{0}; i < rounds; ++i) {
+                pool.addTask([] { sink = sink + 1; });
+                pool.waitForCompletion();
+            }
+        });
+        printResult("add_task_wait", std::to_string(thread_count) + " threads", task_ns);
+    }
+}
+
+// civ::Vector
+
+struct Particle
+{
+    float    position[2]      = {};
+    float    last_position[2] = {};
+    float    radius           = 0.5f;
+    uint32_t color            = 0;
+};
+
+template<typename TStorage>
+void benchmarkEmplaceBack(const std::string& storage_name, uint32_t count, bool reserve)
+{
+    const double ns = measure(5, count, [&] {
+        civ::Vector<Particle, TStorage> vector;
+        if (reserve) {
+            vector.reserve(count);
+        }
+        for (uint32_t i{0}; i < count; ++i) {
+            vector.emplace_back();
+        }
+        sink = sink + vector.size();
+    });
+    printResult("emplace_back", storage_name + (reserve ? " reserved " : " ") + std::to_string(count), ns);
+}
+
+// Reuse of the freed slots, the path taken when atoms are removed and created each frame
+template<typename TStorage>
+void benchmarkEraseEmplace(const std::string& storage_name, uint32_t count)
+{
+    civ::Vector<Particle, TStorage> vector;
+    for (uint32_t i{0}; i < count; ++i) {
+        vector.emplace_back();
+    }
+    std::mt19937 generator{1};
+    const double ns = measure(5, count, [&] {
+        for (uint32_t i{0}; i < count; ++i) {
+            vector.eraseViaData(generator() % vector.size());
+            vector.emplace_back();
+        }
+    });
+    printResult("erase_emplace", storage_name + " " + std::to_string(count), ns);
+}
+
+void benchmarkVector(bool quick)
+{
+    const std::vector<uint32_t> counts = quick ? std::vector<uint32_t>{10000} : std::vector<uint32_t>{10000, 1000000};
+    for (const uint32_t count : counts) {
+        for (const bool reserve : {false, true}) {
+            benchmarkEmplaceBack<civ::ContiguousStorage<>>("contiguous", count, reserve);
+            benchmarkEmplaceBack<civ::PagedStorage<>>("paged", count, reserve);
+        }
+        benchmarkEraseEmplace<civ::ContiguousStorage<>>("contiguous", count);
+        benchmarkEraseEmplace<civ::PagedStorage<>>("paged", count);
+    }
+}
+
+// CollisionGrid
+
+struct AtomPosition
+{
+    uint32_t x, y;
+};
+
+/**
+ * @brief Random atoms filling the grid, optionally sorted by column like the solver keeps them
+ */
+std::vector<AtomPosition> generateAtoms(int32_t size, uint32_t count, bool sorted)
+{
+    std::mt19937 generator{static_cast<uint32_t>(size)};
+    std::uniform_int_distribution<uint32_t> coordinate{1, static_cast<uint32_t>(size - 2)};
+    std::vector<AtomPosition> atoms(count);
+    for (AtomPosition& atom : atoms) {
+        atom = {coordinate(generator), coordinate(generator)};
+    }
+    if (sorted) {
+        std::sort(atoms.begin(), atoms.end(), [](const AtomPosition& a, const AtomPosition& b) {
+            return a.x != b.x ? a.x < b.x : a.y < b.y;
+        });
+    }
+    return atoms;
+}
+
+template<typename TLayout>
+void benchmarkGrid(const std::string& layout_name, int32_t size)
+{
+    BasicCollisionGrid<TLayout> grid{size, size};
+    // Two atoms per cell on average, as in a settled fluid
+    const uint32_t count = static_cast<uint32_t>(size) * static_cast<uint32_t>(size) * 2;
+    const std::string parameters = layout_name + " " + std::to_string(size) + "^2";
+
+    for (const bool sorted : {false, true}) {
+        const std::vector<AtomPosition> atoms = generateAtoms(size, count, sorted);
+        const double build_ns = measure(5, count, [&] {
+            grid.clear();
+            uint32_t dropped = 0;
+            for (uint32_t i{0}; i < count; ++i) {
+                dropped += !grid.addAtom(atoms[i].x, atoms[i].y, i);
+            }
+            sink = sink + dropped;
+        });
+        printResult("grid_build", parameters + (sorted ? " sorted" : " random"), build_ns);
+    }
+
+    // Atoms count of the 3x3 neighborhood of each inner cell, visited in memory order
+    const double lookup_ns = measure(5, grid.data.size(), [&] {
+        uint64_t total = 0;
+        grid.layout.forEachCell(0, grid.layout.getColumnGroupCount(), [&](uint32_t index, uint32_t x, uint32_t y) {
+            if (x - 1 < static_cast<uint32_t>(size - 2) && y - 1 < static_cast<uint32_t>(size - 2)) {
+                for (const uint32_t neighbor : grid.layout.getNeighbors(index, x, y)) {
+                    total += grid.data[neighbor].objects_count;
+                }
+            }
+        });
+        sink = sink + total;
+    });
+    printResult("grid_lookup", parameters, lookup_ns);
+}
+
+void benchmarkGrids(bool quick)
+{
+    const std::vector<int32_t> sizes = quick ? std::vector<int32_t>{64} : std::vector<int32_t>{64, 256, 1024, 2048};
+    for (const int32_t size : sizes) {
+        benchmarkGrid<ColumnMajorLayout>("column_major", size);
+        benchmarkGrid<TiledLayout<3>>("tiled_8", size);
+    }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+    benchmarkDispatch(quick);
+    benchmarkVector(quick);
+    benchmarkGrids(quick);
+    return 0;
+}
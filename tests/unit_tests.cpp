@@ -0,0 +1,1021 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "engine/common/arena.hpp"
+#include "engine/common/index_vector.hpp"
+#include "batch/batch_runner.hpp"
+#include "distributed/slab_domain.hpp"
+#include "physics/collision_grid.hpp"
+#include "physics/compact_solver.hpp"
+#include "physics/physics.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+/**
+ * Correctness tests of the core containers, run by ctest.
+ * Each test returns normally, failed checks are reported and counted.
+ */
+
+namespace
+{
+
+uint32_t failed_checks = 0;
+
+void check(bool condition, const char* expression, const char* file, int line)
+{
+    if (!condition) {
+        ++failed_checks;
+        std::cout << file << ":" << line << ": check failed: " << expression << std::endl;
+    }
+}
+
+#define CHECK(expression) check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+struct Item
+{
+    int32_t value = -1;
+
+    Item() = default;
+
+    explicit
+    Item(int32_t value_)
+        : value{value_}
+    {}
+};
+
+// civ::Vector
+
+template<typename TStorage>
+void testVectorIDs()
+{
+    civ::Vector<Item, TStorage> vector;
+    std::vector<civ::ID> ids;
+    for (int32_t i{0}; i < 10; ++i) {
+        ids.push_back(vector.emplace_back(i));
+    }
+    CHECK(vector.size() == 10);
+    for (int32_t i{0}; i < 10; ++i) {
+        CHECK(ids[i] == static_cast<civ::ID>(i));
+        CHECK(vector[ids[i]].value == i);
+    }
+    // Erasing moves the last object in the hole, IDs keep pointing to their objects
+    vector.erase(ids[3]);
+    vector.erase(ids[0]);
+    CHECK(vector.size() == 8);
+    for (int32_t i{0}; i < 10; ++i) {
+        if (i != 0 && i != 3) {
+            CHECK(vector[ids[i]].value == i);
+        }
+    }
+    // Data stays packed
+    std::set<int32_t> values;
+    for (const Item& item : vector) {
+        values.insert(item.value);
+    }
+    CHECK(values == (std::set<int32_t>{1, 2, 4, 5, 6, 7, 8, 9}));
+    for (uint64_t i{0}; i < vector.size(); ++i) {
+        CHECK(vector[vector.getID(i)].value == vector.data[i].value);
+    }
+    // Freed IDs are reused, the other ones are untouched
+    const civ::ID reused_1 = vector.emplace_back(100);
+    const civ::ID reused_2 = vector.emplace_back(101);
+    CHECK((std::set<civ::ID>{reused_1, reused_2}) == (std::set<civ::ID>{ids[0], ids[3]}));
+    CHECK(vector[reused_1].value == 100);
+    CHECK(vector[reused_2].value == 101);
+    CHECK(vector[ids[9]].value == 9);
+}
+
+template<typename TStorage>
+void testVectorStaleErase()
+{
+    civ::Vector<Item, TStorage> vector;
+    std::vector<civ::ID> ids;
+    for (int32_t i{0}; i < 4; ++i) {
+        ids.push_back(vector.emplace_back(i));
+    }
+    const civ::ID validity = vector.getValidityID(ids[1]);
+    CHECK(vector.erase(ids[1]));
+    // Erasing twice does not remove the object moved in the freed slot
+    CHECK(!vector.erase(ids[1]));
+    CHECK(!vector.erase(100));
+    CHECK(vector.size() == 3);
+    CHECK(vector[ids[3]].value == 3);
+    // Once the ID is reused, the old validity ID does not match anymore
+    const civ::ID reused = vector.emplace_back(10);
+    CHECK(reused == ids[1]);
+    CHECK(!vector.erase(ids[1], validity));
+    CHECK(vector.size() == 4);
+    CHECK(vector[reused].value == 10);
+    CHECK(vector.erase(reused, vector.getValidityID(reused)));
+    CHECK(vector.size() == 3);
+}
+
+template<typename TStorage>
+void testVectorRefs()
+{
+    civ::Vector<Item, TStorage> vector;
+    std::vector<civ::ID> ids;
+    for (int32_t i{0}; i < 5; ++i) {
+        ids.push_back(vector.emplace_back(i));
+    }
+    auto ref_1    = vector.createRef(ids[1]);
+    auto ref_4    = vector.createRef(ids[4]);
+    auto pref_1   = vector.template createPRef<Item>(ids[1]);
+    auto pref_4   = vector.template createPRef<Item>(ids[4]);
+    const decltype(ref_1) empty_ref;
+    CHECK(!empty_ref);
+    CHECK(ref_1 && pref_1 && ref_4 && pref_4);
+    // The last object is moved in the erased slot, its references stay valid
+    vector.erase(ids[1]);
+    CHECK(!ref_1);
+    CHECK(!pref_1);
+    CHECK(ref_4);
+    CHECK(pref_4);
+    CHECK(ref_4->value == 4);
+    CHECK((*pref_4).value == 4);
+    // Reusing the ID does not revive the old references
+    const civ::ID reused = vector.emplace_back(10);
+    CHECK(reused == ids[1]);
+    CHECK(!ref_1);
+    CHECK(!pref_1);
+    auto ref_reused = vector.createRef(reused);
+    CHECK(ref_reused);
+    CHECK(ref_reused->value == 10);
+    // Removal through the data index
+    vector.eraseViaData(vector.getDataID(ids[4]));
+    CHECK(!ref_4);
+    CHECK(!pref_4);
+    CHECK(ref_reused);
+    CHECK(vector[ids[0]].value == 0);
+}
+
+template<typename TStorage>
+void testVectorRemoveIf()
+{
+    civ::Vector<Item, TStorage> vector;
+    std::vector<civ::ID> ids;
+    for (int32_t i{0}; i < 100; ++i) {
+        ids.push_back(vector.emplace_back(i));
+    }
+    std::vector<civ::Ref<Item, TStorage>> refs;
+    for (const civ::ID id : ids) {
+        refs.push_back(vector.createRef(id));
+    }
+    const uint64_t removed = vector.remove_if([](const Item& item) { return item.value % 3 == 0; });
+    CHECK(removed == 34);
+    CHECK(vector.size() == 66);
+    for (int32_t i{0}; i < 100; ++i) {
+        const bool kept = i % 3 != 0;
+        CHECK(static_cast<bool>(refs[i]) == kept);
+        if (kept) {
+            CHECK(vector[ids[i]].value == i);
+        }
+    }
+    // Allocation reuses the freed slots first, in a default state
+    const uint64_t first = vector.allocate(40);
+    CHECK(first == 66);
+    CHECK(vector.size() == 106);
+    for (uint64_t i{first}; i < vector.size(); ++i) {
+        CHECK(vector.data[i].value == -1);
+        CHECK(vector.getDataID(vector.getID(i)) == i);
+    }
+    for (int32_t i{0}; i < 100; ++i) {
+        CHECK(static_cast<bool>(refs[i]) == (i % 3 != 0));
+    }
+}
+
+template<typename TStorage>
+void testVector()
+{
+    testVectorIDs<TStorage>();
+    testVectorStaleErase<TStorage>();
+    testVectorRefs<TStorage>();
+    testVectorRemoveIf<TStorage>();
+}
+
+// civ::PagedArray and civ::Arena
+
+void testPagedArrayIterator()
+{
+    civ::PagedArray<int32_t, 2> array;
+    for (int32_t i{0}; i < 37; ++i) {
+        array.push_back((i * 17) % 37);
+    }
+    // Random access algorithms across pages
+    std::sort(array.begin(), array.end());
+    CHECK(std::is_sorted(array.begin(), array.end()));
+    CHECK(array[0] == 0 && array[36] == 36);
+    const auto first = array.begin();
+    const auto last  = array.end();
+    CHECK(last > first && first < last && first <= first && last >= first);
+    CHECK(2 + first == first + 2);
+    CHECK(*(5 + first) == 5);
+    CHECK(std::lower_bound(first, last, 20) - first == 20);
+}
+
+void testArenaReleasedBytes()
+{
+    civ::Arena arena{1024};
+    {
+        // Reserved to the final capacity, nothing is left behind
+        civ::Vector<Item, civ::ContiguousStorage<civ::ArenaAllocator>> vector{civ::ArenaAllocator<Item>{arena}};
+        vector.reserve(100);
+        for (int32_t i{0}; i < 100; ++i) {
+            vector.emplace_back(i);
+        }
+        CHECK(arena.getReleasedBytes() == 0);
+        CHECK(vector[civ::ID{99}].value == 99);
+        // Growing leaves the previous buffers in the arena
+        vector.emplace_back(100);
+        CHECK(arena.getReleasedBytes() >= 100 * sizeof(Item));
+    }
+    {
+        civ::Vector<Item, civ::PagedStorage<4, civ::ArenaAllocator>> vector{civ::ArenaAllocator<Item>{arena}};
+        const uint64_t released = arena.getReleasedBytes();
+        for (int32_t i{0}; i < 64; ++i) {
+            vector.emplace_back(i);
+        }
+        // Pages are kept, only the page table may be reallocated
+        CHECK(arena.getReleasedBytes() - released < 64 * sizeof(Item));
+        CHECK(vector[civ::ID{63}].value == 63);
+    }
+}
+
+// CollisionCell and CollisionGrid
+
+void testCollisionCellOverflow()
+{
+    CollisionCell cell;
+    for (uint32_t i{0}; i < CollisionCell::max_cell_idx; ++i) {
+        CHECK(cell.addAtom(i + 10));
+    }
+    CHECK(cell.objects_count == CollisionCell::max_cell_idx);
+    // Atoms past the capacity are dropped, the stored ones are preserved
+    CHECK(!cell.addAtom(20));
+    CHECK(!cell.addAtom(21));
+    CHECK(cell.objects_count == CollisionCell::max_cell_idx);
+    for (uint32_t i{0}; i < CollisionCell::max_cell_idx; ++i) {
+        CHECK(cell.objects[i] == i + 10);
+    }
+    // Removing makes room again
+    cell.remove(11);
+    CHECK(cell.objects_count == CollisionCell::max_cell_idx - 1);
+    CHECK(cell.addAtom(22));
+    std::set<uint32_t> stored{cell.objects, cell.objects + cell.objects_count};
+    CHECK(stored == (std::set<uint32_t>{10, 12, 22}));
+    cell.clear();
+    CHECK(cell.objects_count == 0);
+    CHECK(cell.addAtom(30));
+}
+
+template<typename TLayout>
+void testCollisionGrid(int32_t width, int32_t height)
+{
+    BasicCollisionGrid<TLayout> grid{width, height};
+    // Every cell has its own index
+    std::set<uint32_t> indices;
+    for (int32_t x{0}; x < width; ++x) {
+        for (int32_t y{0}; y < height; ++y) {
+            const uint32_t index = grid.layout.getIndex(x, y);
+            CHECK(index < grid.data.size());
+            indices.insert(index);
+        }
+    }
+    CHECK(indices.size() == static_cast<uint64_t>(width) * height);
+    // Neighbors of the inner cells, including the fast paths of the layouts
+    for (int32_t x{1}; x < width - 1; ++x) {
+        for (int32_t y{1}; y < height - 1; ++y) {
+            const auto neighbors = grid.layout.getNeighbors(grid.layout.getIndex(x, y), x, y);
+            std::set<uint32_t> expected;
+            for (int32_t dx{-1}; dx <= 1; ++dx) {
+                for (int32_t dy{-1}; dy <= 1; ++dy) {
+                    expected.insert(grid.layout.getIndex(x + dx, y + dy));
+                }
+            }
+            CHECK(std::set<uint32_t>(neighbors.begin(), neighbors.end()) == expected);
+        }
+    }
+    // Column groups cover the cells in memory order
+    uint32_t next_index = 0;
+    uint32_t visited    = 0;
+    grid.layout.forEachCell(0, grid.layout.getColumnGroupCount(), [&](uint32_t index, uint32_t x, uint32_t y) {
+        CHECK(index == next_index);
+        ++next_index;
+        if (x < static_cast<uint32_t>(width) && y < static_cast<uint32_t>(height)) {
+            CHECK(index == grid.layout.getIndex(x, y));
+            ++visited;
+        }
+    });
+    CHECK(visited == indices.size());
+    // Overflow is reported per cell, clear empties every cell
+    for (uint32_t i{0}; i < CollisionCell::max_cell_idx; ++i) {
+        CHECK(grid.addAtom(1, 2, i));
+    }
+    CHECK(!grid.addAtom(1, 2, 99));
+    CHECK(grid.addAtom(2, 1, 99));
+    CHECK(grid.get(1, 2).objects_count == CollisionCell::max_cell_idx);
+    grid.clear();
+    for (const CollisionCell& cell : grid.data) {
+        CHECK(cell.objects_count == 0);
+    }
+}
+
+// PhysicSolver
+
+float getDistance(const PhysicObject& a, const PhysicObject& b)
+{
+    const Vec2 v = a.position - b.position;
+    return std::sqrt(v.x * v.x + v.y * v.y);
+}
+
+/**
+ * @brief Two atoms closing in, their cells are two apart but they are closer than 1 + skin
+ */
+void testNeighborListReach()
+{
+    for (const bool vertical : {false, true}) {
+        tp::ThreadPool pool{1};
+        PhysicSolver solver{{40, 40}, pool};
+        solver.gravity           = {};
+        solver.use_neighbor_list = true;
+        const Vec2 axis = vertical ? Vec2{0.0f, 1.0f} : Vec2{1.0f, 0.0f};
+        const Vec2 side = vertical ? Vec2{20.5f, 0.0f} : Vec2{0.0f, 20.5f};
+        solver.createObject(side + axis * 11.95f);
+        solver.createObject(side + axis * 13.05f);
+        solver.objects.data[0].last_position -= axis * 0.02f;
+        solver.objects.data[1].last_position += axis * 0.02f;
+        CHECK(solver.usesNeighborList());
+        float min_distance = 2.0f;
+        for (uint32_t frame{0}; frame < 3; ++frame) {
+            solver.update(1.0f / 60.0f);
+            min_distance = std::min(min_distance, getDistance(solver.objects.data[0], solver.objects.data[1]));
+        }
+        CHECK(min_distance > 0.99f);
+    }
+    // Large atoms search the collision grid, lists are not reused while there are any
+    tp::ThreadPool pool{1};
+    PhysicSolver solver{{40, 40}, pool};
+    solver.gravity           = {};
+    solver.use_neighbor_list = true;
+    solver.createObject({20.5f, 20.5f}, 2.0f);
+    solver.createObject({24.0f, 20.5f});
+    solver.objects.data[1].last_position.x += 0.05f;
+    CHECK(!solver.usesNeighborList());
+    float min_distance = 3.0f;
+    for (uint32_t frame{0}; frame < 10; ++frame) {
+        solver.update(1.0f / 60.0f);
+        min_distance = std::min(min_distance, getDistance(solver.objects.data[0], solver.objects.data[1]));
+    }
+    CHECK(min_distance > 2.45f);
+}
+
+/**
+ * @brief Fluid pairs are gathered once, by the atom with the lowest rank, and their terms reach both atoms
+ */
+void testFluidPairs()
+{
+    tp::ThreadPool pool{1};
+    PhysicSolver solver{{24, 24}, pool};
+    for (int32_t x{0}; x < 12; ++x) {
+        for (int32_t y{0}; y < 12; ++y) {
+            solver.createObject({6.3f + 0.9f * to<float>(x) + 0.05f * to<float>(y % 3), 6.1f + 0.9f * to<float>(y)});
+        }
+    }
+    solver.addObjectsToGrid();
+    Fluid& fluid = solver.fluid;
+    fluid.initialize();
+    fluid.resize(to<uint32_t>(solver.objects.size()), solver.grid.width, solver.grid.height);
+    fluid.countAtoms(solver.grid, 0, 24);
+    const uint32_t atoms_count = fluid.computeColumnStarts();
+    fluid.load(solver.grid, solver.objects.data, 0, 24);
+    CHECK(atoms_count == 144);
+    // Slices are the smallest allowed, passes write atoms of the next one
+    const uint32_t slice_count = fluid.getSliceCount(100);
+    CHECK(slice_count == 12);
+    fluid.slices.resize(slice_count);
+    uint32_t pairs_count = 0;
+    for (uint32_t i{0}; i < slice_count; ++i) {
+        fluid.buildSlice(fluid.slices[i], to<int32_t>(24 * i / slice_count), to<int32_t>(24 * (i + 1) / slice_count));
+        fluid.accumulateDensity(fluid.slices[i]);
+        pairs_count += to<uint32_t>(fluid.slices[i].neighbors.size());
+    }
+    const float max_dist2         = fluid.settings.kernel_radius * fluid.settings.kernel_radius;
+    uint32_t    expected_pairs    = 0;
+    float       max_density_error = 0.0f;
+    for (uint32_t i{0}; i < atoms_count; ++i) {
+        float expected_density = fluid.density_kernel.get(0.0f);
+        for (uint32_t j{0}; j < atoms_count; ++j) {
+            const float dx    = fluid.position_x[i] - fluid.position_x[j];
+            const float dy    = fluid.position_y[i] - fluid.position_y[j];
+            const float dist2 = dx * dx + dy * dy;
+            if (i != j && dist2 < max_dist2) {
+                expected_density += fluid.density_kernel.get(dist2);
+                expected_pairs += i < j;
+            }
+        }
+        max_density_error = std::max(max_density_error, std::abs(fluid.sums[i].density - expected_density) / expected_density);
+    }
+    CHECK(pairs_count == expected_pairs);
+    CHECK(max_density_error < 1.0e-5f);
+}
+
+/**
+ * @brief Contacts push an atom across the periodic side of a world with an open side
+ */
+void testMixedBoundaries()
+{
+    for (const BoundaryMode y_mode : {BoundaryMode::Wall, BoundaryMode::Open}) {
+        tp::ThreadPool pool{1};
+        PhysicSolver solver{{20, 20}, pool};
+        solver.gravity    = {};
+        solver.boundaries = {BoundaryMode::Periodic, y_mode};
+        solver.createObject({0.05f, 10.5f});
+        solver.createObject({0.6f, 10.5f});
+        for (uint32_t frame{0}; frame < 10; ++frame) {
+            solver.update(1.0f / 60.0f);
+        }
+        CHECK(solver.objects.size() == 2);
+        for (const PhysicObject& obj : solver.objects) {
+            CHECK(BoundaryConditions::isInside(obj.position, solver.world_size));
+        }
+    }
+    // Atoms past the open side are still removed
+    tp::ThreadPool pool{1};
+    PhysicSolver solver{{20, 20}, pool};
+    solver.boundaries = {BoundaryMode::Periodic, BoundaryMode::Open};
+    solver.createObject({5.5f, 19.8f});
+    solver.objects.data[0].last_position.y -= 0.5f;
+    solver.update(1.0f / 60.0f);
+    CHECK(solver.objects.size() == 0);
+}
+
+// DistanceField
+
+/**
+ * @brief Distances to a disc are negative inside, their gradient points away and atoms are pushed out
+ */
+void testDistanceField()
+{
+    DistanceField field{{20, 20}};
+    CHECK(field.empty);
+    field.addCircle({10.0f, 10.0f}, 3.0f);
+    CHECK(!field.empty);
+    Vec2 gradient;
+    CHECK(std::abs(field.sample({10.0f, 10.0f}, gradient) + 3.0f) < 1.0e-5f);
+    CHECK(std::abs(field.sample({15.0f, 10.0f}, gradient) - 2.0f) < 1.0e-5f);
+    CHECK(gradient.x > 0.9f && std::abs(gradient.y) < 0.1f);
+    // Between nodes the interpolated distance stays close to the exact one
+    const float dist = field.sample({10.5f, 5.5f}, gradient);
+    CHECK(std::abs(dist - (std::sqrt(0.5f * 0.5f + 4.5f * 4.5f) - 3.0f)) < 0.1f);
+    CHECK(gradient.y < -0.9f);
+    // Overlapping atoms end up touching the disc, the other ones are untouched
+    Vec2 position{12.2f, 10.4f};
+    field.solveCollision(position, 0.5f);
+    const Vec2 offset = position - Vec2{10.0f, 10.0f};
+    CHECK(std::abs(std::sqrt(offset.x * offset.x + offset.y * offset.y) - 3.5f) < 0.1f);
+    Vec2 free_position{16.0f, 16.0f};
+    field.solveCollision(free_position, 0.5f);
+    CHECK(free_position.x == 16.0f && free_position.y == 16.0f);
+    field.clear();
+    CHECK(field.empty);
+    CHECK(field.sample({10.0f, 10.0f}, gradient) > 3.0f);
+}
+
+// BodyCells
+
+/**
+ * @brief Each touched cell lists the bodies whose bounding box, grown by the margin, overlaps it
+ */
+void testBodyCells()
+{
+    tp::ThreadPool pool{1};
+    PhysicSolver solver{{20, 20}, pool};
+    const auto& grid = solver.grid;
+    std::vector<RigidBody> bodies;
+    bodies.push_back(RigidBody::makeCircle({6.0f, 6.0f}, 2.0f, 1.0f));
+    bodies.push_back(RigidBody::makeCircle({9.0f, 7.0f}, 1.5f, 0.0f));
+    // Clipped to the cells atoms can be stored in
+    bodies.push_back(RigidBody::makeCircle({1.0f, 17.0f}, 3.0f, 1.0f));
+    BodyCells cells;
+    for (const uint32_t body_count : {3u, 1u}) {
+        bodies.resize(body_count);
+        cells.build(grid, bodies, 0.5f);
+        std::vector<std::set<uint32_t>> expected(grid.data.size());
+        for (uint32_t b{0}; b < body_count; ++b) {
+            for (int32_t x{1}; x < grid.width - 1; ++x) {
+                for (int32_t y{1}; y < grid.height - 1; ++y) {
+                    const RigidBody& body = bodies[b];
+                    if (to<float>(x + 1) > body.aabb_min.x - 0.5f && to<float>(x) <= body.aabb_max.x + 0.5f &&
+                        to<float>(y + 1) > body.aabb_min.y - 0.5f && to<float>(y) <= body.aabb_max.y + 0.5f) {
+                        expected[grid.layout.getIndex(x, y)].insert(b);
+                    }
+                }
+            }
+        }
+        const auto touched_count = to<uint32_t>(cells.touched_cells.size());
+        CHECK(cells.offsets.size() == touched_count + 1);
+        CHECK(cells.offsets.front() == 0 && cells.offsets.back() == cells.bodies.size());
+        std::set<uint32_t> touched;
+        for (uint32_t i{0}; i < touched_count; ++i) {
+            CHECK(cells.offsets[i] < cells.offsets[i + 1]);
+            const uint32_t cell = cells.touched_cells[i];
+            const std::set<uint32_t> cell_bodies(cells.bodies.begin() + cells.offsets[i], cells.bodies.begin() + cells.offsets[i + 1]);
+            CHECK(cell_bodies.size() == cells.offsets[i + 1] - cells.offsets[i]);
+            CHECK(cell_bodies == expected[cell]);
+            touched.insert(cell);
+        }
+        // Cells left over from the previous build are not listed anymore
+        uint32_t expected_count = 0;
+        for (const std::set<uint32_t>& cell_bodies : expected) {
+            expected_count += !cell_bodies.empty();
+        }
+        CHECK(touched.size() == touched_count);
+        CHECK(touched_count == expected_count);
+    }
+}
+
+// GridQuery
+
+/**
+ * @brief Radius, box and nearest queries find the same atoms as a brute force scan, rays stop at the first atom
+ */
+void testGridQuery()
+{
+    tp::ThreadPool pool{1};
+    PhysicSolver solver{{40, 40}, pool};
+    solver.gravity = {};
+    std::vector<Vec2> positions;
+    for (int32_t x{0}; x < 14; ++x) {
+        for (int32_t y{0}; y < 14; ++y) {
+            positions.push_back({3.2f + 2.4f * to<float>(x) + 0.3f * to<float>(y % 4), 3.7f + 2.4f * to<float>(y) + 0.2f * to<float>(x % 3)});
+        }
+    }
+    const auto count = to<uint32_t>(positions.size());
+    solver.createObjects(positions.data(), nullptr, nullptr, count);
+    solver.update(1.0f / 60.0f);
+    const std::vector<PhysicObject>& objects = solver.objects.data;
+    std::vector<uint32_t> results(count);
+
+    RadiusQuery radius_query{{17.3f, 21.9f}, 6.5f, results.data(), count};
+    solver.query(radius_query);
+    std::set<uint32_t> expected;
+    for (uint32_t i{0}; i < count; ++i) {
+        const Vec2 v = objects[i].position - radius_query.center;
+        if (v.x * v.x + v.y * v.y <= radius_query.radius * radius_query.radius) {
+            expected.insert(i);
+        }
+    }
+    CHECK(!expected.empty());
+    CHECK(radius_query.count == expected.size());
+    CHECK(std::set<uint32_t>(results.begin(), results.begin() + radius_query.count) == expected);
+    // Truncated results still report the number of atoms found
+    RadiusQuery truncated_query{radius_query.center, radius_query.radius, results.data(), 2};
+    solver.query(truncated_query);
+    CHECK(truncated_query.count == expected.size());
+
+    BoxQuery box_query{{8.1f, 30.4f}, {19.6f, 37.0f}, results.data(), count};
+    solver.query(box_query);
+    expected.clear();
+    for (uint32_t i{0}; i < count; ++i) {
+        const Vec2 p = objects[i].position;
+        if (p.x >= box_query.box_min.x && p.x <= box_query.box_max.x && p.y >= box_query.box_min.y && p.y <= box_query.box_max.y) {
+            expected.insert(i);
+        }
+    }
+    CHECK(!expected.empty());
+    CHECK(box_query.count == expected.size());
+    CHECK(std::set<uint32_t>(results.begin(), results.begin() + box_query.count) == expected);
+
+    std::vector<float> distances2(5);
+    NearestQuery nearest_query{{25.1f, 9.8f}, 10.0f, 5, results.data(), distances2.data()};
+    solver.query(nearest_query);
+    std::vector<std::pair<float, uint32_t>> sorted;
+    for (uint32_t i{0}; i < count; ++i) {
+        const Vec2 v = objects[i].position - nearest_query.center;
+        sorted.emplace_back(v.x * v.x + v.y * v.y, i);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    CHECK(nearest_query.count == 5);
+    for (uint32_t i{0}; i < nearest_query.count; ++i) {
+        CHECK(results[i] == sorted[i].second);
+        CHECK(std::abs(distances2[i] - sorted[i].first) < 1.0e-4f);
+    }
+
+    // Along a row, the ray hits the first atom overlapping its line
+    const float radius = AtomShape{}.radius;
+    for (const float ray_y : {objects[20].position.y, objects[20].position.y + 0.4f}) {
+        RaycastQuery ray_query{{1.5f, ray_y}, {2.0f, 0.0f}, 100.0f};
+        solver.query(ray_query);
+        float    first_distance = 100.0f;
+        uint32_t first_atom     = count;
+        for (uint32_t i{0}; i < count; ++i) {
+            const Vec2  p  = objects[i].position;
+            const float dy = p.y - ray_y;
+            if (std::abs(dy) < radius) {
+                const float hit = p.x - 1.5f - std::sqrt(radius * radius - dy * dy);
+                if (hit < first_distance) {
+                    first_distance = hit;
+                    first_atom     = i;
+                }
+            }
+        }
+        CHECK(first_atom < count);
+        CHECK(ray_query.hit && ray_query.atom == first_atom);
+        CHECK(std::abs(ray_query.distance - first_distance) < 1.0e-3f);
+    }
+    RaycastQuery miss_query{{1.5f, 1.5f}, {1.0f, 0.0f}, 100.0f};
+    solver.query(miss_query);
+    CHECK(!miss_query.hit);
+}
+
+// ForceFieldSet
+
+/**
+ * @brief Fields are only listed in the tiles their disc reaches, atoms elsewhere do not evaluate them
+ */
+void testForceFieldTiles()
+{
+    const Vec2 world_size{64.0f, 40.0f};
+    ForceFieldSet set;
+    CHECK(set.add(ForceField::makeAttractor({12.0f, 12.0f}, 5.0f, 10.0f)));
+    CHECK(set.add(ForceField::makeVortex({40.0f, 30.0f}, 3.0f, 10.0f, 0.1f)));
+    set.update(world_size);
+    constexpr int32_t tile_size = ForceFieldSet::tile_size;
+    CHECK(set.tiles_x == 9 && set.tiles_y == 6);
+    for (int32_t x{0}; x < set.tiles_x; ++x) {
+        for (int32_t y{0}; y < set.tiles_y; ++y) {
+            uint64_t expected = 0;
+            for (uint32_t i{0}; i < set.fields.size(); ++i) {
+                const ForceField& field = set.fields[i];
+                const bool overlaps_x = to<float>(x * tile_size) <= field.center.x + field.radius && to<float>((x + 1) * tile_size) > field.center.x - field.radius;
+                const bool overlaps_y = to<float>(y * tile_size) <= field.center.y + field.radius && to<float>((y + 1) * tile_size) > field.center.y - field.radius;
+                expected |= uint64_t{overlaps_x && overlaps_y} << i;
+            }
+            CHECK(set.tile_masks[x * set.tiles_y + y] == expected);
+        }
+    }
+    // Inside the disc the field of the tile applies, outside of its tiles nothing is evaluated
+    const Vec2 inside{14.0f, 12.0f};
+    const Vec2 acceleration = set.getAcceleration(inside);
+    CHECK(acceleration.x < 0.0f && acceleration.x == set.fields[0].getAcceleration(inside).x);
+    const Vec2 outside = set.getAcceleration({30.0f, 20.0f});
+    CHECK(outside.x == 0.0f && outside.y == 0.0f);
+    const Vec2 vortex = set.getAcceleration({41.0f, 30.0f});
+    CHECK(vortex.x == 0.0f && vortex.y != 0.0f);
+    // The temporary field expires, its tiles are cleared on the next update
+    set.advance(0.2f);
+    set.update(world_size);
+    CHECK(set.fields.size() == 1);
+    CHECK(set.tile_masks[(40 / tile_size) * set.tiles_y + 30 / tile_size] == 0);
+    const Vec2 expired = set.getAcceleration({41.0f, 30.0f});
+    CHECK(expired.x == 0.0f && expired.y == 0.0f);
+}
+
+// dist::BasicSlabDomain
+
+/**
+ * @brief Messages queued in memory between the ranks of a single process
+ */
+struct LocalNetwork
+{
+    std::mutex                                    mutex;
+    std::condition_variable                       condition;
+    // Indexed by sender * size + receiver
+    std::vector<std::deque<std::vector<uint8_t>>> queues;
+};
+
+struct LocalTransport : public dist::Transport
+{
+    LocalNetwork& network;
+    uint32_t      rank;
+    uint32_t      size;
+    uint64_t      capacity;
+
+    LocalTransport(LocalNetwork& network_, uint32_t rank_, uint32_t size_, uint64_t capacity_)
+        : network{network_}
+        , rank{rank_}
+        , size{size_}
+        , capacity{capacity_}
+    {}
+
+    uint32_t getRank() const override
+    {
+        return rank;
+    }
+
+    uint32_t getSize() const override
+    {
+        return size;
+    }
+
+    uint64_t getCapacity() const override
+    {
+        return capacity;
+    }
+
+    bool send(uint32_t peer, const void* data, uint64_t message_size) override
+    {
+        if (message_size > capacity) {
+            return false;
+        }
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        {
+            std::lock_guard<std::mutex> lock{network.mutex};
+            network.queues[rank * size + peer].emplace_back(bytes, bytes + message_size);
+        }
+        network.condition.notify_all();
+        return true;
+    }
+
+    void receive(uint32_t peer, std::vector<uint8_t>& message) override
+    {
+        std::unique_lock<std::mutex> lock{network.mutex};
+        std::deque<std::vector<uint8_t>>& queue = network.queues[peer * size + rank];
+        network.condition.wait(lock, [&] { return !queue.empty(); });
+        message = std::move(queue.front());
+        queue.pop_front();
+    }
+};
+
+/**
+ * @brief Two ranks in threads, an atom migrates across the border and two atoms colliding on it meet through the ghosts
+ */
+void testSlabDomain()
+{
+    const IVec2 world_size{40, 20};
+    LocalNetwork network;
+    network.queues.resize(4);
+    const std::vector<Vec2> positions  = {{18.5f, 14.5f}, {19.45f, 6.5f}, {20.55f, 6.5f}};
+    const std::vector<Vec2> velocities = {{0.05f, 0.0f}, {0.02f, 0.0f}, {-0.02f, 0.0f}};
+    // Global positions of the atoms owned by each rank and their total count, seen by each rank
+    std::vector<Vec2> owned[2];
+    double            total_counts[2] = {0.0, 0.0};
+    bool              updated[2]      = {false, false};
+    auto run = [&](uint32_t rank) {
+        LocalTransport   transport{network, rank, 2, dist::SlabDomain::getMessageCapacity(world_size)};
+        tp::ThreadPool   pool{1};
+        dist::SlabDomain domain{world_size, transport, pool};
+        domain.solver.gravity = {};
+        domain.createObjects(positions.data(), velocities.data(), nullptr, 3);
+        updated[rank] = true;
+        for (uint32_t frame{0}; frame < 20; ++frame) {
+            updated[rank] &= domain.update(1.0f / 60.0f);
+        }
+        for (const PhysicObject& obj : domain.solver.objects) {
+            owned[rank].push_back(obj.position + Vec2{domain.getOffset(), 0.0f});
+        }
+        total_counts[rank] = domain.reduceSum(to<double>(domain.solver.objects.size()));
+    };
+    std::thread other{run, 1};
+    run(0);
+    other.join();
+    CHECK(updated[0] && updated[1]);
+    CHECK(total_counts[0] == 3.0 && total_counts[1] == 3.0);
+    // Ghosts are dropped after each sub step, the migrating atom is owned by the right slab
+    CHECK(owned[0].size() == 1 && owned[1].size() == 2);
+    if (owned[0].size() == 1 && owned[1].size() == 2) {
+        const Vec2 left  = owned[0][0];
+        const Vec2 right = owned[1][0].y < owned[1][1].y ? owned[1][0] : owned[1][1];
+        const Vec2 moved = owned[1][0].y < owned[1][1].y ? owned[1][1] : owned[1][0];
+        CHECK(moved.x > 21.0f && std::abs(moved.y - 14.5f) < 0.01f);
+        // Without ghosts they would cross each other, they stop in contact on both sides of the border
+        CHECK(left.x < 20.0f && right.x > 20.0f);
+        CHECK(right.x - left.x > 0.99f);
+        CHECK(std::abs(left.x + right.x - 40.0f) < 0.01f);
+    }
+}
+
+// tp::ThreadPool
+
+void checkDispatch(tp::ThreadPool& pool, uint32_t element_count)
+{
+    std::vector<std::atomic<uint32_t>> visits(element_count);
+    std::vector<std::atomic<uint32_t>> batch_calls(pool.getBatchCount());
+    std::atomic<uint32_t> invalid_batches{0};
+    pool.dispatchIndexed(element_count, [&](uint32_t batch_idx, uint32_t start, uint32_t end) {
+        if (batch_idx >= pool.getBatchCount() || start > end || end > element_count) {
+            ++invalid_batches;
+            return;
+        }
+        ++batch_calls[batch_idx];
+        for (uint32_t i{start}; i < end; ++i) {
+            ++visits[i];
+        }
+    });
+    CHECK(invalid_batches == 0);
+    // Every element is processed exactly once, the remainder included
+    uint32_t wrong_visits = 0;
+    for (const std::atomic<uint32_t>& count : visits) {
+        wrong_visits += count != 1;
+    }
+    CHECK(wrong_visits == 0);
+    // Each batch index is used at most once, the remainder batch only when there is a remainder
+    for (const std::atomic<uint32_t>& calls : batch_calls) {
+        CHECK(calls <= 1);
+    }
+    const bool has_remainder = element_count % pool.m_thread_count != 0;
+    CHECK(batch_calls[pool.m_thread_count] == static_cast<uint32_t>(has_remainder));
+
+    std::atomic<uint64_t> sum{0};
+    pool.dispatch(element_count, [&](uint32_t start, uint32_t end) {
+        uint64_t local_sum = 0;
+        for (uint32_t i{start}; i < end; ++i) {
+            local_sum += i;
+        }
+        sum += local_sum;
+    });
+    CHECK(sum == static_cast<uint64_t>(element_count) * (element_count - (element_count > 0)) / 2);
+}
+
+void testAtomShapes()
+{
+    tp::ThreadPool pool{1};
+    PhysicSolver solver{{40, 40}, pool};
+    solver.gravity = {};
+    solver.createObject({10.5f, 10.5f});
+    // Larger than the coarsest grid level
+    const uint64_t large = solver.createObject({20.0f, 20.0f}, 20.0f);
+    solver.createObject({30.5f, 30.5f});
+    solver.update(1.0f / 60.0f);
+    CHECK(solver.shapes.size() == solver.objects.size());
+    CHECK(solver.objects[large].position.x == 20.0f);
+    const float max_radius = MultiLevelGrid::getMaxRadius(MultiLevelGrid::level_count - 1);
+    CHECK(solver.getObjectShape(1).radius == max_radius);
+    // The last atom moves to the freed index with its shape
+    CHECK(solver.removeIf([](const PhysicObject& obj) { return obj.position.x < 15.0f; }) == 1);
+    CHECK(solver.shapes.size() == 2);
+    for (uint32_t i{0}; i < solver.objects.size(); ++i) {
+        const bool is_large = solver.objects.data[i].position.x < 25.0f;
+        CHECK(solver.getObjectShape(i).radius == (is_large ? max_radius : AtomShape{}.radius));
+    }
+}
+
+void testSolverCommands()
+{
+    tp::ThreadPool pool{1};
+    PhysicSolver solver{{20, 20}, pool};
+    // Default constructed commands are ignored
+    CHECK(solver.commands.push(SolverCommand{}));
+    solver.update(1.0f / 60.0f);
+    CHECK(!solver.paused);
+    // Commands are rejected once the queue is full
+    uint32_t accepted = 0;
+    while (solver.commands.push(SolverCommand::makeSpawn({10.5f, 10.5f}, AtomShape{}.radius, 0))) {
+        ++accepted;
+    }
+    CHECK(accepted == SolverCommandQueue::capacity);
+    solver.update(1.0f / 60.0f);
+    CHECK(solver.objects.size() == accepted);
+    // An emitted line is created at once, up to the objects limit
+    const emitter::Line line{{2.0f, 2.0f}, {0.0f, 1.1f}, 10};
+    CHECK(solver.commands.push(SolverCommand::makeEmit(line, {0.1f, 0.0f}, 3, accepted + 6)));
+    solver.update(1.0f / 60.0f);
+    CHECK(solver.objects.size() == accepted + 6);
+    CHECK(solver.objects.data[accepted].color == 3);
+    // Bodies are only queued with room for their command, each command takes its own body
+    while (solver.commands.push(SolverCommand::make(SolverCommand::Type::None))) {}
+    CHECK(!solver.commands.pushBody(RigidBody::makeCircle({10.0f, 10.0f}, 2.0f, 1.0f)));
+    solver.update(1.0f / 60.0f);
+    CHECK(solver.commands.pushBody(RigidBody::makeCircle({5.0f, 5.0f}, 2.0f, 1.0f)));
+    CHECK(solver.commands.pushBody(RigidBody::makeCircle({15.0f, 5.0f}, 3.0f, 1.0f)));
+    solver.update(1.0f / 60.0f);
+    CHECK(solver.bodies.size() == 2 && solver.bodies[1].radius == 3.0f);
+}
+
+// Quantized atoms follow the float solver closely, in free flight and in a settling pile
+void testCompactAccuracy()
+{
+    using Config = SolverConfig<UniformRadius>;
+    tp::ThreadPool pool{2};
+    {
+        BasicPhysicSolver<Config>   reference{{40, 40}, pool};
+        CompactPhysicSolver<Config> compact{{40, 40}, pool};
+        std::vector<Vec2> positions;
+        std::vector<Vec2> velocities;
+        for (int32_t k{0}; k < 8; ++k) {
+            positions.push_back({4.3f + 4.0f * to<float>(k), 5.7f + 0.5f * to<float>(k)});
+            velocities.push_back({0.005f * to<float>(k - 4), -0.01f});
+        }
+        reference.createObjects(positions.data(), velocities.data(), nullptr, 8);
+        compact.createObjects(positions.data(), velocities.data(), nullptr, 8);
+        for (uint32_t i{0}; i < 40; ++i) {
+            reference.update(1.0f / 60.0f);
+            compact.update(1.0f / 60.0f);
+        }
+        // The compact solver does not keep the atoms order, match them by distance
+        std::vector<PhysicObject> decoded;
+        compact.decode(decoded);
+        CHECK(decoded.size() == 8);
+        for (const PhysicObject& obj : decoded) {
+            float error = 1.0f;
+            for (const PhysicObject& expected : reference.objects) {
+                const Vec2 offset = expected.position - obj.position;
+                error = std::min(error, std::sqrt(offset.x * offset.x + offset.y * offset.y));
+            }
+            CHECK(error < 0.1f);
+        }
+    }
+    {
+        BasicPhysicSolver<Config>   reference{{40, 40}, pool};
+        CompactPhysicSolver<Config> compact{{40, 40}, pool};
+        std::vector<Vec2> positions;
+        // Rows are shifted so that the pile collapses the same way with both solvers
+        for (float x{2.5f}; x < 37.5f; x += 1.05f) {
+            for (int32_t row{0}; row < 19; ++row) {
+                positions.push_back({x + 0.01f * to<float>(row % 3), 10.0f + 1.05f * to<float>(row)});
+            }
+        }
+        const uint32_t count = to<uint32_t>(positions.size());
+        reference.createObjects(positions.data(), nullptr, nullptr, count);
+        compact.createObjects(positions.data(), nullptr, nullptr, count);
+        for (uint32_t i{0}; i < 180; ++i) {
+            reference.update(1.0f / 60.0f);
+            compact.update(1.0f / 60.0f);
+        }
+        std::vector<PhysicObject> decoded;
+        compact.decode(decoded);
+        CHECK(decoded.size() == count);
+        double reference_height = 0.0;
+        double compact_height   = 0.0;
+        for (const PhysicObject& obj : reference.objects) {
+            reference_height += obj.position.y;
+        }
+        for (const PhysicObject& obj : decoded) {
+            compact_height += obj.position.y;
+        }
+        CHECK(std::abs(reference_height - compact_height) / count < 0.25);
+    }
+}
+
+// Runs whose solver cannot honor their boundary modes are flagged instead of silently using walls
+void testBatchUnsupportedBoundaries()
+{
+    Sweep sweep;
+    sweep.axes = {{"solver", {"uniform", "compact"}}, {"boundary_x", {"wall", "periodic"}}, {"frames", {"2"}}, {"world_width", {"20"}}, {"world_height", {"20"}}};
+    tp::ThreadPool pool{1};
+    BatchRunner runner{sweep, pool};
+    runner.run();
+    CHECK(runner.summaries.size() == 4);
+    CHECK(runner.getFailedCount() == 1);
+    CHECK(runner.summaries[3].failed);
+    CHECK(!runner.summaries[2].failed && runner.summaries[2].objects_count > 0);
+}
+
+void testDispatch()
+{
+    const std::vector<uint32_t> element_counts = {0, 1, 2, 3, 4, 5, 7, 8, 13, 64, 100, 1000, 4097};
+    for (uint32_t thread_count{1}; thread_count <= 5; ++thread_count) {
+        for (const bool pinned : {false, true}) {
+            tp::ThreadPool pool{thread_count, pinned};
+            for (const uint32_t element_count : element_counts) {
+                checkDispatch(pool, element_count);
+            }
+        }
+    }
+    tp::ThreadPool inline_pool{tp::ThreadPool::Inline{}};
+    for (const uint32_t element_count : element_counts) {
+        checkDispatch(inline_pool, element_count);
+    }
+}
+
+}
+
+int main()
+{
+    testVector<civ::ContiguousStorage<>>();
+    testVector<civ::PagedStorage<2>>();
+    testPagedArrayIterator();
+    testArenaReleasedBytes();
+    testCollisionCellOverflow();
+    testCollisionGrid<ColumnMajorLayout>(13, 7);
+    testCollisionGrid<TiledLayout<3>>(13, 7);
+    testCollisionGrid<TiledLayout<2>>(32, 17);
+    testDispatch();
+    testNeighborListReach();
+    testMixedBoundaries();
+    testAtomShapes();
+    testSolverCommands();
+    testCompactAccuracy();
+    testBatchUnsupportedBoundaries();
+    testFluidPairs();
+    testDistanceField();
+    testBodyCells();
+    testGridQuery();
+    testForceFieldTiles();
+    testSlabDomain();
+    if (failed_checks) {
+        std::cout << failed_checks << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}